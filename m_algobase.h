@@ -355,7 +355,7 @@ void fill_cat(ForwardIter first, ForwardIter last,
 template<typename ForwardIter, typename T>
 void fill_cat(ForwardIter first, ForwardIter last,
                 const T& value, mstl::random_access_iterator_tag) {
-    fill_n(first, last - first, value);
+    mstl::fill_n(first, last - first, value);
 }
 
 template<typename ForwardIter, typename T>
@@ -1861,13 +1861,13 @@ operator+(basic_string<CharType, CharTraits>&& lhs, CharType ch) {
 template<typename CharType, typename CharTraits>
 bool operator==(const basic_string<CharType, CharTraits>& lhs,
                 const basic_string<CharType, CharTraits>& rhs) {
-    return lhs.size_ == rhs.size_ && lhs.compare(rhs) == 0;
+    return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
 }
 
 template<typename CharType, typename CharTraits>
 bool operator!=(const basic_string<CharType, CharTraits>& lhs,
                 const basic_string<CharType, CharTraits>& rhs) {
-    return lhs.size_ != rhs.size_ || lhs.compare(rhs) != 0;
+    return lhs.size() != rhs.size() || lhs.compare(rhs) != 0;
 }
 
 template<typename CharType, typename CharTraits>
@@ -1894,6 +1894,37 @@ bool operator>=(const basic_string<CharType, CharTraits>& lhs,
     return lhs.compare(rhs) >= 0;
 }
 
+// 与字符串指针比较，配合透明的equal_to<>、less<>可以直接用字面量查找关联容器
+template<typename CharType, typename CharTraits>
+bool operator==(const basic_string<CharType, CharTraits>& lhs, const CharType* rhs) {
+    return lhs.compare(rhs) == 0;
+}
+
+template<typename CharType, typename CharTraits>
+bool operator==(const CharType* lhs, const basic_string<CharType, CharTraits>& rhs) {
+    return rhs.compare(lhs) == 0;
+}
+
+template<typename CharType, typename CharTraits>
+bool operator!=(const basic_string<CharType, CharTraits>& lhs, const CharType* rhs) {
+    return lhs.compare(rhs) != 0;
+}
+
+template<typename CharType, typename CharTraits>
+bool operator!=(const CharType* lhs, const basic_string<CharType, CharTraits>& rhs) {
+    return rhs.compare(lhs) != 0;
+}
+
+template<typename CharType, typename CharTraits>
+bool operator<(const basic_string<CharType, CharTraits>& lhs, const CharType* rhs) {
+    return lhs.compare(rhs) < 0;
+}
+
+template<typename CharType, typename CharTraits>
+bool operator<(const CharType* lhs, const basic_string<CharType, CharTraits>& rhs) {
+    return rhs.compare(lhs) > 0;
+}
+
 // 重载全局的swap函数
 template<typename CharType, typename CharTraits>
 void swap(const basic_string<CharType, CharTraits>& lhs,
@@ -1904,11 +1935,32 @@ void swap(const basic_string<CharType, CharTraits>& lhs,
 // basic_string的hash仿函数
 template<typename CharType, typename CharTraits>
 struct hash<basic_string<CharType, CharTraits>> {
+    typedef void is_avalanching;
+
+    size_t operator()(const basic_string<CharType, CharTraits>& str) const noexcept {
+        return mstl::hash_bytes(str.data(), str.length() * sizeof(CharType));
+    }
+};
+
+// 透明的字符串哈希函数，对basic_string与内容相同的字符串指针求得的哈希值相同，
+// 与equal_to<>一起作为unordered容器的模板参数时，用const CharType*查找不会构造临时的basic_string
+template<typename CharType, typename CharTraits = mstl::char_traits<CharType>>
+struct basic_string_hash {
+    typedef void is_transparent;
+    typedef void is_avalanching;
+
     size_t operator()(const basic_string<CharType, CharTraits>& str) const noexcept {
-        return std::_Hash_impl::hash(str.data(), str.length());
+        return mstl::hash_bytes(str.data(), str.length() * sizeof(CharType));
+    }
+
+    size_t operator()(const CharType* str) const noexcept {
+        return mstl::hash_bytes(str, CharTraits::length(str) * sizeof(CharType));
     }
 };
 
+using string_hash    = mstl::basic_string_hash<char>;
+using wstring_hash   = mstl::basic_string_hash<wchar_t>;
+
 } // mstl
 
 #endif
\ No newline at end of file
@@ -0,0 +1,515 @@
+#ifndef M_BLOOM_FILTER_H_
+#define M_BLOOM_FILTER_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "m_util.h"
+#include "m_allocator.h"
+#include "m_vector.h"
+#include "m_functional.h"
+#include "m_exceptdef.h"
+
+namespace mstl {
+
+// 两种近似集合，查询只回答"一定不存在"或"可能存在"，放在访问较慢的数据结构之前过滤掉大部分不存在的键值
+//   blocked_bloom_filter  分块的布隆过滤器，一个键值的所有位都落在同一个64字节的块（一条缓存行）中，
+//                         每次查询只访问一条缓存行。不支持删除，删除只能整体重建
+//   cuckoo_filter         布谷鸟过滤器，保存哈希值的16位指纹，每个bucket 4个指纹，每个指纹有两个候选bucket，
+//                         查询最多访问两条缓存行。支持删除，表满时插入失败
+// 两者都提供按哈希值操作的接口(insert_hash等)，调用者已经算出哈希值时不必再计算一次。
+// 输入的哈希值会再混合一次，恒等映射之类没有充分混合的哈希函数也可以使用
+
+// 每个块的位数与64位字数
+#define MSTL_BLOOM_BLOCK_BITS  512
+#define MSTL_BLOOM_BLOCK_WORDS 8
+
+// 布谷鸟过滤器插入时踢出已有指纹的最大次数，超过后认为表已满
+#ifndef MSTL_CUCKOO_MAX_KICKS
+#define MSTL_CUCKOO_MAX_KICKS 500
+#endif
+
+// 对哈希值再做一次混合，得到块下标、位置与指纹所需的64位
+inline uint64_t bloom_remix(size_t h) noexcept {
+    return mstl::hash_mum(static_cast<uint64_t>(h) ^ 0x2d358dccaa6c78a5ull, 0x9e3779b97f4a7c15ull);
+}
+
+// 分块布隆过滤器的位数组，只按哈希值操作，hashtable与blocked_bloom_filter共用。
+// 混合后的高32位选择块，低32位分别乘以8个奇数常数，每个乘积的高6位选出一个字中的一位，
+// 于是每个键值在块的8个字中各置一位。块按64字节对齐，查询只访问一条缓存行
+class bloom_block_array {
+public:
+    typedef size_t size_type;
+
+private:
+    typedef mstl::allocator<uint64_t> data_allocator;
+
+    uint64_t* raw_;     // 申请得到的内存，多申请一个块用于对齐
+    uint64_t* blocks_;  // 第一个按64字节对齐的块
+    size_type count_;   // 块的个数
+
+public:
+    bloom_block_array() noexcept : raw_(nullptr), blocks_(nullptr), count_(0) {}
+
+    explicit bloom_block_array(size_type block_count) : raw_(nullptr), blocks_(nullptr), count_(0) {
+        assign(block_count);
+    }
+
+    bloom_block_array(const bloom_block_array& rhs) : raw_(nullptr), blocks_(nullptr), count_(0) {
+        if (rhs.count_ != 0) {
+            assign(rhs.count_);
+            std::memcpy(blocks_, rhs.blocks_, count_ * MSTL_BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+        }
+    }
+
+    bloom_block_array(bloom_block_array&& rhs) noexcept
+        : raw_(rhs.raw_), blocks_(rhs.blocks_), count_(rhs.count_) {
+        rhs.raw_ = nullptr;
+        rhs.blocks_ = nullptr;
+        rhs.count_ = 0;
+    }
+
+    bloom_block_array& operator=(const bloom_block_array& rhs) {
+        if (this != &rhs) {
+            bloom_block_array temp(rhs);
+            swap(temp);
+        }
+        return *this;
+    }
+
+    bloom_block_array& operator=(bloom_block_array&& rhs) noexcept {
+        bloom_block_array temp(mstl::move(rhs));
+        swap(temp);
+        return *this;
+    }
+
+    ~bloom_block_array() {
+        release();
+    }
+
+    // 重新申请block_count个块并清零，失败时保持原样
+    void assign(size_type block_count) {
+        uint64_t* raw = nullptr;
+        if (block_count != 0) {
+            raw = data_allocator::allocate((block_count + 1) * MSTL_BLOOM_BLOCK_WORDS);
+        }
+        release();
+        raw_ = raw;
+        count_ = block_count;
+        if (raw != nullptr) {
+            const uintptr_t n = reinterpret_cast<uintptr_t>(raw);
+            blocks_ = reinterpret_cast<uint64_t*>((n + 63) & ~static_cast<uintptr_t>(63));
+            clear();
+        }
+    }
+
+    // 只清零，不释放内存
+    void clear() noexcept {
+        if (count_ != 0) {
+            std::memset(blocks_, 0, count_ * MSTL_BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+        }
+    }
+
+    void release() noexcept {
+        if (raw_ != nullptr) {
+            data_allocator::deallocate(raw_, (count_ + 1) * MSTL_BLOOM_BLOCK_WORDS);
+        }
+        raw_ = nullptr;
+        blocks_ = nullptr;
+        count_ = 0;
+    }
+
+    void swap(bloom_block_array& rhs) noexcept {
+        mstl::swap(raw_, rhs.raw_);
+        mstl::swap(blocks_, rhs.blocks_);
+        mstl::swap(count_, rhs.count_);
+    }
+
+    size_type block_count() const noexcept {
+        return count_;
+    }
+
+    size_type bit_count() const noexcept {
+        return count_ * MSTL_BLOOM_BLOCK_BITS;
+    }
+
+    // 容纳keys个键值、每个键值bits_per_key位时需要的块数，至少为1
+    static size_type blocks_for(size_type keys, size_type bits_per_key) noexcept {
+        const size_type n = (keys * bits_per_key + MSTL_BLOOM_BLOCK_BITS - 1) / MSTL_BLOOM_BLOCK_BITS;
+        return n == 0 ? 1 : n;
+    }
+
+    // 哈希值h所在的块，批量查询时用于预取
+    const uint64_t* block_of(size_t h) const noexcept {
+        return block_at(bloom_remix(h));
+    }
+
+    void insert(size_t h) noexcept {
+        const uint64_t x = bloom_remix(h);
+        uint64_t* block = const_cast<uint64_t*>(block_at(x));
+        const uint32_t y = static_cast<uint32_t>(x);
+        for (int i = 0; i < MSTL_BLOOM_BLOCK_WORDS; ++i) {
+            block[i] |= bit_of(y, i);
+        }
+    }
+
+    // 8个字都检查完再判断，不产生依赖于数据的分支
+    bool may_contain(size_t h) const noexcept {
+        const uint64_t x = bloom_remix(h);
+        const uint64_t* block = block_at(x);
+        const uint32_t y = static_cast<uint32_t>(x);
+        uint64_t miss = 0;
+        for (int i = 0; i < MSTL_BLOOM_BLOCK_WORDS; ++i) {
+            miss |= ~block[i] & bit_of(y, i);
+        }
+        return miss == 0;
+    }
+
+private:
+    const uint64_t* block_at(uint64_t x) const noexcept {
+        MSTL_DEBUG(count_ != 0);
+        // 高32位乘以块数取高32位，把哈希值均匀映射到[0, count_)，不需要取模
+        const size_type n = static_cast<size_type>(((x >> 32) * static_cast<uint64_t>(count_)) >> 32);
+        return blocks_ + n * MSTL_BLOOM_BLOCK_WORDS;
+    }
+
+    static uint64_t bit_of(uint32_t y, int i) noexcept {
+        static const uint32_t salt[MSTL_BLOOM_BLOCK_WORDS] = {
+            0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+            0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+        };
+        return 1ull << ((y * salt[i]) >> 26);
+    }
+};
+
+// 分块布隆过滤器，expected为预计插入的键值个数，bits_per_key为每个键值分得的位数。
+// 每个键值固定置8位，bits_per_key为10时误判率约为1%，16时约为0.1%。
+// 插入的键值超过expected后误判率逐渐上升，但不会漏报
+template<typename Key, typename Hash = mstl::hash<Key>>
+class blocked_bloom_filter {
+public:
+    typedef Key    key_type;
+    typedef Hash   hasher;
+    typedef size_t size_type;
+
+private:
+    bloom_block_array bits_;
+    hasher            hash_;
+    size_type         size_;          // 插入的次数，重复插入同一个键值也会计数
+    size_type         bits_per_key_;
+
+public:
+    explicit blocked_bloom_filter(size_type expected = 1024, size_type bits_per_key = 10, const Hash& hash = Hash())
+        : bits_(bloom_block_array::blocks_for(expected, bits_per_key)), hash_(hash), size_(0),
+          bits_per_key_(bits_per_key) {}
+
+    blocked_bloom_filter(const blocked_bloom_filter& rhs) = default;
+    blocked_bloom_filter(blocked_bloom_filter&& rhs) noexcept
+        : bits_(mstl::move(rhs.bits_)), hash_(rhs.hash_), size_(rhs.size_), bits_per_key_(rhs.bits_per_key_) {
+        rhs.size_ = 0;
+    }
+
+    blocked_bloom_filter& operator=(const blocked_bloom_filter& rhs) = default;
+    blocked_bloom_filter& operator=(blocked_bloom_filter&& rhs) noexcept {
+        blocked_bloom_filter temp(mstl::move(rhs));
+        swap(temp);
+        return *this;
+    }
+
+    ~blocked_bloom_filter() = default;
+
+    void insert(const key_type& key) {
+        insert_hash(hash_(key));
+    }
+
+    bool may_contain(const key_type& key) const {
+        return may_contain_hash(hash_(key));
+    }
+
+    void insert_hash(size_t h) noexcept {
+        bits_.insert(h);
+        ++size_;
+    }
+
+    bool may_contain_hash(size_t h) const noexcept {
+        return bits_.may_contain(h);
+    }
+
+    // 清空所有键值，保留位数组
+    void clear() noexcept {
+        bits_.clear();
+        size_ = 0;
+    }
+
+    // 清空并按新的预计个数重新申请位数组
+    void reset(size_type expected) {
+        bits_.assign(bloom_block_array::blocks_for(expected, bits_per_key_));
+        size_ = 0;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    size_type block_count() const noexcept {
+        return bits_.block_count();
+    }
+
+    size_type bit_count() const noexcept {
+        return bits_.bit_count();
+    }
+
+    hasher hash_func() const {
+        return hash_;
+    }
+
+    void swap(blocked_bloom_filter& rhs) noexcept {
+        bits_.swap(rhs.bits_);
+        mstl::swap(hash_, rhs.hash_);
+        mstl::swap(size_, rhs.size_);
+        mstl::swap(bits_per_key_, rhs.bits_per_key_);
+    }
+};
+
+template<typename Key, typename Hash>
+void swap(blocked_bloom_filter<Key, Hash>& lhs, blocked_bloom_filter<Key, Hash>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+// 布谷鸟过滤器，bucket个数为2的幂，每个bucket 4个16位指纹，0表示空位。
+// 混合后的低位给出第一个候选bucket i1，最高16位为指纹fp，第二个候选bucket为 i1 ^ g(fp)，
+// 由任一个候选bucket和指纹都能算出另一个，踢出时不需要原来的键值。
+// 两个候选bucket都满时随机踢出一个指纹，让它搬到它的另一个候选bucket，最多MSTL_CUCKOO_MAX_KICKS次，
+// 仍然失败时最后被踢出的指纹保存在victim中，此后表视为已满，再插入返回false。
+// 误判率约为 8 / 65536。只能删除确实插入过的键值，否则可能删掉其他键值的指纹造成漏报
+template<typename Key, typename Hash = mstl::hash<Key>>
+class cuckoo_filter {
+public:
+    typedef Key    key_type;
+    typedef Hash   hasher;
+    typedef size_t size_type;
+
+private:
+    mstl::vector<uint16_t> slots_;          // bucket_count * 4个指纹
+    size_type              mask_;           // bucket个数减1
+    size_type              size_;
+    size_type              victim_index_;
+    uint16_t               victim_fp_;      // 为0表示没有被踢出的指纹
+    uint64_t               seed_;           // 选择踢出位置的xorshift状态
+    hasher                 hash_;
+
+public:
+    // expected为预计插入的键值个数，装填率不超过95%
+    explicit cuckoo_filter(size_type expected = 1024, const Hash& hash = Hash())
+        : mask_(0), size_(0), victim_index_(0), victim_fp_(0), seed_(0x9e3779b97f4a7c15ull), hash_(hash) {
+        size_type n = 1;
+        const size_type want = (expected * 100 / 95 + 3) / 4;
+        while (n < want) {
+            n <<= 1;
+        }
+        slots_.assign(n * 4, 0);
+        mask_ = n - 1;
+    }
+
+    cuckoo_filter(const cuckoo_filter& rhs) = default;
+    cuckoo_filter& operator=(const cuckoo_filter& rhs) = default;
+
+    cuckoo_filter(cuckoo_filter&& rhs) noexcept
+        : slots_(mstl::move(rhs.slots_)), mask_(rhs.mask_), size_(rhs.size_), victim_index_(rhs.victim_index_),
+          victim_fp_(rhs.victim_fp_), seed_(rhs.seed_), hash_(rhs.hash_) {
+        rhs.size_ = 0;
+        rhs.victim_fp_ = 0;
+    }
+
+    cuckoo_filter& operator=(cuckoo_filter&& rhs) noexcept {
+        cuckoo_filter temp(mstl::move(rhs));
+        swap(temp);
+        return *this;
+    }
+
+    ~cuckoo_filter() = default;
+
+    bool insert(const key_type& key) {
+        return insert_hash(hash_(key));
+    }
+
+    bool may_contain(const key_type& key) const {
+        return may_contain_hash(hash_(key));
+    }
+
+    bool erase(const key_type& key) {
+        return erase_hash(hash_(key));
+    }
+
+    bool insert_hash(size_t h);
+    bool may_contain_hash(size_t h) const noexcept;
+    bool erase_hash(size_t h) noexcept;
+
+    void clear() noexcept {
+        for (size_type i = 0; i < slots_.size(); ++i) {
+            slots_[i] = 0;
+        }
+        size_ = 0;
+        victim_fp_ = 0;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    // 出现过插入失败，此后的插入都会失败，需要换用更大的过滤器
+    bool full() const noexcept {
+        return victim_fp_ != 0;
+    }
+
+    size_type bucket_count() const noexcept {
+        return mask_ + 1;
+    }
+
+    size_type capacity() const noexcept {
+        return slots_.size();
+    }
+
+    float load_factor() const noexcept {
+        return (float)size_ / (float)slots_.size();
+    }
+
+    hasher hash_func() const {
+        return hash_;
+    }
+
+    void swap(cuckoo_filter& rhs) noexcept {
+        slots_.swap(rhs.slots_);
+        mstl::swap(mask_, rhs.mask_);
+        mstl::swap(size_, rhs.size_);
+        mstl::swap(victim_index_, rhs.victim_index_);
+        mstl::swap(victim_fp_, rhs.victim_fp_);
+        mstl::swap(seed_, rhs.seed_);
+        mstl::swap(hash_, rhs.hash_);
+    }
+
+private:
+    static uint16_t fingerprint(uint64_t x) noexcept {
+        const uint16_t fp = static_cast<uint16_t>(x >> 48);
+        return fp == 0 ? 1 : fp;
+    }
+
+    size_type alt_index(size_type i, uint16_t fp) const noexcept {
+        return (i ^ static_cast<size_type>(fp * 0x5bd1e995u)) & mask_;
+    }
+
+    bool bucket_has(size_type i, uint16_t fp) const noexcept {
+        const uint16_t* b = &slots_[i * 4];
+        return (b[0] == fp) | (b[1] == fp) | (b[2] == fp) | (b[3] == fp);
+    }
+
+    bool bucket_put(size_type i, uint16_t fp) noexcept {
+        uint16_t* b = &slots_[i * 4];
+        for (int k = 0; k < 4; ++k) {
+            if (b[k] == 0) {
+                b[k] = fp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool bucket_remove(size_type i, uint16_t fp) noexcept {
+        uint16_t* b = &slots_[i * 4];
+        for (int k = 0; k < 4; ++k) {
+            if (b[k] == fp) {
+                b[k] = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool place(size_type i, uint16_t fp) noexcept;
+};
+
+template<typename Key, typename Hash>
+bool cuckoo_filter<Key, Hash>::insert_hash(size_t h) {
+    if (victim_fp_ != 0) {
+        return false;
+    }
+    const uint64_t x = bloom_remix(h);
+    place(static_cast<size_type>(x) & mask_, fingerprint(x));
+    ++size_;
+    return true;
+}
+
+// 放入fp，必要时沿踢出链搬动其他指纹，最终放不下的指纹成为victim
+template<typename Key, typename Hash>
+bool cuckoo_filter<Key, Hash>::place(size_type i, uint16_t fp) noexcept {
+    if (bucket_put(i, fp)) {
+        return true;
+    }
+    i = alt_index(i, fp);
+    for (int kick = 0; kick < MSTL_CUCKOO_MAX_KICKS; ++kick) {
+        if (bucket_put(i, fp)) {
+            return true;
+        }
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 7;
+        seed_ ^= seed_ << 17;
+        uint16_t& slot = slots_[i * 4 + static_cast<size_type>(seed_ & 3)];
+        mstl::swap(fp, slot);
+        i = alt_index(i, fp);
+    }
+    victim_index_ = i;
+    victim_fp_ = fp;
+    return false;
+}
+
+template<typename Key, typename Hash>
+bool cuckoo_filter<Key, Hash>::may_contain_hash(size_t h) const noexcept {
+    const uint64_t x = bloom_remix(h);
+    const uint16_t fp = fingerprint(x);
+    const size_type i1 = static_cast<size_type>(x) & mask_;
+    const size_type i2 = alt_index(i1, fp);
+    const bool victim = victim_fp_ == fp && (victim_index_ == i1 || victim_index_ == i2);
+    return bucket_has(i1, fp) | bucket_has(i2, fp) | victim;
+}
+
+// 删除后有了空位，尝试把victim放回表中
+template<typename Key, typename Hash>
+bool cuckoo_filter<Key, Hash>::erase_hash(size_t h) noexcept {
+    const uint64_t x = bloom_remix(h);
+    const uint16_t fp = fingerprint(x);
+    const size_type i1 = static_cast<size_type>(x) & mask_;
+    const size_type i2 = alt_index(i1, fp);
+    if (bucket_remove(i1, fp) || bucket_remove(i2, fp)) {
+        --size_;
+        if (victim_fp_ != 0) {
+            const size_type i = victim_index_;
+            const uint16_t v = victim_fp_;
+            victim_fp_ = 0;
+            place(i, v);
+        }
+        return true;
+    }
+    if (victim_fp_ == fp && (victim_index_ == i1 || victim_index_ == i2)) {
+        victim_fp_ = 0;
+        --size_;
+        return true;
+    }
+    return false;
+}
+
+template<typename Key, typename Hash>
+void swap(cuckoo_filter<Key, Hash>& lhs, cuckoo_filter<Key, Hash>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // mstl
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef M_CONCURRENT_LRU_CACHE_H_
+#define M_CONCURRENT_LRU_CACHE_H_
+
+// 分片的并发缓存 concurrent_lru_cache
+// 与concurrent_unordered_map一样由2的幂个按缓存行对齐的分片组成，每个分片是一个独立的lru_cache。
+// 命中也会修改淘汰顺序，所以分片使用互斥锁而不是读写锁。
+// 容量与权重上限平均分给每个分片，淘汰只在分片内进行，整体上是近似的lru (或lfu)。
+// 接口不返回指针：get 把值拷贝出来，淘汰回调在分片的锁内执行
+
+#include <mutex>
+
+#include "m_lru_cache.h"
+#include "m_memory.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，第四参数为键比较大小的函数类型，
+// 第五参数为淘汰策略
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename Policy = cache_lru_policy>
+class concurrent_lru_cache {
+public:
+    typedef mstl::lru_cache<Key, T, Hash, KeyEqual, Policy>   cache_type;
+
+    typedef typename cache_type::key_type                     key_type;
+    typedef typename cache_type::mapped_type                  mapped_type;
+    typedef typename cache_type::hasher                       hasher;
+    typedef typename cache_type::key_equal                    key_equal;
+    typedef typename cache_type::size_type                    size_type;
+    typedef typename cache_type::evict_callback               evict_callback;
+
+private:
+    typedef std::mutex                           mutex_type;
+    typedef std::lock_guard<mutex_type>          lock_type;
+
+    struct alignas(MSTL_CACHE_LINE_SIZE) shard {
+        mutable mutex_type mutex;
+        cache_type         cache;
+
+        shard(size_type capacity, size_type max_weight, const Hash& hash, const KeyEqual& equal)
+            : mutex(), cache(capacity, max_weight, hash, equal) {}
+    };
+
+    typedef mstl::cache_aligned_allocator<shard> shard_allocator;
+
+    shard*    shards_;
+    size_type shard_count_;
+    // 选择分片时右移的位数，取乘法散列结果的高log2(shard_count_)位
+    size_type shift_;
+    hasher    hash_;
+
+public:
+    // shard_count 会向上取整为2的幂，每个分片的上限为总上限除以分片数后向上取整
+    explicit concurrent_lru_cache(size_type capacity,
+                                  size_type max_weight = static_cast<size_type>(-1),
+                                  size_type shard_count = 16,
+                                  const Hash& hash = Hash(),
+                                  const KeyEqual& equal = KeyEqual())
+        : shards_(nullptr), shard_count_(1), shift_(sizeof(size_type) * 8), hash_(hash) {
+        THROW_LENGTH_ERROR_IF(shard_count == 0, "concurrent_lru_cache shard count can not be zero");
+        THROW_LENGTH_ERROR_IF(capacity == 0, "concurrent_lru_cache capacity can not be zero");
+        while (shard_count_ < shard_count) {
+            shard_count_ <<= 1;
+            --shift_;
+        }
+        const size_type per_capacity = per_shard(capacity);
+        const size_type per_weight = per_shard(max_weight);
+        shards_ = shard_allocator::allocate(shard_count_);
+        size_type i = 0;
+        try {
+            for (; i < shard_count_; ++i) {
+                shard_allocator::construct(shards_ + i, per_capacity, per_weight, hash, equal);
+            }
+        } catch (...) {
+            shard_allocator::destory(shards_, shards_ + i);
+            shard_allocator::deallocate(shards_, shard_count_);
+            throw;
+        }
+    }
+
+    concurrent_lru_cache(const concurrent_lru_cache&) = delete;
+    concurrent_lru_cache& operator=(const concurrent_lru_cache&) = delete;
+
+    ~concurrent_lru_cache() {
+        shard_allocator::destory(shards_, shards_ + shard_count_);
+        shard_allocator::deallocate(shards_, shard_count_);
+    }
+
+    // 容量相关，逐个分片加锁统计，并发修改时结果仅供参考
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_type size() const {
+        size_type n = 0;
+        for (size_type i = 0; i < shard_count_; ++i) {
+            lock_type lock(shards_[i].mutex);
+            n += shards_[i].cache.size();
+        }
+        return n;
+    }
+
+    size_type weight() const {
+        size_type n = 0;
+        for (size_type i = 0; i < shard_count_; ++i) {
+            lock_type lock(shards_[i].mutex);
+            n += shards_[i].cache.weight();
+        }
+        return n;
+    }
+
+    size_type shard_count() const noexcept {
+        return shard_count_;
+    }
+
+    // 回调在淘汰所在分片的锁内执行，不应再访问本容器
+    void set_evict_callback(const evict_callback& fn) {
+        for (size_type i = 0; i < shard_count_; ++i) {
+            lock_type lock(shards_[i].mutex);
+            shards_[i].cache.set_evict_callback(fn);
+        }
+    }
+
+    // 查找key并记一次访问，存在时把值拷贝到value中并返回true
+    bool get(const key_type& key, mapped_type& value) {
+        shard& s = shard_of(key);
+        lock_type lock(s.mutex);
+        const mapped_type* p = s.cache.get(key);
+        if (p == nullptr) {
+            return false;
+        }
+        value = *p;
+        return true;
+    }
+
+    // 只查找，不影响淘汰顺序
+    bool peek(const key_type& key, mapped_type& value) const {
+        const shard& s = shard_of(key);
+        lock_type lock(s.mutex);
+        const mapped_type* p = s.cache.peek(key);
+        if (p == nullptr) {
+            return false;
+        }
+        value = *p;
+        return true;
+    }
+
+    bool contains(const key_type& key) const {
+        const shard& s = shard_of(key);
+        lock_type lock(s.mutex);
+        return s.cache.contains(key);
+    }
+
+    template<typename V>
+    bool put(const key_type& key, V&& value, size_type weight = 1) {
+        shard& s = shard_of(key);
+        lock_type lock(s.mutex);
+        return s.cache.put(key, mstl::forward<V>(value), weight);
+    }
+
+    size_type erase(const key_type& key) {
+        shard& s = shard_of(key);
+        lock_type lock(s.mutex);
+        return s.cache.erase(key);
+    }
+
+    void clear() {
+        for (size_type i = 0; i < shard_count_; ++i) {
+            lock_type lock(shards_[i].mutex);
+            shards_[i].cache.clear();
+        }
+    }
+
+    hasher hash_func() const {
+        return hash_;
+    }
+
+private:
+    size_type per_shard(size_type n) const noexcept {
+        return n / shard_count_ + (n % shard_count_ != 0 ? 1 : 0);
+    }
+
+    // 乘以黄金分割常数后取高位，与分片内部的bucket下标使用哈希值的不同部分
+    size_type shard_index(const key_type& key) const {
+        if (shard_count_ == 1) {
+            return 0;
+        }
+        const size_type golden = sizeof(size_type) == 8 ? static_cast<size_type>(0x9e3779b97f4a7c15ull)
+                                                        : static_cast<size_type>(0x9e3779b9u);
+        return static_cast<size_type>(hash_(key) * golden) >> shift_;
+    }
+
+    shard& shard_of(const key_type& key) {
+        return shards_[shard_index(key)];
+    }
+
+    const shard& shard_of(const key_type& key) const {
+        return shards_[shard_index(key)];
+    }
+};
+
+} // mstl
+
+#endif
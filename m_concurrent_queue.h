@@ -0,0 +1,293 @@
+#ifndef M_CONCURRENT_QUEUE_H_
+#define M_CONCURRENT_QUEUE_H_
+
+// 阻塞式的并发队列适配器 concurrent_queue
+// 与 queue 一样以 deque 作为默认的底层容器，额外持有一把互斥锁和两个条件变量：
+// not_empty_ 用于唤醒等待元素的消费者，not_full_ 用于唤醒因容量上限而阻塞的生产者（背压）。
+// drain_into 在一次加锁中取走多个元素，从而分摊加锁与唤醒的开销
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "m_deque.h"
+#include "m_vector.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+template<typename T, typename Container = mstl::deque<T>>
+class concurrent_queue {
+public:
+    typedef Container                           container_type;
+    typedef typename Container::value_type      value_type;
+    typedef typename Container::size_type       size_type;
+    typedef typename Container::reference       reference;
+    typedef typename Container::const_reference const_reference;
+    static_assert(std::is_same<T, value_type>::value,
+                    "the value_type of Container should be same with template T");
+private:
+    typedef std::unique_lock<std::mutex> lock_type;
+
+    container_type          c_;
+    size_type               capacity_;
+    // 只有存在等待者时才进行通知，避免无谓的唤醒开销
+    size_type               push_waiters_;
+    size_type               pop_waiters_;
+    bool                    closed_;
+    mutable std::mutex      mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+
+public:
+    // capacity 为队列中最多容纳的元素个数，达到上限后 push 将阻塞
+    explicit concurrent_queue(size_type capacity = static_cast<size_type>(-1))
+        : c_(), capacity_(capacity), push_waiters_(0), pop_waiters_(0), closed_(false) {
+        THROW_LENGTH_ERROR_IF(capacity == 0, "concurrent_queue<T> capacity can not be zero");
+    }
+
+    concurrent_queue(const concurrent_queue&) = delete;
+    concurrent_queue& operator=(const concurrent_queue&) = delete;
+
+    ~concurrent_queue() = default;
+
+    // 容器容量相关，并发情况下结果仅供参考
+    bool empty() const {
+        lock_type lock(mutex_);
+        return c_.empty();
+    }
+
+    size_type size() const {
+        lock_type lock(mutex_);
+        return c_.size();
+    }
+
+    size_type capacity() const noexcept {
+        return capacity_;
+    }
+
+    // 关闭队列：之后的 push 均失败，消费者取完剩余元素后不再阻塞
+    void close() {
+        {
+            lock_type lock(mutex_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    bool closed() const {
+        lock_type lock(mutex_);
+        return closed_;
+    }
+
+    // 生产者接口，队列已满时阻塞，队列关闭时返回 false
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        lock_type lock(mutex_);
+        wait_not_full(lock);
+        if (closed_) {
+            return false;
+        }
+        c_.emplace_back(mstl::forward<Args>(args)...);
+        notify_pop(lock);
+        return true;
+    }
+
+    bool push(const value_type& value) {
+        return emplace(value);
+    }
+
+    bool push(value_type&& value) {
+        return emplace(mstl::move(value));
+    }
+
+    // 非阻塞版本，队列已满或关闭时立即返回 false
+    bool try_push(const value_type& value) {
+        return try_emplace(value);
+    }
+
+    bool try_push(value_type&& value) {
+        return try_emplace(mstl::move(value));
+    }
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args) {
+        lock_type lock(mutex_);
+        if (closed_ || c_.size() >= capacity_) {
+            return false;
+        }
+        c_.emplace_back(mstl::forward<Args>(args)...);
+        notify_pop(lock);
+        return true;
+    }
+
+    // 最多等待 timeout，超时仍然没有空位则返回 false
+    template<typename Rep, typename Period>
+    bool push_for(value_type value, const std::chrono::duration<Rep, Period>& timeout) {
+        lock_type lock(mutex_);
+        if (!wait_not_full_for(lock, timeout) || closed_) {
+            return false;
+        }
+        c_.emplace_back(mstl::move(value));
+        notify_pop(lock);
+        return true;
+    }
+
+    // 消费者接口，队列为空时阻塞，队列关闭且为空时返回 false
+    bool pop_wait(value_type& value) {
+        lock_type lock(mutex_);
+        wait_not_empty(lock);
+        if (c_.empty()) {
+            return false;
+        }
+        take_one(value);
+        notify_push(lock, 1);
+        return true;
+    }
+
+    bool try_pop(value_type& value) {
+        lock_type lock(mutex_);
+        if (c_.empty()) {
+            return false;
+        }
+        take_one(value);
+        notify_push(lock, 1);
+        return true;
+    }
+
+    template<typename Rep, typename Period>
+    bool pop_for(value_type& value, const std::chrono::duration<Rep, Period>& timeout) {
+        lock_type lock(mutex_);
+        if (!wait_not_empty_for(lock, timeout)) {
+            return false;
+        }
+        take_one(value);
+        notify_push(lock, 1);
+        return true;
+    }
+
+    // 阻塞直到队列中至少有一个元素，然后在同一次加锁中取走至多 max_count 个元素追加到 out 中，
+    // 返回取走的个数，队列关闭且为空时返回 0
+    size_type drain_into(mstl::vector<value_type>& out, size_type max_count) {
+        if (max_count == 0) {
+            return 0;
+        }
+        lock_type lock(mutex_);
+        wait_not_empty(lock);
+        const size_type n = take_many(out, max_count);
+        notify_push(lock, n);
+        return n;
+    }
+
+    // 非阻塞版本，队列为空时立即返回 0
+    size_type try_drain_into(mstl::vector<value_type>& out, size_type max_count) {
+        lock_type lock(mutex_);
+        const size_type n = take_many(out, max_count);
+        notify_push(lock, n);
+        return n;
+    }
+
+    template<typename Rep, typename Period>
+    size_type drain_for(mstl::vector<value_type>& out, size_type max_count,
+                        const std::chrono::duration<Rep, Period>& timeout) {
+        if (max_count == 0) {
+            return 0;
+        }
+        lock_type lock(mutex_);
+        if (!wait_not_empty_for(lock, timeout)) {
+            return 0;
+        }
+        const size_type n = take_many(out, max_count);
+        notify_push(lock, n);
+        return n;
+    }
+
+private:
+    void take_one(value_type& value) {
+        value = mstl::move(c_.front());
+        c_.pop_front();
+    }
+
+    size_type take_many(mstl::vector<value_type>& out, size_type max_count) {
+        const size_type n = mstl::min(max_count, c_.size());
+        out.reserve(out.size() + n);
+        for (size_type i = 0; i < n; ++i) {
+            out.emplace_back(mstl::move(c_.front()));
+            c_.pop_front();
+        }
+        return n;
+    }
+
+    void wait_not_full(lock_type& lock) {
+        if (c_.size() >= capacity_ && !closed_) {
+            ++push_waiters_;
+            not_full_.wait(lock, [this]() {
+                return c_.size() < capacity_ || closed_;
+            });
+            --push_waiters_;
+        }
+    }
+
+    void wait_not_empty(lock_type& lock) {
+        if (c_.empty() && !closed_) {
+            ++pop_waiters_;
+            not_empty_.wait(lock, [this]() {
+                return !c_.empty() || closed_;
+            });
+            --pop_waiters_;
+        }
+    }
+
+    template<typename Rep, typename Period>
+    bool wait_not_full_for(lock_type& lock, const std::chrono::duration<Rep, Period>& timeout) {
+        if (c_.size() >= capacity_ && !closed_) {
+            ++push_waiters_;
+            not_full_.wait_for(lock, timeout, [this]() {
+                return c_.size() < capacity_ || closed_;
+            });
+            --push_waiters_;
+        }
+        return c_.size() < capacity_;
+    }
+
+    template<typename Rep, typename Period>
+    bool wait_not_empty_for(lock_type& lock, const std::chrono::duration<Rep, Period>& timeout) {
+        if (c_.empty() && !closed_) {
+            ++pop_waiters_;
+            not_empty_.wait_for(lock, timeout, [this]() {
+                return !c_.empty() || closed_;
+            });
+            --pop_waiters_;
+        }
+        return !c_.empty();
+    }
+
+    // 先解锁再通知，被唤醒的线程无需立刻再次阻塞在互斥锁上
+    void notify_pop(lock_type& lock) {
+        const bool need = pop_waiters_ != 0;
+        lock.unlock();
+        if (need) {
+            not_empty_.notify_one();
+        }
+    }
+
+    // 一次取走了 n 个元素时，最多唤醒 n 个等待的生产者
+    void notify_push(lock_type& lock, size_type n) {
+        const size_type waiters = push_waiters_;
+        lock.unlock();
+        if (waiters == 0 || n == 0) {
+            return;
+        }
+        if (n == 1) {
+            not_full_.notify_one();
+        } else {
+            not_full_.notify_all();
+        }
+    }
+};
+
+} // mstl
+
+#endif
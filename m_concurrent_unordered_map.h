@@ -0,0 +1,252 @@
+#ifndef M_CONCURRENT_UNORDERED_MAP_H_
+#define M_CONCURRENT_UNORDERED_MAP_H_
+
+// 分片的并发哈希表 concurrent_unordered_map
+// 由2的幂个分片组成，每个分片是一个独立的hashtable，并由自己的读写锁保护，
+// 分片按缓存行对齐，不同分片的锁不会落在同一缓存行上产生伪共享。
+// 每次操作只调用一次哈希函数：哈希值经过一次乘法散列，取高位选择分片，
+// 同一个哈希值再交给分片的hashtable，由bucket策略取下标，两者使用哈希值的不同部分。
+// 所有接口都在锁内完成对元素的访问，不返回迭代器或引用：
+// find 把值拷贝出来，upsert/erase_if 把回调放到锁内执行，for_each_shard 只在回调期间提供分片的引用
+
+#include <mutex>
+#include <shared_mutex>
+
+#include "m_hashtable.h"
+#include "m_memory.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，第四参数为键比较大小的函数类型
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+class concurrent_unordered_map {
+public:
+    typedef mstl::hashtable<mstl::pair<const Key, T>, Hash, KeyEqual> table_type;
+
+    typedef typename table_type::key_type                             key_type;
+    typedef typename table_type::mapped_type                          mapped_type;
+    typedef typename table_type::value_type                           value_type;
+    typedef typename table_type::hasher                               hasher;
+    typedef typename table_type::key_equal                            key_equal;
+    typedef typename table_type::size_type                            size_type;
+
+private:
+    typedef std::shared_timed_mutex              mutex_type;
+    typedef std::shared_lock<mutex_type>         read_lock;
+    typedef std::unique_lock<mutex_type>         write_lock;
+
+    struct alignas(MSTL_CACHE_LINE_SIZE) shard {
+        mutable mutex_type mutex;
+        table_type         table;
+
+        shard(const Hash& hash, const KeyEqual& equal) : mutex(), table(0, hash, equal) {}
+    };
+
+    // operator new不保证按缓存行对齐，分片数组由cache_aligned_allocator申请
+    typedef mstl::cache_aligned_allocator<shard> shard_allocator;
+
+    shard*    shards_;
+    size_type shard_count_;
+    // 选择分片时右移的位数，取乘法散列结果的高log2(shard_count_)位
+    size_type shift_;
+    hasher    hash_;
+
+public:
+    // shard_count 会向上取整为2的幂，通常取并发线程数的若干倍即可
+    explicit concurrent_unordered_map(size_type shard_count = 64,
+                                      const Hash& hash = Hash(),
+                                      const KeyEqual& equal = KeyEqual())
+        : shards_(nullptr), shard_count_(1), shift_(sizeof(size_type) * 8), hash_(hash) {
+        THROW_LENGTH_ERROR_IF(shard_count == 0, "concurrent_unordered_map shard count can not be zero");
+        while (shard_count_ < shard_count) {
+            shard_count_ <<= 1;
+            --shift_;
+        }
+        shards_ = shard_allocator::allocate(shard_count_);
+        size_type i = 0;
+        try {
+            for (; i < shard_count_; ++i) {
+                shard_allocator::construct(shards_ + i, hash, equal);
+            }
+        } catch (...) {
+            shard_allocator::destory(shards_, shards_ + i);
+            shard_allocator::deallocate(shards_, shard_count_);
+            throw;
+        }
+    }
+
+    concurrent_unordered_map(const concurrent_unordered_map&) = delete;
+    concurrent_unordered_map& operator=(const concurrent_unordered_map&) = delete;
+
+    ~concurrent_unordered_map() {
+        shard_allocator::destory(shards_, shards_ + shard_count_);
+        shard_allocator::deallocate(shards_, shard_count_);
+    }
+
+    // 容量相关，逐个分片加锁统计，并发修改时结果仅供参考
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_type size() const {
+        size_type n = 0;
+        for (size_type i = 0; i < shard_count_; ++i) {
+            read_lock lock(shards_[i].mutex);
+            n += shards_[i].table.size();
+        }
+        return n;
+    }
+
+    size_type shard_count() const noexcept {
+        return shard_count_;
+    }
+
+    // 为每个分片预留count / shard_count_个元素的bucket
+    void reserve(size_type count) {
+        const size_type per_shard = count / shard_count_ + 1;
+        for (size_type i = 0; i < shard_count_; ++i) {
+            write_lock lock(shards_[i].mutex);
+            shards_[i].table.reserve(per_shard);
+        }
+    }
+
+    void clear() {
+        for (size_type i = 0; i < shard_count_; ++i) {
+            write_lock lock(shards_[i].mutex);
+            shards_[i].table.clear();
+        }
+    }
+
+    // 查找key，存在时把值拷贝到value中并返回true
+    bool find(const key_type& key, mapped_type& value) const {
+        const size_type code = hash_(key);
+        const shard& s = shard_of(code);
+        read_lock lock(s.mutex);
+        auto iter = s.table.find_hashed(key, code);
+        if (iter == s.table.end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const {
+        const size_type code = hash_(key);
+        const shard& s = shard_of(code);
+        read_lock lock(s.mutex);
+        return s.table.find_hashed(key, code) != s.table.end();
+    }
+
+    // 不存在时插入，存在时覆盖原有的值，返回是否为新插入
+    template<typename M>
+    bool insert_or_assign(const key_type& key, M&& value) {
+        const size_type code = hash_(key);
+        shard& s = shard_of(code);
+        write_lock lock(s.mutex);
+        // 键值已经存在时try_emplace_hashed不会移动value，之后再赋值给已有的元素
+        auto res = s.table.try_emplace_hashed(key, code, mstl::forward<M>(value));
+        if (!res.second) {
+            res.first->second = mstl::forward<M>(value);
+        }
+        return res.second;
+    }
+
+    // 在写锁内对key对应的值调用fn(mapped_type&)，key不存在时先插入一个值初始化的mapped_type，
+    // 返回是否为新插入。fn在锁内执行，不应再访问本容器
+    template<typename Fn>
+    bool upsert(const key_type& key, Fn fn) {
+        const size_type code = hash_(key);
+        shard& s = shard_of(code);
+        write_lock lock(s.mutex);
+        auto res = s.table.try_emplace_hashed(key, code);
+        fn(res.first->second);
+        return res.second;
+    }
+
+    size_type erase(const key_type& key) {
+        const size_type code = hash_(key);
+        shard& s = shard_of(code);
+        write_lock lock(s.mutex);
+        return s.table.erase_unique_hashed(key, code);
+    }
+
+    // key存在且pred(const mapped_type&)为true时删除，判断与删除在同一次加锁内完成
+    template<typename Pred>
+    bool erase_if(const key_type& key, Pred pred) {
+        const size_type code = hash_(key);
+        shard& s = shard_of(code);
+        write_lock lock(s.mutex);
+        auto iter = s.table.find_hashed(key, code);
+        if (iter == s.table.end() || !pred(static_cast<const mapped_type&>(iter->second))) {
+            return false;
+        }
+        s.table.erase(iter);
+        return true;
+    }
+
+    // 删除所有满足pred(const value_type&)的元素，逐个分片加锁，返回删除的个数
+    template<typename Pred>
+    size_type erase_if(Pred pred) {
+        size_type count = 0;
+        for (size_type i = 0; i < shard_count_; ++i) {
+            write_lock lock(shards_[i].mutex);
+            table_type& table = shards_[i].table;
+            for (auto iter = table.begin(); iter != table.end();) {
+                auto cur = iter++;
+                if (pred(static_cast<const value_type&>(*cur))) {
+                    table.erase(cur);
+                    ++count;
+                }
+            }
+        }
+        return count;
+    }
+
+    // 依次在每个分片的锁内调用fn(table_type&)，引用只在回调期间有效
+    template<typename Fn>
+    void for_each_shard(Fn fn) {
+        for (size_type i = 0; i < shard_count_; ++i) {
+            write_lock lock(shards_[i].mutex);
+            fn(shards_[i].table);
+        }
+    }
+
+    // 只读版本持有读锁，回调得到const table_type&
+    template<typename Fn>
+    void for_each_shard(Fn fn) const {
+        for (size_type i = 0; i < shard_count_; ++i) {
+            read_lock lock(shards_[i].mutex);
+            fn(static_cast<const table_type&>(shards_[i].table));
+        }
+    }
+
+    hasher hash_func() const {
+        return hash_;
+    }
+
+private:
+    // 乘以黄金分割常数后取高位，与分片内部的bucket下标使用哈希值的不同部分。
+    // 直接按size_type的宽度选择常数，不依赖其他头文件中的SYSTEM_64
+    size_type shard_index(size_type code) const {
+        if (shard_count_ == 1) {
+            return 0;
+        }
+        const size_type golden = sizeof(size_type) == 8 ? static_cast<size_type>(0x9e3779b97f4a7c15ull)
+                                                        : static_cast<size_type>(0x9e3779b9u);
+        return static_cast<size_type>(code * golden) >> shift_;
+    }
+
+    shard& shard_of(size_type code) {
+        return shards_[shard_index(code)];
+    }
+
+    const shard& shard_of(size_type code) const {
+        return shards_[shard_index(code)];
+    }
+};
+
+} // mstl
+
+#endif
@@ -15,6 +15,9 @@ namespace mstl {
 #define THROW_OUT_OF_RANGE_IF(expr, what)   \
     if ((expr)) throw std::out_of_range(what)
 
+#define THROW_LOGIC_ERROR_IF(expr, what)   \
+    if ((expr)) throw std::logic_error(what)
+
 #define THROW_RUNTIME_ERROR_IF(expr, what)   \
     if ((expr)) throw std::runtime_error(what)
 
@@ -0,0 +1,275 @@
+#ifndef M_FLAT_HASH_MAP_H_
+#define M_FLAT_HASH_MAP_H_
+
+#include "m_flat_hashtable.h"
+
+namespace mstl {
+
+// flat_hash_map模板类，接口与unordered_map相同，底层为开放寻址的flat_hashtable
+// 元素直接存放在槽位数组中，查找时不需要追踪节点指针，但插入引起扩容时元素会被移动，
+// 因此不提供bucket相关的local_iterator，也不保证插入后元素的地址不变
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，第四参数为键比较大小的函数类型，缺省为mstl::equal_to<>
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+class flat_hash_map {
+private:
+    // 以flat_hashtable作为底层容器进行封装
+    typedef flat_hashtable<mstl::pair<const Key, T>, Hash, KeyEqual> base_type;
+    base_type ht_;
+public:
+    typedef typename base_type::allocator_type       allocator_type;
+    typedef typename base_type::key_type             key_type;
+    typedef typename base_type::mapped_type          mapped_type;
+    typedef typename base_type::value_type           value_type;
+    typedef typename base_type::hasher               hasher;
+    typedef typename base_type::key_equal            key_equal;
+
+    typedef typename base_type::size_type            size_type;
+    typedef typename base_type::difference_type      difference_type;
+    typedef typename base_type::pointer              pointer;
+    typedef typename base_type::const_pointer        const_pointer;
+    typedef typename base_type::reference            reference;
+    typedef typename base_type::const_reference      const_reference;
+
+    typedef typename base_type::iterator             iterator;
+    typedef typename base_type::const_iterator       const_iterator;
+
+    allocator_type get_allocator() const {
+        return ht_.get_allocator();
+    }
+
+public:
+    // 构造函数，默认构造时不申请内存
+    flat_hash_map() : ht_(0, Hash(), KeyEqual()) {}
+
+    explicit flat_hash_map(size_type bucket_count,
+                           const Hash& hash = Hash(),
+                           const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {}
+
+    template<typename InputIter>
+    flat_hash_map(InputIter first, InputIter last,
+                  const size_type bucket_count = 0,
+                  const Hash& hash = Hash(),
+                  const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.reserve(static_cast<size_type>(mstl::distance(first, last)));
+        ht_.insert_unique(first, last);
+    }
+
+    flat_hash_map(std::initializer_list<value_type> ilist,
+                  const size_type bucket_count = 0,
+                  const Hash& hash = Hash(),
+                  const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.reserve(static_cast<size_type>(ilist.size()));
+        ht_.insert_unique(ilist.begin(), ilist.end());
+    }
+
+    flat_hash_map(const flat_hash_map& rhs) : ht_(rhs.ht_) {}
+
+    flat_hash_map(flat_hash_map&& rhs) noexcept : ht_(mstl::move(rhs.ht_)) {}
+
+    // 是否自我赋值交给底层容器判断即可
+    flat_hash_map& operator=(const flat_hash_map& rhs) {
+        ht_ = rhs.ht_;
+        return *this;
+    }
+
+    flat_hash_map& operator=(flat_hash_map&& rhs) noexcept {
+        ht_ = mstl::move(rhs.ht_);
+        return *this;
+    }
+
+    flat_hash_map& operator=(std::initializer_list<value_type> ilist) {
+        ht_.clear();
+        ht_.reserve(static_cast<size_type>(ilist.size()));
+        ht_.insert_unique(ilist.begin(), ilist.end());
+        return *this;
+    }
+
+    ~flat_hash_map() = default;
+
+    // 迭代器相关操作
+    iterator begin() noexcept {
+        return ht_.begin();
+    }
+
+    const_iterator begin() const noexcept {
+        return ht_.begin();
+    }
+
+    iterator end() noexcept {
+        return ht_.end();
+    }
+
+    const_iterator end() const noexcept {
+        return ht_.end();
+    }
+
+    const_iterator cbegin() const noexcept {
+        return ht_.cbegin();
+    }
+
+    const_iterator cend() const noexcept {
+        return ht_.cend();
+    }
+
+    // 容器容量操作
+    bool empty() const {
+        return ht_.empty();
+    }
+
+    size_type size() const {
+        return ht_.size();
+    }
+
+    size_type max_size() const {
+        return ht_.max_size();
+    }
+
+    // 修改容器内容
+    template<typename ...Args>
+    pair<iterator, bool> emplace(Args&& ...args) {
+        return ht_.emplace_unique(mstl::forward<Args>(args)...);
+    }
+
+    template<typename ...Args>
+    iterator emplace_hint(const_iterator hint, Args&& ...args) {
+        return ht_.emplace_unique_use_hint(hint, mstl::forward<Args>(args)...);
+    }
+
+    pair<iterator, bool> insert(const value_type& value) {
+        return ht_.insert_unique(value);
+    }
+
+    pair<iterator, bool> insert(value_type&& value) {
+        return ht_.insert_unique(mstl::move(value));
+    }
+
+    iterator insert(const_iterator hint, const value_type& value) {
+        return ht_.insert_unique_use_hint(hint, value);
+    }
+
+    iterator insert(const_iterator hint, value_type&& value) {
+        return ht_.insert_unique_use_hint(hint, mstl::move(value));
+    }
+
+    template<typename InputIter>
+    void insert(InputIter first, InputIter last) {
+        ht_.insert_unique(first, last);
+    }
+
+    // 返回被删除元素的下一个位置
+    iterator erase(const_iterator iter) {
+        return ht_.erase(iter);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        return ht_.erase(first, last);
+    }
+
+    size_type erase(const key_type& key) {
+        return ht_.erase_unique(key);
+    }
+
+    void clear() {
+        ht_.clear();
+    }
+
+    void swap(flat_hash_map& rhs) noexcept {
+        ht_.swap(rhs.ht_);
+    }
+
+    mapped_type& at(const key_type& key) {
+        iterator iter = ht_.find(key);
+        THROW_OUT_OF_RANGE_IF(iter == end(), "flat_hash_map<Key, T> no such element exists");
+        return iter->second;
+    }
+
+    const mapped_type& at(const key_type& key) const {
+        const_iterator iter = ht_.find(key);
+        THROW_OUT_OF_RANGE_IF(iter == end(), "flat_hash_map<Key, T> no such element exists");
+        return iter->second;
+    }
+
+    mapped_type& operator[](const key_type& key) {
+        return ht_.try_emplace_key(key, T()).first->second;
+    }
+
+    mapped_type& operator[](key_type&& key) {
+        return ht_.try_emplace_key(mstl::move(key), T()).first->second;
+    }
+
+    size_type count(const key_type& key) const {
+        return ht_.count(key);
+    }
+
+    iterator find(const key_type& key) {
+        return ht_.find(key);
+    }
+
+    const_iterator find(const key_type& key) const {
+        return ht_.find(key);
+    }
+
+    pair<iterator, iterator> equal_range(const key_type& key) {
+        return ht_.equal_range_unique(key);
+    }
+
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+        return ht_.equal_range_unique(key);
+    }
+
+    // 槽位个数相当于bucket个数
+    size_type bucket_count() const noexcept {
+        return ht_.bucket_count();
+    }
+
+    size_type max_bucket_count() const noexcept {
+        return ht_.max_bucket_count();
+    }
+
+    float load_factor() const noexcept {
+        return ht_.load_factor();
+    }
+
+    float max_load_factor() const noexcept {
+        return ht_.max_load_factor();
+    }
+
+    void max_load_factor(float ml) {
+        ht_.max_load_factor(ml);
+    }
+
+    void rehash(const size_type count) {
+        ht_.rehash(count);
+    }
+
+    void reserve(const size_type count) {
+        ht_.reserve(count);
+    }
+
+    hasher hash_func() const {
+        return ht_.hash_func();
+    }
+
+    key_equal key_eq() const {
+        return ht_.key_eq();
+    }
+
+public:
+    friend bool operator==(const flat_hash_map& lhs, const flat_hash_map& rhs) {
+        return lhs.ht_.equal_to_unique(rhs.ht_);
+    }
+
+    friend bool operator!=(const flat_hash_map& lhs, const flat_hash_map& rhs) {
+        return !lhs.ht_.equal_to_unique(rhs.ht_);
+    }
+};
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void swap(flat_hash_map<Key, T, Hash, KeyEqual>& lhs,
+          flat_hash_map<Key, T, Hash, KeyEqual>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // mstl
+
+#endif
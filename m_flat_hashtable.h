@@ -0,0 +1,801 @@
+#ifndef M_FLAT_HASHTABLE_H_
+#define M_FLAT_HASHTABLE_H_
+
+// 开放寻址的哈希表flat_hashtable，flat_hash_map与flat_hash_set的底层容器
+// 元素直接存放在连续的槽位数组slots_中，另有一个每个槽位一字节的控制数组ctrl_：
+//   flat_ctrl_empty     空槽位
+//   flat_ctrl_deleted   被删除的槽位（墓碑），查找时需要越过它继续探测
+//   flat_ctrl_sentinel  位于ctrl_[capacity_]，迭代器遍历到此处结束
+//   0~127               已占用的槽位，保存哈希值的低7位H2
+// 槽位按16个一组划分，哈希值的其余位H1决定起始组，查找时一次比较一整组的16个控制字节，
+// 只有H2相同的槽位才需要调用equal_比较键值，遇到含有空槽位的组即可确定查找失败。
+// 组之间按三角数序列探测，组数为2的幂次时可以遍历所有组。
+// 支持SSE2时使用SSE2指令比较控制字节，否则使用逐字节比较的实现。
+// 注意：插入可能导致扩容，使所有迭代器和元素的引用失效；删除只使被删除元素的迭代器失效
+
+#include <initializer_list>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MSTL_FLAT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "m_hashtable.h"
+#include "m_util.h"
+#include "m_functional.h"
+#include "m_memory.h"
+#include "m_exceptdef.h"
+
+namespace mstl {
+
+typedef int8_t flat_ctrl_t;
+
+static constexpr flat_ctrl_t flat_ctrl_empty = -128;
+static constexpr flat_ctrl_t flat_ctrl_deleted = -2;
+static constexpr flat_ctrl_t flat_ctrl_sentinel = -1;
+
+// 每组的槽位个数
+#define FLAT_GROUP_WIDTH 16
+
+// 返回最低位的1所在的位置，x不能为0
+inline uint32_t flat_trailing_zeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#elif defined(_MSC_VER)
+    unsigned long r;
+    _BitScanForward(&r, x);
+    return static_cast<uint32_t>(r);
+#else
+    uint32_t r = 0;
+    while ((x & 1u) == 0) {
+        x >>= 1;
+        ++r;
+    }
+    return r;
+#endif
+}
+
+// 对用户提供的哈希值再做一次混合，用户的哈希函数不一定充分混合（例如恒等映射），
+// 直接取低7位与高位会使大量键值落在同一组且H2相同。
+// mstl::hash等声明了is_avalanching的哈希函数输出已经充分混合，不再经过这里
+inline size_t flat_hash_mix(size_t h) {
+#if defined(SYSTEM_64) && defined(__SIZEOF_INT128__)
+    const unsigned __int128 m = static_cast<unsigned __int128>(h) * 0x9e3779b97f4a7c15ull;
+    return static_cast<size_t>(m) ^ static_cast<size_t>(m >> 64);
+#elif defined(SYSTEM_64)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+#else
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+#endif
+}
+
+// 一组控制字节，match系列函数返回的掩码中第i位为1表示组内第i个槽位满足条件
+struct flat_group {
+#ifdef MSTL_FLAT_SSE2
+    __m128i ctrl;
+
+    explicit flat_group(const flat_ctrl_t* p)
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+    uint32_t match(flat_ctrl_t h2) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+    }
+
+    uint32_t match_empty() const {
+        return match(flat_ctrl_empty);
+    }
+
+    // flat_ctrl_empty与flat_ctrl_deleted都小于flat_ctrl_sentinel，已占用的槽位都大于flat_ctrl_sentinel
+    uint32_t match_empty_or_deleted() const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(flat_ctrl_sentinel), ctrl)));
+    }
+#else
+    const flat_ctrl_t* ctrl;
+
+    explicit flat_group(const flat_ctrl_t* p) : ctrl(p) {}
+
+    uint32_t match(flat_ctrl_t h2) const {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < FLAT_GROUP_WIDTH; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_empty() const {
+        return match(flat_ctrl_empty);
+    }
+
+    uint32_t match_empty_or_deleted() const {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < FLAT_GROUP_WIDTH; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] < flat_ctrl_sentinel) << i;
+        }
+        return mask;
+    }
+#endif
+};
+
+// 空表共用的控制数组，只有一个flat_ctrl_sentinel，使空表的begin() == end()且不需要申请内存
+inline flat_ctrl_t* flat_empty_ctrl() {
+    static flat_ctrl_t sentinel = flat_ctrl_sentinel;
+    return &sentinel;
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+class flat_hashtable;
+
+template<typename T, typename Hash, typename KeyEqual>
+struct flat_ht_const_iterator;
+
+template<typename T, typename Hash, typename KeyEqual>
+struct flat_ht_iterator : public mstl::iterator<mstl::forward_iterator_tag, T> {
+    typedef flat_ht_iterator<T, Hash, KeyEqual>        self;
+    typedef T                                          value_type;
+    typedef value_type*                                pointer;
+    typedef value_type&                                reference;
+
+    flat_ctrl_t* ctrl;
+    pointer      slot;
+
+    flat_ht_iterator() = default;
+
+    flat_ht_iterator(flat_ctrl_t* c, pointer s) : ctrl(c), slot(s) {}
+
+    reference operator*() const {
+        return *slot;
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(*ctrl >= 0);
+        ++ctrl;
+        ++slot;
+        skip_empty_or_deleted();
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*this;
+        return temp;
+    }
+
+    // 跳过空槽位与墓碑，遇到已占用的槽位或flat_ctrl_sentinel时停止
+    void skip_empty_or_deleted() {
+        while (*ctrl < flat_ctrl_sentinel) {
+            ++ctrl;
+            ++slot;
+        }
+    }
+
+    bool operator==(const self& rhs) const {
+        return ctrl == rhs.ctrl;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return ctrl != rhs.ctrl;
+    }
+};
+
+template<typename T, typename Hash, typename KeyEqual>
+struct flat_ht_const_iterator : public mstl::iterator<mstl::forward_iterator_tag, T> {
+    typedef flat_ht_const_iterator<T, Hash, KeyEqual>  self;
+    typedef flat_ht_iterator<T, Hash, KeyEqual>        iterator;
+    typedef T                                          value_type;
+    typedef const value_type*                          pointer;
+    typedef const value_type&                          reference;
+
+    const flat_ctrl_t* ctrl;
+    pointer            slot;
+
+    flat_ht_const_iterator() = default;
+
+    flat_ht_const_iterator(const flat_ctrl_t* c, pointer s) : ctrl(c), slot(s) {}
+
+    flat_ht_const_iterator(const iterator& rhs) : ctrl(rhs.ctrl), slot(rhs.slot) {}
+
+    reference operator*() const {
+        return *slot;
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(*ctrl >= 0);
+        ++ctrl;
+        ++slot;
+        while (*ctrl < flat_ctrl_sentinel) {
+            ++ctrl;
+            ++slot;
+        }
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*this;
+        return temp;
+    }
+
+    bool operator==(const self& rhs) const {
+        return ctrl == rhs.ctrl;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return ctrl != rhs.ctrl;
+    }
+};
+
+template<typename T, typename Hash, typename KeyEqual>
+class flat_hashtable {
+public:
+    typedef ht_value_traits<T>                               value_traits;
+    typedef typename value_traits::key_type                  key_type;
+    typedef typename value_traits::mapped_type               mapped_type;
+    typedef typename value_traits::value_type                value_type;
+    typedef Hash                                             hasher;
+    typedef KeyEqual                                         key_equal;
+
+    typedef mstl::allocator<T>                               allocator_type;
+    typedef mstl::allocator<T>                               data_allocator;
+    typedef mstl::allocator<flat_ctrl_t>                     ctrl_allocator;
+
+    typedef typename allocator_type::pointer                 pointer;
+    typedef typename allocator_type::const_pointer           const_pointer;
+    typedef typename allocator_type::reference               reference;
+    typedef typename allocator_type::const_reference         const_reference;
+    typedef typename allocator_type::size_type               size_type;
+    typedef typename allocator_type::difference_type         difference_type;
+
+    typedef mstl::flat_ht_iterator<T, Hash, KeyEqual>        iterator;
+    typedef mstl::flat_ht_const_iterator<T, Hash, KeyEqual>  const_iterator;
+
+    allocator_type get_allocator() const {
+        return allocator_type();
+    }
+
+private:
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    flat_ctrl_t* ctrl_;
+    pointer      slots_;
+    // 槽位个数，为0或者FLAT_GROUP_WIDTH乘以2的幂次
+    size_type    capacity_;
+    size_type    size_;
+    // 在需要扩容之前还能占用的空槽位个数，最大负载因子为7/8
+    size_type    growth_left_;
+    hasher       hash_;
+    key_equal    equal_;
+
+public:
+    explicit flat_hashtable(size_type bucket_count, const Hash& hash = Hash(),
+                            const KeyEqual& equal = KeyEqual())
+        : ctrl_(flat_empty_ctrl()), slots_(nullptr), capacity_(0), size_(0),
+          growth_left_(0), hash_(hash), equal_(equal) {
+        if (bucket_count != 0) {
+            resize(normalize_capacity(bucket_count));
+        }
+    }
+
+    flat_hashtable(const flat_hashtable& rhs)
+        : ctrl_(flat_empty_ctrl()), slots_(nullptr), capacity_(0), size_(0),
+          growth_left_(0), hash_(rhs.hash_), equal_(rhs.equal_) {
+        reserve(rhs.size_);
+        try {
+            for (const_iterator it = rhs.begin(); it != rhs.end(); ++it) {
+                const size_t h = hash_of(value_traits::get_key(*it));
+                const size_type i = find_first_non_full(h);
+                data_allocator::construct(slots_ + i, *it);
+                finish_insert(i, h);
+            }
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    flat_hashtable(flat_hashtable&& rhs) noexcept
+        : ctrl_(rhs.ctrl_), slots_(rhs.slots_), capacity_(rhs.capacity_), size_(rhs.size_),
+          growth_left_(rhs.growth_left_), hash_(rhs.hash_), equal_(rhs.equal_) {
+        rhs.reset_empty();
+    }
+
+    flat_hashtable& operator=(const flat_hashtable& rhs) {
+        if (this != &rhs) {
+            flat_hashtable temp(rhs);
+            swap(temp);
+        }
+        return *this;
+    }
+
+    flat_hashtable& operator=(flat_hashtable&& rhs) noexcept {
+        if (this != &rhs) {
+            flat_hashtable temp(mstl::move(rhs));
+            swap(temp);
+        }
+        return *this;
+    }
+
+    ~flat_hashtable() {
+        destroy_all();
+    }
+
+    iterator begin() noexcept {
+        iterator it(ctrl_, slots_);
+        it.skip_empty_or_deleted();
+        return it;
+    }
+
+    const_iterator begin() const noexcept {
+        return const_cast<flat_hashtable*>(this)->begin();
+    }
+
+    iterator end() noexcept {
+        return iterator(ctrl_ + capacity_, slots_ + capacity_);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(ctrl_ + capacity_, slots_ + capacity_);
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    size_type max_size() const noexcept {
+        return static_cast<size_type>(-1) / sizeof(value_type);
+    }
+
+    // 先在栈上构造出元素得到键值，键值不存在时再移动到槽位中
+    template<typename... Args>
+    pair<iterator, bool> emplace_unique(Args&&... args) {
+        value_type value(mstl::forward<Args>(args)...);
+        return insert_unique(mstl::move(value));
+    }
+
+    template<typename... Args>
+    iterator emplace_unique_use_hint(const_iterator /*hint*/, Args&&... args) {
+        return emplace_unique(mstl::forward<Args>(args)...).first;
+    }
+
+    pair<iterator, bool> insert_unique(const value_type& value) {
+        return insert_with_key(value_traits::get_key(value), value);
+    }
+
+    pair<iterator, bool> insert_unique(value_type&& value) {
+        return insert_with_key(value_traits::get_key(value), mstl::move(value));
+    }
+
+    iterator insert_unique_use_hint(const_iterator /*hint*/, const value_type& value) {
+        return insert_unique(value).first;
+    }
+
+    iterator insert_unique_use_hint(const_iterator /*hint*/, value_type&& value) {
+        return insert_unique(mstl::move(value)).first;
+    }
+
+    template<typename InputIter>
+    void insert_unique(InputIter first, InputIter last) {
+        for (; first != last; ++first) {
+            insert_unique(*first);
+        }
+    }
+
+    // 键值不存在时用key与args构造元素，用于operator[]，避免先构造出完整的元素
+    template<typename K, typename... Args>
+    pair<iterator, bool> try_emplace_key(K&& key, Args&&... args);
+
+    // 删除槽位i中的元素：所在组中还有空槽位时，没有探测序列会越过这一组，可以直接置为flat_ctrl_empty
+    iterator erase(const_iterator pos) {
+        MSTL_DEBUG(pos != cend() && *pos.ctrl >= 0);
+        const size_type i = static_cast<size_type>(pos.ctrl - ctrl_);
+        erase_at(i);
+        iterator it(ctrl_ + i, slots_ + i);
+        it.skip_empty_or_deleted();
+        return it;
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        while (first != last) {
+            first = erase(first);
+        }
+        return iterator(const_cast<flat_ctrl_t*>(last.ctrl), const_cast<pointer>(last.slot));
+    }
+
+    size_type erase_unique(const key_type& key) {
+        const size_type i = find_index(key, hash_of(key));
+        if (i == npos) {
+            return 0;
+        }
+        erase_at(i);
+        return 1;
+    }
+
+    void clear();
+
+    void swap(flat_hashtable& rhs) noexcept {
+        mstl::swap(ctrl_, rhs.ctrl_);
+        mstl::swap(slots_, rhs.slots_);
+        mstl::swap(capacity_, rhs.capacity_);
+        mstl::swap(size_, rhs.size_);
+        mstl::swap(growth_left_, rhs.growth_left_);
+        mstl::swap(hash_, rhs.hash_);
+        mstl::swap(equal_, rhs.equal_);
+    }
+
+    // 查找相关
+    size_type count(const key_type& key) const {
+        return find_index(key, hash_of(key)) == npos ? 0 : 1;
+    }
+
+    iterator find(const key_type& key) {
+        const size_type i = find_index(key, hash_of(key));
+        return i == npos ? end() : iterator(ctrl_ + i, slots_ + i);
+    }
+
+    const_iterator find(const key_type& key) const {
+        const size_type i = find_index(key, hash_of(key));
+        return i == npos ? end() : const_iterator(ctrl_ + i, slots_ + i);
+    }
+
+    pair<iterator, iterator> equal_range_unique(const key_type& key) {
+        iterator it = find(key);
+        if (it == end()) {
+            return mstl::make_pair(it, it);
+        }
+        iterator next = it;
+        return mstl::make_pair(it, ++next);
+    }
+
+    pair<const_iterator, const_iterator> equal_range_unique(const key_type& key) const {
+        const_iterator it = find(key);
+        if (it == end()) {
+            return mstl::make_pair(it, it);
+        }
+        const_iterator next = it;
+        return mstl::make_pair(it, ++next);
+    }
+
+    // 槽位个数相当于unordered_map的bucket个数
+    size_type bucket_count() const noexcept {
+        return capacity_;
+    }
+
+    size_type max_bucket_count() const noexcept {
+        return max_size();
+    }
+
+    float load_factor() const noexcept {
+        return capacity_ != 0 ? (float)size_ / capacity_ : 0.0f;
+    }
+
+    // 最大负载因子固定为7/8，设置的值被忽略，只是为了与unordered_map的接口兼容
+    float max_load_factor() const noexcept {
+        return 0.875f;
+    }
+
+    void max_load_factor(float ml) {
+        THROW_OUT_OF_RANGE_IF(ml != ml || ml < 0, "invalid hash load factor!");
+    }
+
+    // 槽位个数至少为count，同时能容纳当前所有元素
+    void rehash(size_type count);
+
+    // 保证元素个数达到count之前不会扩容
+    void reserve(size_type count) {
+        if (count > capacity_ - capacity_ / 8) {
+            resize(capacity_for(count));
+        }
+    }
+
+    hasher hash_func() const {
+        return hash_;
+    }
+
+    key_equal key_eq() const {
+        return equal_;
+    }
+
+    bool equal_to_unique(const flat_hashtable& other) const {
+        if (size_ != other.size_) {
+            return false;
+        }
+        for (const_iterator it = begin(); it != end(); ++it) {
+            const_iterator res = other.find(value_traits::get_key(*it));
+            if (res == other.end() || !(*res == *it)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    size_t hash_of(const key_type& key) const {
+        return hash_of(key, mstl::is_avalanching<Hash>());
+    }
+
+    size_t hash_of(const key_type& key, mstl::true_type) const {
+        return hash_(key);
+    }
+
+    size_t hash_of(const key_type& key, mstl::false_type) const {
+        return flat_hash_mix(hash_(key));
+    }
+
+    static flat_ctrl_t h2(size_t h) {
+        return static_cast<flat_ctrl_t>(h & 0x7f);
+    }
+
+    size_type group_mask() const {
+        return capacity_ / FLAT_GROUP_WIDTH - 1;
+    }
+
+    // 不小于n的最小合法槽位个数
+    static size_type normalize_capacity(size_type n) {
+        size_type cap = FLAT_GROUP_WIDTH;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    // 能够容纳count个元素的最小槽位个数
+    static size_type capacity_for(size_type count) {
+        size_type cap = normalize_capacity(count);
+        while (cap - cap / 8 < count) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    void reset_empty() noexcept {
+        ctrl_ = flat_empty_ctrl();
+        slots_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        growth_left_ = 0;
+    }
+
+    size_type find_index(const key_type& key, size_t h) const;
+    size_type find_first_non_full(size_t h) const;
+    void finish_insert(size_type i, size_t h);
+    size_type prepare_insert(size_t h);
+    void erase_at(size_type i);
+
+    template<typename V>
+    pair<iterator, bool> insert_with_key(const key_type& key, V&& value);
+
+    void resize(size_type new_capacity);
+    void destroy_all();
+};
+
+template<typename T, typename Hash, typename KeyEqual>
+constexpr typename flat_hashtable<T, Hash, KeyEqual>::size_type flat_hashtable<T, Hash, KeyEqual>::npos;
+
+// 在探测序列上逐组查找，找到返回槽位下标，否则返回npos
+template<typename T, typename Hash, typename KeyEqual>
+typename flat_hashtable<T, Hash, KeyEqual>::size_type
+flat_hashtable<T, Hash, KeyEqual>::find_index(const key_type& key, size_t h) const {
+    if (capacity_ == 0) {
+        return npos;
+    }
+    const size_type mask = group_mask();
+    size_type g = (h >> 7) & mask;
+    for (size_type step = 1; ; ++step) {
+        const size_type base = g * FLAT_GROUP_WIDTH;
+        const flat_group group(ctrl_ + base);
+        for (uint32_t m = group.match(h2(h)); m != 0; m &= m - 1) {
+            const size_type i = base + flat_trailing_zeros(m);
+            if (equal_(value_traits::get_key(slots_[i]), key)) {
+                return i;
+            }
+        }
+        if (group.match_empty() != 0) {
+            return npos;
+        }
+        // 组数最多为capacity_ / FLAT_GROUP_WIDTH，负载因子不超过7/8，一定存在含有空槽位的组
+        g = (g + step) & mask;
+    }
+}
+
+// 返回探测序列上第一个空槽位或墓碑
+template<typename T, typename Hash, typename KeyEqual>
+typename flat_hashtable<T, Hash, KeyEqual>::size_type
+flat_hashtable<T, Hash, KeyEqual>::find_first_non_full(size_t h) const {
+    const size_type mask = group_mask();
+    size_type g = (h >> 7) & mask;
+    for (size_type step = 1; ; ++step) {
+        const size_type base = g * FLAT_GROUP_WIDTH;
+        const uint32_t m = flat_group(ctrl_ + base).match_empty_or_deleted();
+        if (m != 0) {
+            return base + flat_trailing_zeros(m);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+// 元素构造完成后再标记槽位，构造抛出异常时表的状态不变
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::finish_insert(size_type i, size_t h) {
+    if (ctrl_[i] == flat_ctrl_empty) {
+        --growth_left_;
+    }
+    ctrl_[i] = h2(h);
+    ++size_;
+}
+
+// 为哈希值为h的新元素找到槽位，没有剩余空间时先扩容
+template<typename T, typename Hash, typename KeyEqual>
+typename flat_hashtable<T, Hash, KeyEqual>::size_type
+flat_hashtable<T, Hash, KeyEqual>::prepare_insert(size_t h) {
+    if (growth_left_ == 0) {
+        if (capacity_ == 0) {
+            resize(FLAT_GROUP_WIDTH);
+        } else if (size_ <= (capacity_ - capacity_ / 8) / 2) {
+            // 空间主要被墓碑占据，以相同的大小重建即可
+            resize(capacity_);
+        } else {
+            resize(capacity_ * 2);
+        }
+    }
+    return find_first_non_full(h);
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::erase_at(size_type i) {
+    data_allocator::destory(slots_ + i);
+    const size_type base = i & ~static_cast<size_type>(FLAT_GROUP_WIDTH - 1);
+    if (flat_group(ctrl_ + base).match_empty() != 0) {
+        ctrl_[i] = flat_ctrl_empty;
+        ++growth_left_;
+    } else {
+        ctrl_[i] = flat_ctrl_deleted;
+    }
+    --size_;
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+template<typename V>
+pair<typename flat_hashtable<T, Hash, KeyEqual>::iterator, bool>
+flat_hashtable<T, Hash, KeyEqual>::insert_with_key(const key_type& key, V&& value) {
+    const size_t h = hash_of(key);
+    size_type i = find_index(key, h);
+    if (i != npos) {
+        return mstl::make_pair(iterator(ctrl_ + i, slots_ + i), false);
+    }
+    i = prepare_insert(h);
+    data_allocator::construct(slots_ + i, mstl::forward<V>(value));
+    finish_insert(i, h);
+    return mstl::make_pair(iterator(ctrl_ + i, slots_ + i), true);
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+template<typename K, typename... Args>
+pair<typename flat_hashtable<T, Hash, KeyEqual>::iterator, bool>
+flat_hashtable<T, Hash, KeyEqual>::try_emplace_key(K&& key, Args&&... args) {
+    const size_t h = hash_of(key);
+    size_type i = find_index(key, h);
+    if (i != npos) {
+        return mstl::make_pair(iterator(ctrl_ + i, slots_ + i), false);
+    }
+    i = prepare_insert(h);
+    data_allocator::construct(slots_ + i, mstl::forward<K>(key), mstl::forward<Args>(args)...);
+    finish_insert(i, h);
+    return mstl::make_pair(iterator(ctrl_ + i, slots_ + i), true);
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::clear() {
+    if (capacity_ == 0) {
+        return;
+    }
+    for (size_type i = 0; i < capacity_; ++i) {
+        if (ctrl_[i] >= 0) {
+            data_allocator::destory(slots_ + i);
+        }
+    }
+    std::memset(ctrl_, flat_ctrl_empty, capacity_);
+    size_ = 0;
+    growth_left_ = capacity_ - capacity_ / 8;
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::rehash(size_type count) {
+    if (size_ == 0 && count == 0) {
+        // 空表rehash(0)时释放全部内存
+        destroy_all();
+        return;
+    }
+    const size_type new_capacity = mstl::max(normalize_capacity(count), capacity_for(size_));
+    if (new_capacity != capacity_) {
+        resize(new_capacity);
+    }
+}
+
+// 申请新的槽位数组，把所有元素移动过去，同时清除所有墓碑
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::resize(size_type new_capacity) {
+    flat_ctrl_t* old_ctrl = ctrl_;
+    pointer old_slots = slots_;
+    const size_type old_capacity = capacity_;
+
+    THROW_LENGTH_ERROR_IF(new_capacity > max_size(), "flat_hashtable<T> size too big");
+    flat_ctrl_t* new_ctrl = ctrl_allocator::allocate(new_capacity + 1);
+    pointer new_slots;
+    try {
+        new_slots = data_allocator::allocate(new_capacity);
+    } catch (...) {
+        ctrl_allocator::deallocate(new_ctrl, new_capacity + 1);
+        throw;
+    }
+    std::memset(new_ctrl, flat_ctrl_empty, new_capacity);
+    new_ctrl[new_capacity] = flat_ctrl_sentinel;
+
+    ctrl_ = new_ctrl;
+    slots_ = new_slots;
+    capacity_ = new_capacity;
+    growth_left_ = new_capacity - new_capacity / 8 - size_;
+    for (size_type i = 0; i < old_capacity; ++i) {
+        if (old_ctrl[i] >= 0) {
+            const size_t h = hash_of(value_traits::get_key(old_slots[i]));
+            const size_type j = find_first_non_full(h);
+            data_allocator::construct(slots_ + j, mstl::move(old_slots[i]));
+            data_allocator::destory(old_slots + i);
+            ctrl_[j] = h2(h);
+        }
+    }
+    if (old_capacity != 0) {
+        ctrl_allocator::deallocate(old_ctrl, old_capacity + 1);
+        data_allocator::deallocate(old_slots, old_capacity);
+    }
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+void flat_hashtable<T, Hash, KeyEqual>::destroy_all() {
+    if (capacity_ == 0) {
+        return;
+    }
+    clear();
+    ctrl_allocator::deallocate(ctrl_, capacity_ + 1);
+    data_allocator::deallocate(slots_, capacity_);
+    reset_empty();
+}
+
+template<typename T, typename Hash, typename KeyEqual>
+void swap(flat_hashtable<T, Hash, KeyEqual>& lhs, flat_hashtable<T, Hash, KeyEqual>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // mstl
+
+#endif
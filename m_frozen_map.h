@@ -0,0 +1,443 @@
+#ifndef M_FROZEN_MAP_H_
+#define M_FROZEN_MAP_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "m_util.h"
+#include "m_functional.h"
+#include "m_basic_string.h"
+#include "m_exceptdef.h"
+
+namespace mstl {
+
+// 编译期构建的只读表frozen_map与frozen_set，用于关键字表、操作码表等在编译时就确定的小型表。
+// 构建时用CHD (compress, hash and displace) 方法寻找完美哈希：
+//   每个键先计算一次64位哈希值h，h的高32位选出所在的组，
+//   每组保存一个位移d，键的槽位由h与d再混合一次得到，从大组到小组依次为每组寻找使组内所有键都落在空槽位上的d。
+// 槽位数为不小于N的2的幂，查找时计算一次哈希值，读出组的位移与槽位中的元素下标，再比较一次键，
+// 没有bucket也没有节点。找不到完美哈希时换一个种子重试，键重复时编译失败。
+// 元素按给出的顺序保存，迭代顺序与字面量中的顺序相同
+
+// 编译期可用的字符串，保存指针与长度，不拥有字符。字面量、const char*与mstl::string都可以隐式转换，
+// 查找时不需要构造临时的字符串对象
+class frozen_string {
+public:
+    constexpr frozen_string() noexcept : data_(""), size_(0) {}
+
+    constexpr frozen_string(const char* s, size_t n) noexcept : data_(s), size_(n) {}
+
+    constexpr frozen_string(const char* s) noexcept : data_(s), size_(length_of(s)) {}
+
+    template<typename CharTraits>
+    frozen_string(const mstl::basic_string<char, CharTraits>& s) noexcept : data_(s.data()), size_(s.length()) {}
+
+    constexpr const char* data() const noexcept {
+        return data_;
+    }
+
+    constexpr size_t size() const noexcept {
+        return size_;
+    }
+
+    constexpr size_t length() const noexcept {
+        return size_;
+    }
+
+    constexpr bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    constexpr char operator[](size_t n) const noexcept {
+        return data_[n];
+    }
+
+    friend constexpr bool operator==(const frozen_string& lhs, const frozen_string& rhs) noexcept {
+        if (lhs.size_ != rhs.size_) {
+            return false;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        // __builtin_memcmp在常量表达式中也可以求值
+        return lhs.size_ == 0 || __builtin_memcmp(lhs.data_, rhs.data_, lhs.size_) == 0;
+#else
+        for (size_t i = 0; i < lhs.size_; ++i) {
+            if (lhs.data_[i] != rhs.data_[i]) {
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    friend constexpr bool operator!=(const frozen_string& lhs, const frozen_string& rhs) noexcept {
+        return !(lhs == rhs);
+    }
+
+private:
+    static constexpr size_t length_of(const char* s) noexcept {
+        size_t n = 0;
+        while (s[n] != '\0') {
+            ++n;
+        }
+        return n;
+    }
+
+    const char* data_;
+    size_t      size_;
+};
+
+// 普通的哈希仿函数也能用于frozen_string
+template<>
+struct hash<frozen_string> : public unarg_function<frozen_string, size_t> {
+    typedef void is_avalanching;
+
+    constexpr size_t operator()(const frozen_string& s) const noexcept {
+        return mstl::hash_chars(s.data(), s.size());
+    }
+};
+
+// 带种子的哈希函数，构建失败重试时改变种子即可得到另一组哈希值，需要能在编译期求值。
+// 整数与mstl::hash相同经过hash_mum混合，字符串使用hash_chars64，32位平台上也得到完整的64位哈希值
+template<typename Key>
+struct frozen_hash {
+    static_assert(std::is_integral<Key>::value || std::is_enum<Key>::value,
+                  "frozen_hash<Key> supports integral, enum and frozen_string keys");
+
+    constexpr uint64_t operator()(const Key& key, uint64_t seed) const noexcept {
+        return hash_mum(static_cast<uint64_t>(key) ^ 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull ^ seed);
+    }
+};
+
+template<>
+struct frozen_hash<frozen_string> {
+    constexpr uint64_t operator()(const frozen_string& key, uint64_t seed) const noexcept {
+        return mstl::hash_chars64(key.data(), key.size(), seed);
+    }
+};
+
+// 不小于n的2的幂
+constexpr size_t frozen_table_size(size_t n) noexcept {
+    size_t m = 1;
+    while (m < n) {
+        m <<= 1;
+    }
+    return m;
+}
+
+// 完美哈希的参数：种子、每组的位移以及每个槽位中元素的下标。
+// 空槽位的下标为0，查找落到空槽位时与0号元素比较必然不相等，因此不需要单独标记
+template<size_t N>
+struct frozen_phf_table {
+    static constexpr size_t table_size = frozen_table_size(N);
+
+    uint64_t seed;
+    uint32_t disp[table_size];
+    uint32_t index[table_size];
+
+    constexpr size_t group(uint64_t h) const noexcept {
+        return static_cast<size_t>(h >> 32) & (table_size - 1);
+    }
+
+    static constexpr size_t slot(uint64_t h, uint32_t d) noexcept {
+        return static_cast<size_t>(hash_mum(h ^ 0x4b33a62ed433d4a3ull, d ^ 0x4d5a2da51de1aa47ull)) & (table_size - 1);
+    }
+
+    // 键的哈希值为h时应当比较的元素下标
+    constexpr size_t lookup(uint64_t h) const noexcept {
+        return index[slot(h, disp[group(h)])];
+    }
+};
+
+template<size_t N>
+constexpr size_t frozen_phf_table<N>::table_size;
+
+// 每组的位移最多尝试的次数，超过后更换种子
+#ifndef MSTL_FROZEN_MAX_DISPLACEMENT
+#define MSTL_FROZEN_MAX_DISPLACEMENT (1u << 16)
+#endif
+
+// 以种子seed构建，失败时返回false，键重复时抛出异常 (在常量表达式中即为编译错误)
+template<size_t N, typename Item, typename KeyOf, typename Hash>
+constexpr bool frozen_phf_try(const Item (&items)[N], KeyOf key_of, Hash hash, uint64_t seed,
+                              frozen_phf_table<N>& t) {
+    constexpr size_t M = frozen_phf_table<N>::table_size;
+    uint64_t h[N] = {};
+    // 按组做计数排序，order中同一组的元素相邻，first[g]到first[g + 1]为第g组
+    uint32_t first[M + 1] = {};
+    uint32_t order[N] = {};
+    bool used[M] = {};
+    for (size_t i = 0; i < N; ++i) {
+        h[i] = hash(key_of(items[i]), seed);
+        ++first[t.group(h[i]) + 1];
+    }
+    size_t max_group = 0;
+    for (size_t g = 0; g < M; ++g) {
+        if (first[g + 1] > max_group) {
+            max_group = first[g + 1];
+        }
+        first[g + 1] += first[g];
+    }
+    {
+        uint32_t cursor[M] = {};
+        for (size_t i = 0; i < N; ++i) {
+            const size_t g = t.group(h[i]);
+            order[first[g] + cursor[g]++] = static_cast<uint32_t>(i);
+        }
+    }
+    for (size_t g = 0; g < M; ++g) {
+        t.disp[g] = 0;
+        t.index[g] = 0;
+    }
+    t.seed = seed;
+    // 从大组到小组依次放置，大组越早放置越容易找到位移
+    for (size_t size = max_group; size > 0; --size) {
+        for (size_t g = 0; g < M; ++g) {
+            if (first[g + 1] - first[g] != size) {
+                continue;
+            }
+            const uint32_t* members = order + first[g];
+            for (size_t a = 0; a < size; ++a) {
+                for (size_t b = a + 1; b < size; ++b) {
+                    THROW_LOGIC_ERROR_IF(h[members[a]] == h[members[b]] &&
+                                         key_of(items[members[a]]) == key_of(items[members[b]]),
+                                         "frozen_map: duplicate key");
+                }
+            }
+            uint32_t d = 0;
+            for (; d < MSTL_FROZEN_MAX_DISPLACEMENT; ++d) {
+                bool ok = true;
+                for (size_t a = 0; a < size && ok; ++a) {
+                    const size_t s = t.slot(h[members[a]], d);
+                    if (used[s]) {
+                        ok = false;
+                    }
+                    // 同组的键之间也不能冲突
+                    for (size_t b = 0; b < a && ok; ++b) {
+                        if (t.slot(h[members[b]], d) == s) {
+                            ok = false;
+                        }
+                    }
+                }
+                if (ok) {
+                    break;
+                }
+            }
+            if (d == MSTL_FROZEN_MAX_DISPLACEMENT) {
+                return false;
+            }
+            t.disp[g] = d;
+            for (size_t a = 0; a < size; ++a) {
+                const size_t s = t.slot(h[members[a]], d);
+                used[s] = true;
+                t.index[s] = members[a];
+            }
+        }
+    }
+    return true;
+}
+
+template<size_t N, typename Item, typename KeyOf, typename Hash>
+constexpr frozen_phf_table<N> frozen_phf_build(const Item (&items)[N], KeyOf key_of, Hash hash) {
+    frozen_phf_table<N> t{};
+    uint64_t seed = 0;
+    for (; seed < 64; ++seed) {
+        if (frozen_phf_try(items, key_of, hash, seed * 0x9e3779b97f4a7c15ull, t)) {
+            break;
+        }
+    }
+    THROW_LOGIC_ERROR_IF(seed == 64, "frozen_map: no perfect hash found");
+    return t;
+}
+
+// 从元素中取出键
+struct frozen_key_of_pair {
+    template<typename Pair>
+    constexpr const typename Pair::first_type& operator()(const Pair& p) const noexcept {
+        return p.first;
+    }
+};
+
+struct frozen_key_of_self {
+    template<typename T>
+    constexpr const T& operator()(const T& v) const noexcept {
+        return v;
+    }
+};
+
+// frozen_map模板类，第一参数为键的类型，第二参数为值的类型，第三参数为元素个数，
+// 第四参数为带种子的哈希函数，缺省为frozen_hash<>。键与值都需要是字面量类型，键需要支持==
+template<typename Key, typename T, size_t N, typename Hash = mstl::frozen_hash<Key>>
+class frozen_map {
+    static_assert(N > 0, "frozen_map requires at least one element");
+
+public:
+    typedef Key                         key_type;
+    typedef T                           mapped_type;
+    typedef mstl::pair<Key, T>          value_type;
+    typedef Hash                        hasher;
+    typedef size_t                      size_type;
+    typedef const value_type&           const_reference;
+    typedef const value_type*           const_iterator;
+    typedef const_iterator              iterator;
+
+private:
+    value_type          items_[N];
+    hasher              hash_;
+    frozen_phf_table<N> table_;
+
+public:
+    constexpr frozen_map(const value_type (&items)[N], const Hash& hash = Hash())
+        : frozen_map(items, hash, std::make_index_sequence<N>()) {}
+
+    constexpr const_iterator begin() const noexcept {
+        return items_;
+    }
+
+    constexpr const_iterator end() const noexcept {
+        return items_ + N;
+    }
+
+    constexpr const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    constexpr const_iterator cend() const noexcept {
+        return end();
+    }
+
+    constexpr bool empty() const noexcept {
+        return false;
+    }
+
+    constexpr size_type size() const noexcept {
+        return N;
+    }
+
+    constexpr size_type max_size() const noexcept {
+        return N;
+    }
+
+    constexpr size_type bucket_count() const noexcept {
+        return frozen_phf_table<N>::table_size;
+    }
+
+    // 一次哈希，一次下标计算，一次比较
+    constexpr const_iterator find(const key_type& key) const {
+        const value_type* p = items_ + table_.lookup(hash_(key, table_.seed));
+        return p->first == key ? p : end();
+    }
+
+    constexpr size_type count(const key_type& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    constexpr bool contains(const key_type& key) const {
+        return find(key) != end();
+    }
+
+    constexpr const mapped_type& at(const key_type& key) const {
+        const_iterator it = find(key);
+        THROW_OUT_OF_RANGE_IF(it == end(), "frozen_map<Key, T, N> no such element exists");
+        return it->second;
+    }
+
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+        const_iterator it = find(key);
+        return mstl::make_pair(it, it == end() ? it : it + 1);
+    }
+
+private:
+    template<size_t... I>
+    constexpr frozen_map(const value_type (&items)[N], const Hash& hash, std::index_sequence<I...>)
+        : items_{ items[I]... }, hash_(hash), table_(frozen_phf_build(items, frozen_key_of_pair(), hash)) {}
+};
+
+// frozen_set模板类，第一参数为键的类型，第二参数为元素个数，第三参数为带种子的哈希函数
+template<typename Key, size_t N, typename Hash = mstl::frozen_hash<Key>>
+class frozen_set {
+    static_assert(N > 0, "frozen_set requires at least one element");
+
+public:
+    typedef Key                         key_type;
+    typedef Key                         value_type;
+    typedef Hash                        hasher;
+    typedef size_t                      size_type;
+    typedef const value_type&           const_reference;
+    typedef const value_type*           const_iterator;
+    typedef const_iterator              iterator;
+
+private:
+    value_type          items_[N];
+    hasher              hash_;
+    frozen_phf_table<N> table_;
+
+public:
+    constexpr frozen_set(const value_type (&items)[N], const Hash& hash = Hash())
+        : frozen_set(items, hash, std::make_index_sequence<N>()) {}
+
+    constexpr const_iterator begin() const noexcept {
+        return items_;
+    }
+
+    constexpr const_iterator end() const noexcept {
+        return items_ + N;
+    }
+
+    constexpr const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    constexpr const_iterator cend() const noexcept {
+        return end();
+    }
+
+    constexpr bool empty() const noexcept {
+        return false;
+    }
+
+    constexpr size_type size() const noexcept {
+        return N;
+    }
+
+    constexpr size_type max_size() const noexcept {
+        return N;
+    }
+
+    constexpr size_type bucket_count() const noexcept {
+        return frozen_phf_table<N>::table_size;
+    }
+
+    constexpr const_iterator find(const key_type& key) const {
+        const value_type* p = items_ + table_.lookup(hash_(key, table_.seed));
+        return *p == key ? p : end();
+    }
+
+    constexpr size_type count(const key_type& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    constexpr bool contains(const key_type& key) const {
+        return find(key) != end();
+    }
+
+private:
+    template<size_t... I>
+    constexpr frozen_set(const value_type (&items)[N], const Hash& hash, std::index_sequence<I...>)
+        : items_{ items[I]... }, hash_(hash), table_(frozen_phf_build(items, frozen_key_of_self(), hash)) {}
+};
+
+// 由字面量列表构建，元素个数由列表推导，例如
+//   constexpr auto keywords = mstl::make_frozen_map<mstl::frozen_string, int>({{"if", 1}, {"else", 2}});
+template<typename Key, typename T, size_t N>
+constexpr frozen_map<Key, T, N> make_frozen_map(const mstl::pair<Key, T> (&items)[N]) {
+    return frozen_map<Key, T, N>(items);
+}
+
+template<typename Key, size_t N>
+constexpr frozen_set<Key, N> make_frozen_set(const Key (&items)[N]) {
+    return frozen_set<Key, N>(items);
+}
+
+}//mstl
+
+#endif
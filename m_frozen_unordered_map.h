@@ -0,0 +1,614 @@
+#ifndef M_FROZEN_UNORDERED_MAP_H_
+#define M_FROZEN_UNORDERED_MAP_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "m_vector.h"
+#include "m_util.h"
+#include "m_functional.h"
+#include "m_basic_string.h"
+#include "m_exceptdef.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mstl {
+
+// 把unordered_map等键值唯一的表保存为与地址无关的二进制镜像，镜像中只有偏移量没有指针，
+// 可以直接写入文件，之后mmap到任意地址上由frozen_unordered_map只读地查找，不需要反序列化。
+//
+// 镜像的布局依次为：
+//   frozen_image_header
+//   uint32_t bucket_begin[bucket_count + 1]   每个bucket在entry数组中的起止下标
+//   frozen_entry entries[size]                按bucket排列，同一个bucket的entry相邻
+//   数据区                                     每个元素的键与值的序列化结果，顺序与entries相同
+// bucket_count为2的幂，负载在1到2之间，查找只访问一段连续的entry，先比较保存的哈希值再比较键。
+//
+// 键与值通过序列化器写入数据区，序列化器需要提供以下接口：
+//   static constexpr uint64_t tag     类型标记，打开镜像时检查，防止用种类或布局不同的类型读取
+//   static constexpr size_t   align   数据在数据区中的对齐
+//   size_t size(const T& v) const                          序列化后的字节数
+//   void write(const T& v, char* out) const                写入size(v)个字节
+//   T read(const char* p, size_t n) const                  由n个字节恢复出对象
+//   bool equal(const char* p, size_t n, const T& v) const  n个字节是否表示与v相等的对象，查找时调用
+// 可平凡复制的类型使用frozen_pod_serializer按内存原样保存，mstl::basic_string使用frozen_string_serializer。
+// 查找使用的哈希函数必须与保存时相同，镜像只能在字长与字节序相同的机器上打开
+
+// 镜像头，所有偏移量都相对于镜像的起始地址
+struct frozen_image_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t word_size;
+    uint32_t max_align;
+    uint64_t key_tag;
+    uint64_t value_tag;
+    uint64_t size;
+    uint64_t bucket_count;
+    uint64_t shift;
+    uint64_t buckets_offset;
+    uint64_t entries_offset;
+    uint64_t data_offset;
+    uint64_t image_size;
+};
+
+// 每个元素一项，键在数据区中的offset处，值紧接在键之后按值的对齐方式对齐
+struct frozen_entry {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t key_len;
+    uint32_t value_len;
+};
+
+// 可平凡复制的类型按内存原样保存，数据区中的对象可以直接按T读取。
+// 类型标记由种类 (整数、浮点、枚举、指针、其他)、是否有符号、大小与对齐组成，
+// int与float、int与unsigned不会混用，但大小与对齐都相同的两个结构体无法区分
+template<typename T>
+struct frozen_pod_serializer {
+    static_assert(std::is_trivially_copyable<T>::value, "frozen_pod_serializer<T> requires trivially copyable T");
+
+    static constexpr uint64_t kind = std::is_integral<T>::value ? 1 :
+                                     std::is_floating_point<T>::value ? 2 :
+                                     std::is_enum<T>::value ? 3 :
+                                     std::is_pointer<T>::value ? 4 : 0;
+    static constexpr uint64_t tag = (static_cast<uint64_t>(1) << 48) | (kind << 40) |
+                                    (static_cast<uint64_t>(std::is_signed<T>::value) << 32) |
+                                    (static_cast<uint64_t>(sizeof(T)) << 8) | alignof(T);
+    static constexpr size_t   align = alignof(T);
+
+    size_t size(const T&) const noexcept {
+        return sizeof(T);
+    }
+
+    void write(const T& v, char* out) const noexcept {
+        std::memcpy(out, &v, sizeof(T));
+    }
+
+    T read(const char* p, size_t) const noexcept {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    // 不直接比较字节，结构体中的填充字节可能不同
+    bool equal(const char* p, size_t, const T& v) const {
+        return mstl::equal_to<T>()(read(p, sizeof(T)), v);
+    }
+};
+
+template<typename T>
+constexpr uint64_t frozen_pod_serializer<T>::kind;
+
+template<typename T>
+constexpr uint64_t frozen_pod_serializer<T>::tag;
+
+template<typename T>
+constexpr size_t frozen_pod_serializer<T>::align;
+
+// 字符串只保存字符本身，比较时直接比较字节，查找不需要构造字符串
+template<typename String>
+struct frozen_string_serializer {
+    typedef typename String::value_type char_type;
+
+    static constexpr uint64_t tag = (static_cast<uint64_t>(2) << 48) | sizeof(char_type);
+    static constexpr size_t   align = alignof(char_type);
+
+    size_t size(const String& s) const noexcept {
+        return s.length() * sizeof(char_type);
+    }
+
+    void write(const String& s, char* out) const noexcept {
+        if (s.length() != 0) {
+            std::memcpy(out, s.data(), s.length() * sizeof(char_type));
+        }
+    }
+
+    String read(const char* p, size_t n) const {
+        return String(reinterpret_cast<const char_type*>(p), n / sizeof(char_type));
+    }
+
+    bool equal(const char* p, size_t n, const String& s) const noexcept {
+        return n == s.length() * sizeof(char_type) &&
+               (n == 0 || std::memcmp(p, s.data(), n) == 0);
+    }
+};
+
+template<typename String>
+constexpr uint64_t frozen_string_serializer<String>::tag;
+
+template<typename String>
+constexpr size_t frozen_string_serializer<String>::align;
+
+// 缺省的序列化器：字符串按字符保存，其余类型必须可平凡复制
+template<typename T>
+struct frozen_default_serializer {
+    typedef frozen_pod_serializer<T> type;
+};
+
+template<typename CharType, typename CharTraits>
+struct frozen_default_serializer<mstl::basic_string<CharType, CharTraits>> {
+    typedef frozen_string_serializer<mstl::basic_string<CharType, CharTraits>> type;
+};
+
+// 以只读方式把整个文件映射到内存，映射的生存期与对象相同
+class frozen_mapped_file {
+public:
+    frozen_mapped_file() noexcept : data_(nullptr), size_(0) {}
+
+    explicit frozen_mapped_file(const char* path) : data_(nullptr), size_(0) {
+        open(path);
+    }
+
+    frozen_mapped_file(const frozen_mapped_file&) = delete;
+    frozen_mapped_file& operator=(const frozen_mapped_file&) = delete;
+
+    frozen_mapped_file(frozen_mapped_file&& rhs) noexcept : data_(rhs.data_), size_(rhs.size_) {
+        rhs.data_ = nullptr;
+        rhs.size_ = 0;
+    }
+
+    frozen_mapped_file& operator=(frozen_mapped_file&& rhs) noexcept {
+        if (this != &rhs) {
+            close();
+            mstl::swap(data_, rhs.data_);
+            mstl::swap(size_, rhs.size_);
+        }
+        return *this;
+    }
+
+    ~frozen_mapped_file() {
+        close();
+    }
+
+    const char* data() const noexcept {
+        return data_;
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    void open(const char* path);
+    void close() noexcept;
+
+private:
+    const char* data_;
+    size_t      size_;
+};
+
+inline void frozen_mapped_file::open(const char* path) {
+    close();
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    THROW_RUNTIME_ERROR_IF(file == INVALID_HANDLE_VALUE, "frozen_mapped_file: cannot open file");
+    LARGE_INTEGER len;
+    if (!::GetFileSizeEx(file, &len) || len.QuadPart == 0) {
+        ::CloseHandle(file);
+        throw std::runtime_error("frozen_mapped_file: empty or unreadable file");
+    }
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    THROW_RUNTIME_ERROR_IF(mapping == nullptr, "frozen_mapped_file: mapping failed");
+    void* p = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(mapping);
+    THROW_RUNTIME_ERROR_IF(p == nullptr, "frozen_mapped_file: mapping failed");
+    data_ = static_cast<const char*>(p);
+    size_ = static_cast<size_t>(len.QuadPart);
+#else
+    const int fd = ::open(path, O_RDONLY);
+    THROW_RUNTIME_ERROR_IF(fd < 0, "frozen_mapped_file: cannot open file");
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("frozen_mapped_file: empty or unreadable file");
+    }
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后即可关闭文件描述符
+    ::close(fd);
+    THROW_RUNTIME_ERROR_IF(p == MAP_FAILED, "frozen_mapped_file: mapping failed");
+    data_ = static_cast<const char*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+#endif
+}
+
+inline void frozen_mapped_file::close() noexcept {
+    if (data_ == nullptr) {
+        return;
+    }
+#if defined(_WIN32)
+    ::UnmapViewOfFile(data_);
+#else
+    ::munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// frozen_unordered_map模板类，只读地查找由snapshot生成的镜像，镜像可以在文件映射或任意内存缓冲区中
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，
+// 第四、第五参数为键与值的序列化器，缺省时字符串按字符保存，其余类型按内存原样保存
+template<typename Key, typename T, typename Hash = mstl::hash<Key>,
+         typename KeySerializer = typename frozen_default_serializer<Key>::type,
+         typename ValueSerializer = typename frozen_default_serializer<T>::type>
+class frozen_unordered_map {
+public:
+    typedef Key             key_type;
+    typedef T               mapped_type;
+    typedef Hash            hasher;
+    typedef KeySerializer   key_serializer;
+    typedef ValueSerializer value_serializer;
+    typedef size_t          size_type;
+
+    static constexpr uint32_t version = 2;
+
+private:
+    const char*         image_;
+    const uint32_t*     buckets_;
+    const frozen_entry* entries_;
+    const char*         data_;
+    size_type           size_;
+    size_type           bucket_count_;
+    unsigned            shift_;
+    hasher              hash_;
+    key_serializer      ks_;
+    value_serializer    vs_;
+    // 由文件打开时持有映射
+    frozen_mapped_file  file_;
+
+public:
+    // 空表，查找总是失败
+    frozen_unordered_map() noexcept
+        : image_(nullptr), buckets_(nullptr), entries_(nullptr), data_(nullptr),
+          size_(0), bucket_count_(0), shift_(0) {}
+
+    // 在调用者持有的内存上查找，buffer需要在对象的生存期内保持有效，起始地址至少按8字节对齐
+    frozen_unordered_map(const void* buffer, size_type n, const Hash& hash = Hash()) : frozen_unordered_map() {
+        hash_ = hash;
+        attach(static_cast<const char*>(buffer), n);
+    }
+
+    // 映射文件并在映射上查找
+    explicit frozen_unordered_map(const char* path, const Hash& hash = Hash()) : frozen_unordered_map() {
+        hash_ = hash;
+        file_.open(path);
+        attach(file_.data(), file_.size());
+    }
+
+    frozen_unordered_map(const frozen_unordered_map&) = delete;
+    frozen_unordered_map& operator=(const frozen_unordered_map&) = delete;
+
+    // 映射的地址不随对象移动而改变，指针可以直接转移
+    frozen_unordered_map(frozen_unordered_map&& rhs) noexcept
+        : image_(rhs.image_), buckets_(rhs.buckets_), entries_(rhs.entries_), data_(rhs.data_),
+          size_(rhs.size_), bucket_count_(rhs.bucket_count_), shift_(rhs.shift_),
+          hash_(rhs.hash_), ks_(rhs.ks_), vs_(rhs.vs_), file_(mstl::move(rhs.file_)) {
+        rhs.reset();
+    }
+
+    frozen_unordered_map& operator=(frozen_unordered_map&& rhs) noexcept {
+        if (this != &rhs) {
+            image_ = rhs.image_;
+            buckets_ = rhs.buckets_;
+            entries_ = rhs.entries_;
+            data_ = rhs.data_;
+            size_ = rhs.size_;
+            bucket_count_ = rhs.bucket_count_;
+            shift_ = rhs.shift_;
+            hash_ = rhs.hash_;
+            ks_ = rhs.ks_;
+            vs_ = rhs.vs_;
+            file_ = mstl::move(rhs.file_);
+            rhs.reset();
+        }
+        return *this;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    size_type bucket_count() const noexcept {
+        return bucket_count_;
+    }
+
+    // 镜像的起始地址
+    const void* image() const noexcept {
+        return image_;
+    }
+
+    size_type count(const key_type& key) const {
+        return find_entry(key) != nullptr ? 1 : 0;
+    }
+
+    bool contains(const key_type& key) const {
+        return find_entry(key) != nullptr;
+    }
+
+    // 找到时把值读入value并返回true
+    bool find(const key_type& key, mapped_type& value) const {
+        const frozen_entry* e = find_entry(key);
+        if (e == nullptr) {
+            return false;
+        }
+        value = vs_.read(value_data(e), e->value_len);
+        return true;
+    }
+
+    mapped_type at(const key_type& key) const {
+        const frozen_entry* e = find_entry(key);
+        THROW_OUT_OF_RANGE_IF(e == nullptr, "frozen_unordered_map<Key, T> no such element exists");
+        return vs_.read(value_data(e), e->value_len);
+    }
+
+    // 值按内存原样保存时直接返回镜像中的对象，不存在时返回nullptr
+    const mapped_type* find_ptr(const key_type& key) const {
+        static_assert(std::is_same<value_serializer, frozen_pod_serializer<mapped_type>>::value,
+                      "find_ptr requires values stored by frozen_pod_serializer");
+        const frozen_entry* e = find_entry(key);
+        return e != nullptr ? reinterpret_cast<const mapped_type*>(value_data(e)) : nullptr;
+    }
+
+    // 反序列化全部元素插入map，用于需要修改时恢复出普通的表
+    template<typename Map>
+    void restore(Map& map) const;
+
+    // 把map保存为镜像，Map的元素需要有first与second成员，键值必须唯一
+    template<typename Map>
+    static void snapshot(const Map& map, mstl::vector<char>& image, const Hash& hash = Hash(),
+                         const KeySerializer& ks = KeySerializer(), const ValueSerializer& vs = ValueSerializer());
+
+    template<typename Map>
+    static void snapshot(const Map& map, const char* path, const Hash& hash = Hash(),
+                         const KeySerializer& ks = KeySerializer(), const ValueSerializer& vs = ValueSerializer());
+
+private:
+    void attach(const char* image, size_type n);
+
+    void reset() noexcept {
+        image_ = nullptr;
+        buckets_ = nullptr;
+        entries_ = nullptr;
+        data_ = nullptr;
+        size_ = 0;
+        bucket_count_ = 0;
+        shift_ = 0;
+    }
+
+    static constexpr size_t max_align() noexcept {
+        return KeySerializer::align > ValueSerializer::align ?
+               (KeySerializer::align > 8 ? KeySerializer::align : 8) :
+               (ValueSerializer::align > 8 ? ValueSerializer::align : 8);
+    }
+
+    static uint64_t align_up(uint64_t n, size_t align) noexcept {
+        return (n + align - 1) / align * align;
+    }
+
+    // 与ht_pow2_bucket_policy相同，乘法把哈希值的高位也混合进下标
+    static size_type bucket_index(uint64_t h, unsigned shift) noexcept {
+        return static_cast<size_type>((h * 0x9e3779b97f4a7c15ull) >> shift);
+    }
+
+    const char* value_data(const frozen_entry* e) const noexcept {
+        return data_ + align_up(e->offset + e->key_len, ValueSerializer::align);
+    }
+
+    const frozen_entry* find_entry(const key_type& key) const;
+};
+
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+constexpr uint32_t frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::version;
+
+// 只检查头部与各区域的范围，不遍历entry，打开的耗时与表的大小无关。
+// 头部来自文件，使用其中的值之前先检查：对齐是2的幂，shift与bucket_count一致，
+// 各区域按顺序排列、互不重叠且不超出镜像，比较时避免加法与乘法溢出
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+void frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::attach(const char* image, size_type n) {
+    THROW_RUNTIME_ERROR_IF(n < sizeof(frozen_image_header), "frozen_unordered_map: image too small");
+    frozen_image_header h;
+    std::memcpy(&h, image, sizeof(h));
+    THROW_RUNTIME_ERROR_IF(std::memcmp(h.magic, "MSTLFRZN", 8) != 0 || h.version != version,
+                           "frozen_unordered_map: not a frozen image");
+    THROW_RUNTIME_ERROR_IF(h.endian != 0x01020304u || h.word_size != sizeof(size_t),
+                           "frozen_unordered_map: image built on an incompatible machine");
+    THROW_RUNTIME_ERROR_IF(h.key_tag != KeySerializer::tag || h.value_tag != ValueSerializer::tag,
+                           "frozen_unordered_map: key or value type mismatch");
+    THROW_RUNTIME_ERROR_IF(h.max_align < max_align() || (h.max_align & (h.max_align - 1)) != 0,
+                           "frozen_unordered_map: corrupted image");
+    THROW_RUNTIME_ERROR_IF(h.bucket_count < 2 || (h.bucket_count & (h.bucket_count - 1)) != 0,
+                           "frozen_unordered_map: corrupted image");
+    uint64_t bits = 1;
+    while ((static_cast<uint64_t>(1) << bits) != h.bucket_count) {
+        ++bits;
+    }
+    THROW_RUNTIME_ERROR_IF(h.shift != 64 - bits, "frozen_unordered_map: corrupted image");
+    THROW_RUNTIME_ERROR_IF(h.image_size > n || h.buckets_offset < sizeof(frozen_image_header) ||
+                           h.buckets_offset > h.entries_offset || h.entries_offset > h.data_offset ||
+                           h.data_offset > h.image_size ||
+                           h.buckets_offset % alignof(uint32_t) != 0 ||
+                           h.entries_offset % alignof(frozen_entry) != 0 ||
+                           h.data_offset % h.max_align != 0 ||
+                           h.bucket_count >= (h.entries_offset - h.buckets_offset) / sizeof(uint32_t) ||
+                           h.size > (h.data_offset - h.entries_offset) / sizeof(frozen_entry),
+                           "frozen_unordered_map: corrupted image");
+    THROW_RUNTIME_ERROR_IF(reinterpret_cast<uintptr_t>(image) % h.max_align != 0,
+                           "frozen_unordered_map: image is not suitably aligned");
+    image_ = image;
+    buckets_ = reinterpret_cast<const uint32_t*>(image + h.buckets_offset);
+    entries_ = reinterpret_cast<const frozen_entry*>(image + h.entries_offset);
+    data_ = image + h.data_offset;
+    size_ = static_cast<size_type>(h.size);
+    bucket_count_ = static_cast<size_type>(h.bucket_count);
+    shift_ = static_cast<unsigned>(h.shift);
+    THROW_RUNTIME_ERROR_IF(buckets_[0] != 0 || buckets_[bucket_count_] != size_,
+                           "frozen_unordered_map: corrupted image");
+}
+
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+const frozen_entry*
+frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::find_entry(const key_type& key) const {
+    if (size_ == 0) {
+        return nullptr;
+    }
+    const uint64_t code = static_cast<uint64_t>(hash_(key));
+    const size_type n = bucket_index(code, shift_);
+    const frozen_entry* last = entries_ + buckets_[n + 1];
+    for (const frozen_entry* e = entries_ + buckets_[n]; e != last; ++e) {
+        if (e->hash == code && ks_.equal(data_ + e->offset, e->key_len, key)) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+template<typename Map>
+void frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::restore(Map& map) const {
+    map.reserve(map.size() + size_);
+    for (size_type i = 0; i < size_; ++i) {
+        const frozen_entry* e = entries_ + i;
+        map.emplace(ks_.read(data_ + e->offset, e->key_len), vs_.read(value_data(e), e->value_len));
+    }
+}
+
+// 先按bucket对元素做计数排序，再按排序后的顺序写出entry与数据，同一个bucket的数据在数据区中也相邻
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+template<typename Map>
+void frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::snapshot(
+    const Map& map, mstl::vector<char>& image, const Hash& hash,
+    const KeySerializer& ks, const ValueSerializer& vs) {
+    typedef typename Map::value_type elem_type;
+    const size_type n = map.size();
+    THROW_LENGTH_ERROR_IF(n >= static_cast<size_type>(UINT32_MAX), "frozen_unordered_map: too many elements");
+    // 负载在1到2之间，bucket数组占用的空间不超过entry数组的1/6
+    size_type bucket_count = 2;
+    unsigned shift = 63;
+    while (bucket_count * 2 < n) {
+        bucket_count *= 2;
+        --shift;
+    }
+
+    mstl::vector<uint64_t> codes(n);
+    mstl::vector<uint32_t> index(n);
+    mstl::vector<const elem_type*> elems(n);
+    mstl::vector<uint32_t> begin(bucket_count + 1, 0);
+    size_type i = 0;
+    for (auto it = map.begin(); it != map.end(); ++it, ++i) {
+        elems[i] = &*it;
+        codes[i] = static_cast<uint64_t>(hash(it->first));
+        ++begin[bucket_index(codes[i], shift) + 1];
+    }
+    for (size_type b = 0; b < bucket_count; ++b) {
+        begin[b + 1] += begin[b];
+    }
+    {
+        mstl::vector<uint32_t> cursor(begin.begin(), begin.end() - 1);
+        for (i = 0; i < n; ++i) {
+            index[cursor[bucket_index(codes[i], shift)]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // 计算数据区的大小与各个元素的偏移
+    mstl::vector<frozen_entry> entries(n);
+    uint64_t data_size = 0;
+    for (i = 0; i < n; ++i) {
+        const elem_type& el = *elems[index[i]];
+        frozen_entry& e = entries[i];
+        const size_t key_len = ks.size(el.first);
+        const size_t value_len = vs.size(el.second);
+        THROW_LENGTH_ERROR_IF(key_len > UINT32_MAX || value_len > UINT32_MAX,
+                              "frozen_unordered_map: element too large");
+        e.hash = codes[index[i]];
+        e.offset = align_up(data_size, KeySerializer::align);
+        e.key_len = static_cast<uint32_t>(key_len);
+        e.value_len = static_cast<uint32_t>(value_len);
+        data_size = align_up(e.offset + key_len, ValueSerializer::align) + value_len;
+    }
+
+    frozen_image_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "MSTLFRZN", 8);
+    h.version = version;
+    h.endian = 0x01020304u;
+    h.word_size = sizeof(size_t);
+    h.max_align = static_cast<uint32_t>(max_align());
+    h.key_tag = KeySerializer::tag;
+    h.value_tag = ValueSerializer::tag;
+    h.size = n;
+    h.bucket_count = bucket_count;
+    h.shift = shift;
+    h.buckets_offset = align_up(sizeof(h), 8);
+    h.entries_offset = align_up(h.buckets_offset + (bucket_count + 1) * sizeof(uint32_t), 8);
+    h.data_offset = align_up(h.entries_offset + n * sizeof(frozen_entry), max_align());
+    h.image_size = h.data_offset + data_size;
+
+    image.assign(static_cast<size_type>(h.image_size), 0);
+    char* out = image.data();
+    std::memcpy(out, &h, sizeof(h));
+    std::memcpy(out + h.buckets_offset, begin.data(), (bucket_count + 1) * sizeof(uint32_t));
+    if (n != 0) {
+        std::memcpy(out + h.entries_offset, entries.data(), n * sizeof(frozen_entry));
+    }
+    char* data = out + h.data_offset;
+    for (i = 0; i < n; ++i) {
+        const elem_type& el = *elems[index[i]];
+        const frozen_entry& e = entries[i];
+        ks.write(el.first, data + e.offset);
+        vs.write(el.second, data + align_up(e.offset + e.key_len, ValueSerializer::align));
+    }
+}
+
+template<typename Key, typename T, typename Hash, typename KeySerializer, typename ValueSerializer>
+template<typename Map>
+void frozen_unordered_map<Key, T, Hash, KeySerializer, ValueSerializer>::snapshot(
+    const Map& map, const char* path, const Hash& hash,
+    const KeySerializer& ks, const ValueSerializer& vs) {
+    mstl::vector<char> image;
+    snapshot(map, image, hash, ks, vs);
+    std::FILE* fp = std::fopen(path, "wb");
+    THROW_RUNTIME_ERROR_IF(fp == nullptr, "frozen_unordered_map: cannot open file for writing");
+    const size_t written = std::fwrite(image.data(), 1, image.size(), fp);
+    const bool ok = std::fclose(fp) == 0 && written == image.size();
+    THROW_RUNTIME_ERROR_IF(!ok, "frozen_unordered_map: write failed");
+}
+
+}//mstl
+
+#endif
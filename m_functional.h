@@ -4,6 +4,9 @@
 // 包含一些仿函数以及hash函数
 #include <functional>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
 
 namespace mstl{
 
@@ -75,13 +78,24 @@ T identity_element(multiplies<T>) {
     return T(1);
 }
 
-template<typename T>
+template<typename T = void>
 struct equal_to : public binary_function<T, T, bool> {
     bool operator()(const T& first, const T& last) const {
         return first == last;
     } 
 };
 
+// 透明版本，参数类型在调用时推导，不会为了比较构造临时对象
+template<>
+struct equal_to<void> {
+    typedef void is_transparent;
+
+    template<typename T, typename U>
+    bool operator()(const T& first, const U& last) const {
+        return first == last;
+    }
+};
+
 template<typename T>
 struct not_equal_to : public binary_function<T, T, bool> {
     bool operator()(const T& first, const T& last) const {
@@ -96,13 +110,23 @@ struct greater : public binary_function<T, T, bool> {
     } 
 };
 
-template<typename T>
+template<typename T = void>
 struct less : public binary_function<T, T, bool> {
     bool operator()(const T& first, const T& last) const {
         return first < last;
     } 
 };
 
+template<>
+struct less<void> {
+    typedef void is_transparent;
+
+    template<typename T, typename U>
+    bool operator()(const T& first, const U& last) const {
+        return first < last;
+    }
+};
+
 template<typename T>
 struct greater_equal : public binary_function<T, T, bool> {
     bool operator()(const T& first, const T& last) const {
@@ -175,15 +199,182 @@ struct projectsecond : public binary_function<Arg1, Arg2, Arg2> {
 };
 
 /********************************hash函数************************************/
+// 哈希函数族：整数与指针经过hash_mix充分混合，字节序列使用wyhash风格的hash_bytes，
+// 每一步读入64位，两者都以64位乘法得到的128位结果折叠为核心，32位平台同样输出64位再截断。
+// 混合函数都是constexpr，可以在编译期计算哈希值。
+// 输出已经充分混合的哈希仿函数声明is_avalanching，flat_hashtable等容器据此跳过自己的再混合
+
+// 64位乘法得到128位结果，a、b分别替换为结果的低64位与高64位，没有__int128时分成32位计算
+constexpr void hash_mul128(uint64_t& a, uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+#else
+    const uint64_t ha = a >> 32, la = a & 0xffffffffu;
+    const uint64_t hb = b >> 32, lb = b & 0xffffffffu;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    const uint64_t lo = t + (rm1 << 32);
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+#endif
+}
+
+// 128位乘积的高低两半异或
+constexpr uint64_t hash_mum(uint64_t a, uint64_t b) noexcept {
+    hash_mul128(a, b);
+    return a ^ b;
+}
+
+// 整数混合函数，输入的每一位都会影响输出的高位与低位，
+// 连续整数、只有高位不同的整数以及对齐的指针都不会聚集到相同的bucket
+constexpr size_t hash_mix(uint64_t x) noexcept {
+    return static_cast<size_t>(hash_mum(x ^ 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull));
+}
+
+inline uint64_t hash_read8(const unsigned char* p) noexcept {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t hash_read4(const unsigned char* p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 1到3个字节，首、中、尾三个字节拼接，长度不同的输入由最后一步混入的len区分
+inline uint64_t hash_read3(const unsigned char* p, size_t len) noexcept {
+    return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+}
+
+// 字节序列的哈希函数，算法与wyhash相同，16字节以内不需要循环，
+// 超过48字节时三路并行处理，每一轮读入48字节
+inline size_t hash_bytes(const void* key, size_t len, uint64_t seed = 0) noexcept {
+    const uint64_t s0 = 0x2d358dccaa6c78a5ull;
+    const uint64_t s1 = 0x8bb84b93962eacc9ull;
+    const uint64_t s2 = 0x4b33a62ed433d4a3ull;
+    const uint64_t s3 = 0x4d5a2da51de1aa47ull;
+    const unsigned char* p = static_cast<const unsigned char*>(key);
+    seed ^= hash_mum(seed ^ s0, s1);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (len <= 16) {
+        if (len >= 4) {
+            const size_t off = (len >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + off);
+            b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - off);
+        } else if (len > 0) {
+            a = hash_read3(p, len);
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = hash_mum(hash_read8(p) ^ s1, hash_read8(p + 8) ^ seed);
+                see1 = hash_mum(hash_read8(p + 16) ^ s2, hash_read8(p + 24) ^ see1);
+                see2 = hash_mum(hash_read8(p + 32) ^ s3, hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mum(hash_read8(p) ^ s1, hash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        // 最后16字节可能与前面已经处理过的部分重叠
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+    a ^= s1;
+    b ^= seed;
+    hash_mul128(a, b);
+    return static_cast<size_t>(hash_mum(a ^ s0 ^ len, b ^ s1));
+}
+
+// 与hash_bytes相同的算法，按小端序逐字节拼出每次读入的整数，可以在编译期求值，
+// 小端机器上结果与hash_bytes相同。固定宽度的逐字节拼接会被编译器合并为一次读取
+constexpr uint64_t hash_chars_byte(const char* p, size_t i) noexcept {
+    return static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+}
+
+constexpr uint64_t hash_chars_read4(const char* p) noexcept {
+    return hash_chars_byte(p, 0) | hash_chars_byte(p, 1) | hash_chars_byte(p, 2) | hash_chars_byte(p, 3);
+}
+
+constexpr uint64_t hash_chars_read8(const char* p) noexcept {
+    return hash_chars_byte(p, 0) | hash_chars_byte(p, 1) | hash_chars_byte(p, 2) | hash_chars_byte(p, 3) |
+           hash_chars_byte(p, 4) | hash_chars_byte(p, 5) | hash_chars_byte(p, 6) | hash_chars_byte(p, 7);
+}
+
+// 总是返回64位的结果，32位平台上也保留高32位，frozen_map等需要完整64位哈希值的地方使用
+constexpr uint64_t hash_chars64(const char* p, size_t len, uint64_t seed = 0) noexcept {
+    const uint64_t s0 = 0x2d358dccaa6c78a5ull;
+    const uint64_t s1 = 0x8bb84b93962eacc9ull;
+    const uint64_t s2 = 0x4b33a62ed433d4a3ull;
+    const uint64_t s3 = 0x4d5a2da51de1aa47ull;
+    seed ^= hash_mum(seed ^ s0, s1);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (len <= 16) {
+        if (len >= 4) {
+            const size_t off = (len >> 3) << 2;
+            a = (hash_chars_read4(p) << 32) | hash_chars_read4(p + off);
+            b = (hash_chars_read4(p + len - 4) << 32) | hash_chars_read4(p + len - 4 - off);
+        } else if (len > 0) {
+            a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+                (static_cast<uint64_t>(static_cast<unsigned char>(p[len >> 1])) << 8) |
+                static_cast<unsigned char>(p[len - 1]);
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = hash_mum(hash_chars_read8(p) ^ s1, hash_chars_read8(p + 8) ^ seed);
+                see1 = hash_mum(hash_chars_read8(p + 16) ^ s2, hash_chars_read8(p + 24) ^ see1);
+                see2 = hash_mum(hash_chars_read8(p + 32) ^ s3, hash_chars_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mum(hash_chars_read8(p) ^ s1, hash_chars_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hash_chars_read8(p + i - 16);
+        b = hash_chars_read8(p + i - 8);
+    }
+    a ^= s1;
+    b ^= seed;
+    hash_mul128(a, b);
+    return hash_mum(a ^ s0 ^ len, b ^ s1);
+}
+
+constexpr size_t hash_chars(const char* p, size_t len, uint64_t seed = 0) noexcept {
+    return static_cast<size_t>(hash_chars64(p, len, seed));
+}
+
 // 哈希函数的仿函数
 template<typename Key>
 struct hash {};
 
-// 对于指针的偏特化
+// 对于指针的偏特化，指针通常按8或16字节对齐，低位恒为0，同样需要混合
 template<typename Key>
 struct hash<Key*> : public unarg_function<Key*, size_t> {
+    typedef void is_avalanching;
+
     size_t operator()(Key* key) const noexcept {
-        return reinterpret_cast<size_t>(key);
+        return hash_mix(reinterpret_cast<uintptr_t>(key));
     }
 };
 
@@ -191,8 +382,10 @@ struct hash<Key*> : public unarg_function<Key*, size_t> {
 #define MSTL_TRIVIAL_HASH_FUNC(Type)                        \
 template<>                                                  \
 struct hash<Type> : public unarg_function<Type, size_t>  {  \
-    size_t operator()(Type val) const noexcept {            \
-        return static_cast<size_t>(val);                    \
+    typedef void is_avalanching;                            \
+                                                            \
+    constexpr size_t operator()(Type val) const noexcept {  \
+        return hash_mix(static_cast<uint64_t>(val));        \
     }                                                       \
 };
 
@@ -230,27 +423,65 @@ MSTL_TRIVIAL_HASH_FUNC(unsigned long long)
 
 /****************************************************************************/
 
+// 浮点数按位模式混合，+0.0与-0.0相等但位模式不同，因此0单独处理
 template<>
 struct hash<float> : public unarg_function<float, size_t> {
+    typedef void is_avalanching;
+
     size_t operator()(float val) const noexcept {
-        return val != 0.0f ? std::_Hash_impl::hash(val) : 0;
+        if (val == 0.0f) {
+            return 0;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        return hash_mix(bits);
     }
 };
 
 template<>
 struct hash<double> : public unarg_function<double, size_t> {
+    typedef void is_avalanching;
+
     size_t operator()(double val) const noexcept {
-        return val != 0.0 ? std::_Hash_impl::hash(val) : 0;
+        if (val == 0.0) {
+            return 0;
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        return hash_mix(bits);
     }
 };
 
+// long double的存储中可能含有未定义的填充字节，不能直接按位处理，
+// 拆成尾数与指数，尾数取最高的64位
 template<>
 struct hash<long double> : public unarg_function<long double, size_t> {
+    typedef void is_avalanching;
+
     size_t operator()(long double val) const noexcept {
-        return val != 0.0 ? std::_Hash_impl::hash(val) : 0;
+        if (val == 0.0L || val != val) {
+            return 0;
+        }
+        int exp = 0;
+        long double m = std::frexp(val, &exp);
+        const bool negative = m < 0;
+        if (negative) {
+            m = -m;
+        }
+        // m位于[0.5, 1)，乘以2^64后不会溢出
+        const uint64_t bits = static_cast<uint64_t>(m * 18446744073709551616.0L);
+        return static_cast<size_t>(hash_mum(bits ^ 0x2d358dccaa6c78a5ull,
+            (static_cast<uint64_t>(exp) << 1 | negative) ^ 0x8bb84b93962eacc9ull));
     }
 };
 
+// 把value的哈希值合并到seed中，用于组合多个成员的哈希值，结果与合并的顺序有关
+template<typename T>
+void hash_combine(size_t& seed, const T& value) {
+    seed = static_cast<size_t>(hash_mum(static_cast<uint64_t>(seed) ^ 0x4b33a62ed433d4a3ull,
+                                        static_cast<uint64_t>(mstl::hash<T>()(value)) ^ 0x4d5a2da51de1aa47ull));
+}
+
 }//mstl
 
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define M_HASHTABLE_H
 
 #include <initializer_list>
+#include <cstdint>
+#include <new>
 
 #include "m_vector.h"
 #include "m_util.h"
@@ -9,23 +11,122 @@
 #include "m_memory.h"
 #include "m_exceptdef.h"
 #include "m_algo.h"
+#include "m_bloom_filter.h"
+#include "m_node_handle.h"
+
+// 预取addr所在的缓存行，编译器不支持时为空操作
+#if defined(__GNUC__) || defined(__clang__)
+#define MSTL_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define MSTL_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#define MSTL_PREFETCH(addr) ((void)0)
+#endif
+
+// 批量查找时一组键值的个数，同时在途的预取数量不宜超过硬件的未命中处理能力
+#ifndef MSTL_HT_BATCH_SIZE
+#define MSTL_HT_BATCH_SIZE 16
+#endif
+
+// 定义MSTL_HT_STATS时hashtable额外记录查找的探测次数与rehash的次数和耗时，供stats()报告，
+// 未定义时这些计数不存在，查找与rehash的代码与原来完全相同。
+// 计数是以relaxed方式累加的原子变量，开启后多个线程同时对同一个表调用const查找仍然安全，
+// 并发时各项计数之间不保证相互一致
+#ifdef MSTL_HT_STATS
+#include <atomic>
+#include <chrono>
+#endif
+
+// stats()中链长直方图的格数，最后一格统计长度不小于它减一的所有bucket
+#ifndef MSTL_HT_STATS_HISTOGRAM
+#define MSTL_HT_STATS_HISTOGRAM 16
+#endif
+
+// 设置了rehash_pool的表元素个数不少于它时才并行地rehash，元素较少时调度的开销比重新链接本身还大
+#ifndef MSTL_HT_PARALLEL_MIN
+#define MSTL_HT_PARALLEL_MIN 65536
+#endif
+
+// 并行rehash与并行构建时每个线程分得的段数，段数越多负载越均衡，中间链表的个数为段数的平方
+#ifndef MSTL_HT_PARALLEL_PARTS
+#define MSTL_HT_PARALLEL_PARTS 4
+#endif
 
 namespace mstl {
 
-template<typename T>
-struct hashtable_node {
-    hashtable_node* next;
+// 节点中哈希值的存放方式，不缓存时为空基类，需要哈希值时重新计算，
+// 缓存时保存完整的哈希值，rehash时无需再调用哈希函数，查找时先比较哈希值再比较键值
+template<bool CacheHash>
+struct hashtable_node_hash {
+    void set_hash_code(size_t) noexcept {}
+
+    void copy_hash_code(const hashtable_node_hash&) noexcept {}
+
+    template<typename Hash, typename Key>
+    size_t hash_code(const Hash& hash, const Key& key) const {
+        return hash(key);
+    }
+
+    // 没有可比较的哈希值，交给键值比较
+    bool same_hash_code(size_t) const noexcept {
+        return true;
+    }
+};
+
+template<>
+struct hashtable_node_hash<true> {
+    size_t hash_code_;
+
+    void set_hash_code(size_t h) noexcept {
+        hash_code_ = h;
+    }
+
+    void copy_hash_code(const hashtable_node_hash& rhs) noexcept {
+        hash_code_ = rhs.hash_code_;
+    }
+
+    template<typename Hash, typename Key>
+    size_t hash_code(const Hash&, const Key&) const noexcept {
+        return hash_code_;
+    }
+
+    bool same_hash_code(size_t h) const noexcept {
+        return hash_code_ == h;
+    }
+};
+
+// 是否在节点中缓存哈希值，整数、指针等标量键的哈希与比较都很廉价，缓存反而增大节点，
+// 其余键 (如字符串) 默认缓存，可以针对具体的Key和Hash特化此模板
+template<typename Key, typename Hash>
+struct ht_cache_hash_code : public m_bool_constant<!std::is_scalar<Key>::value> {};
+
+// 节点的链接部分，hashtable的所有节点串成一条单链表，同一个bucket中的节点在链表中相邻，
+// 哨兵节点before_begin_只有这一部分
+struct hashtable_node_base {
+    hashtable_node_base* next;
+
+    hashtable_node_base() : next(nullptr) {}
+};
+
+template<typename T, bool CacheHash = false>
+struct hashtable_node : public hashtable_node_base, public hashtable_node_hash<CacheHash> {
     T value;
 
     hashtable_node() = default;
 
-    hashtable_node(const T& v) : next(nullptr), value(v) {}
+    hashtable_node(const T& v) : hashtable_node_base(), value(v) {}
 
-    hashtable_node(const hashtable_node& rhs) : next(rhs.next), value(rhs.value) {}
+    hashtable_node(const hashtable_node& rhs) : hashtable_node_base(rhs), value(rhs.value) {}
 
-    hashtable_node(hashtable_node&& rhs) : next(rhs.next), value(mstl::move(rhs.value)) {
+    hashtable_node(hashtable_node&& rhs) : hashtable_node_base(rhs), value(mstl::move(rhs.value)) {
         rhs.next = nullptr;
     }
+
+    // 链表中的下一个节点，哨兵节点不会出现在任何节点的next中，转换总是安全的
+    hashtable_node* next_node() const noexcept {
+        return static_cast<hashtable_node*>(next);
+    }
 };
 
 template<typename T, bool>
@@ -85,34 +186,51 @@ struct ht_value_traits {
     }
 };
 
-template<typename T, typename HashFun, typename KeyEqual>
-struct hashtable;
+struct ht_prime_bucket_policy;
+struct ht_heap_node_policy;
+// 并行rehash与并行构建使用m_thread_pool.h中的线程池，只有用到这些接口时才需要包含它
+class thread_pool;
+
+// hashtable内部通过它使用线程池，类型依赖于模板参数，对线程池成员的使用推迟到实例化时才检查，
+// 没有包含m_thread_pool.h的代码不会因为thread_pool不完整而出错
+template<typename Pool, typename T>
+struct ht_dependent_pool {
+    typedef Pool type;
+};
+
+// 第四个模板参数为bucket下标策略，决定bucket的个数以及哈希值到bucket下标的映射，缺省使用素数大小
+// 第五个模板参数为节点内存策略，决定节点从哪里申请，缺省每个节点单独从堆上申请
+template<typename T, typename HashFun, typename KeyEqual, typename BucketPolicy = ht_prime_bucket_policy,
+         typename NodePolicy = ht_heap_node_policy>
+class hashtable;
 
-template<typename T, typename HashFun, typename KeyEqual>
+template<typename T, typename HashFun, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_iterator;
 
-template<typename T, typename HashFun, typename KeyEqual>
+template<typename T, typename HashFun, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_const_iterator;
 
-template<typename T>
+template<typename T, typename HashFun, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_local_iterator;
 
-template<typename T>
+template<typename T, typename HashFun, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_const_local_iterator;
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_iterator_base : public mstl::iterator<mstl::forward_iterator_tag, T>{
-    typedef mstl::hashtable<T, Hash, KeyEqual>         hashtable;
-    typedef ht_iterator_base<T, Hash, KeyEqual>        base;
-    typedef mstl::ht_iterator<T, Hash, KeyEqual>       iterator;
-    typedef mstl::ht_const_iterator<T, Hash, KeyEqual> const_iterator;
-    typedef hashtable_node<T>*                         node_ptr;
-    typedef hashtable*                                 contain_ptr;
-    typedef const node_ptr                             const_node_ptr;
-    typedef const contain_ptr                          const_contain_ptr;
-
-    typedef size_t                                     size_type;
-    typedef ptrdiff_t                                  difference_type;
+    typedef mstl::hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>         hashtable;
+    typedef ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy>        base;
+    typedef mstl::ht_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>       iterator;
+    typedef mstl::ht_const_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy> const_iterator;
+    typedef hashtable_node<T, ht_cache_hash_code<
+        typename ht_value_traits<T>::key_type, Hash>::value>                     node_type;
+    typedef node_type*                                                           node_ptr;
+    typedef hashtable*                                                           contain_ptr;
+    typedef const node_ptr                                                       const_node_ptr;
+    typedef const contain_ptr                                                    const_contain_ptr;
+
+    typedef size_t                                                               size_type;
+    typedef ptrdiff_t                                                            difference_type;
 
     node_ptr    node;
     contain_ptr ht;
@@ -128,19 +246,19 @@ struct ht_iterator_base : public mstl::iterator<mstl::forward_iterator_tag, T>{
     }
 };
 
-template<typename T, typename Hash, typename KeyEqual>
-struct ht_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
-    typedef ht_iterator_base<T, Hash, KeyEqual> base;
-    typedef typename base::hashtable            hashtable;
-    typedef typename base::iterator             iterator;
-    typedef typename base::const_iterator       const_iterator;
-    typedef typename base::node_ptr             node_ptr;
-    typedef typename base::contain_ptr          contain_ptr;
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+struct ht_iterator : public ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy> {
+    typedef ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy> base;
+    typedef typename base::hashtable                                      hashtable;
+    typedef typename base::iterator                                       iterator;
+    typedef typename base::const_iterator                                 const_iterator;
+    typedef typename base::node_ptr                                       node_ptr;
+    typedef typename base::contain_ptr                                    contain_ptr;
 
-    typedef ht_value_traits<T>                  value_traits;
-    typedef T                                   value_type;
-    typedef value_type*                         pointer;
-    typedef value_type&                         reference;
+    typedef ht_value_traits<T>                                            value_traits;
+    typedef T                                                             value_type;
+    typedef value_type*                                                   pointer;
+    typedef value_type&                                                   reference;
 
 
 
@@ -187,10 +305,8 @@ struct ht_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
     }
 
     iterator& operator=(const const_iterator& rhs) {
-        if (this != &rhs) {
-            node = rhs.node;
-            ht = rhs.ht;
-        }
+        node = rhs.node;
+        ht = rhs.ht;
         return *this;
     }
 
@@ -204,16 +320,8 @@ struct ht_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
 
     iterator& operator++() {
         MSTL_DEBUG(node != nullptr);
-        node_ptr old = node;
-        // 指向下一个节点
-        node = node->next;
-        // 下一个节点不存在，则跳转到下一个篮子bucket中
-        if (node == nullptr) {
-            size_t index = ht->hash(value_traits::get_key(old->value));
-            while (!node && ++index < ht->bucket_size_) {
-                node = ht->buckets_[index];
-            }
-        }
+        // 所有节点在同一条链表上，直接指向下一个节点
+        node = node->next_node();
         return *this;
     }
 
@@ -224,19 +332,19 @@ struct ht_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
     }
 };
 
-template<typename T, typename Hash, typename KeyEqual>
-struct ht_const_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
-    typedef ht_iterator_base<T, Hash, KeyEqual> base;
-    typedef typename base::hashtable            hashtable;
-    typedef typename base::iterator             iterator;
-    typedef typename base::const_iterator       const_iterator;
-    typedef typename base::const_node_ptr       node_ptr;
-    typedef typename base::const_contain_ptr    contain_ptr;
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+struct ht_const_iterator : public ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy> {
+    typedef ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy> base;
+    typedef typename base::hashtable                                      hashtable;
+    typedef typename base::iterator                                       iterator;
+    typedef typename base::const_iterator                                 const_iterator;
+    typedef typename base::const_node_ptr                                 node_ptr;
+    typedef typename base::const_contain_ptr                              contain_ptr;
 
-    typedef ht_value_traits<T>                  value_traits;
-    typedef T                                   value_type;
-    typedef value_type*                         pointer;
-    typedef value_type&                         reference;
+    typedef ht_value_traits<T>                                            value_traits;
+    typedef T                                                             value_type;
+    typedef value_type*                                                   pointer;
+    typedef value_type&                                                   reference;
 
     using base::node;
     using base::ht;
@@ -258,15 +366,13 @@ struct ht_const_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
         ht = rhs.ht;
     }
 
-    iterator& operator=(const iterator& rhs) {
-        if (this != &rhs) {
-            node = rhs.node;
-            ht = rhs.ht;
-        }
+    const_iterator& operator=(const iterator& rhs) {
+        node = rhs.node;
+        ht = rhs.ht;
         return *this;
     }
 
-    iterator& operator=(const const_iterator& rhs) {
+    const_iterator& operator=(const const_iterator& rhs) {
         if (this != &rhs) {
             node = rhs.node;
             ht = rhs.ht;
@@ -282,46 +388,43 @@ struct ht_const_iterator : public ht_iterator_base<T, Hash, KeyEqual> {
         return &(operator*());
     }
 
-    iterator& operator++() {
+    const_iterator& operator++() {
         MSTL_DEBUG(node != nullptr);
-        const node_ptr old = node;
-        node = node->next;
-        if (node == nullptr) {
-            size_t index = ht->hash(value_traits::get_key(old->value));
-            while (!node && ++index < ht->bucket_size_) {
-                node = ht->buckets_[index];
-            }
-        }
+        node = node->next_node();
         return *this;
     }
 
-    iterator operator++(int) {
-        iterator temp = *this;
+    const_iterator operator++(int) {
+        const_iterator temp = *this;
         ++*this;
         return temp;
     }
 };
 
-template<typename T>
+// bucket内的迭代器，同一个bucket的节点在链表中相邻，走出这一段时变为end
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_local_iterator : public mstl::iterator<mstl::forward_iterator_tag, T> {
-    typedef T                          value_type;
-    typedef value_type*                pointer;
-    typedef value_type&                reference;
-    typedef size_t                     size_type;
-    typedef ptrdiff_t                  difference_type;
-    typedef hashtable_node<T>*         node_ptr;
+    typedef T                                                                                value_type;
+    typedef value_type*                                                                      pointer;
+    typedef value_type&                                                                      reference;
+    typedef size_t                                                                           size_type;
+    typedef ptrdiff_t                                                                        difference_type;
+    typedef const mstl::hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>*              contain_ptr;
+    typedef typename ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr node_ptr;
+
+    typedef ht_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>                   self;
+    typedef ht_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>                   local_iterator;
+    typedef ht_const_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>             const_local_iterator;
 
-    typedef ht_local_iterator<T>       self;
-    typedef ht_local_iterator<T>       local_iterator;
-    typedef ht_const_local_iterator<T> const_local_iterator;
-
-    node_ptr node; 
+    node_ptr    node;
+    size_type   bucket;
+    contain_ptr ht;
 
-    ht_local_iterator(node_ptr n) : node(n) {}
+    ht_local_iterator(node_ptr n, size_type b, contain_ptr c) : node(n), bucket(b), ht(c) {}
 
-    ht_local_iterator(const local_iterator& rhs) : node(rhs.node) {}
+    ht_local_iterator(const local_iterator& rhs) : node(rhs.node), bucket(rhs.bucket), ht(rhs.ht) {}
 
-    ht_local_iterator(const const_local_iterator& rhs) : node(rhs.node) {}
+    ht_local_iterator(const const_local_iterator& rhs) : node(rhs.node), bucket(rhs.bucket), ht(rhs.ht) {}
 
     reference operator*() const {
         return node->value;
@@ -333,7 +436,10 @@ struct ht_local_iterator : public mstl::iterator<mstl::forward_iterator_tag, T>
 
     self& operator++() {
         MSTL_DEBUG(node != nullptr);
-        node = node->next;
+        node = node->next_node();
+        if (node != nullptr && !ht->in_bucket(node, ht->buckets_[bucket])) {
+            node = nullptr;
+        }
         return *this;
     }
 
@@ -352,26 +458,29 @@ struct ht_local_iterator : public mstl::iterator<mstl::forward_iterator_tag, T>
     }
 };
 
-template<typename T>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 struct ht_const_local_iterator : public mstl::iterator<mstl::forward_iterator_tag, T> {
-    typedef T                          value_type;
-    typedef const value_type*          pointer;
-    typedef const value_type&          reference;
-    typedef size_t                     size_type;
-    typedef ptrdiff_t                  difference_type;
-    typedef const hashtable_node<T>*   node_ptr;
-
-    typedef ht_const_local_iterator<T> self;
-    typedef ht_local_iterator<T>       local_iterator;
-    typedef ht_const_local_iterator<T> const_local_iterator;
+    typedef T                                                                                value_type;
+    typedef const value_type*                                                                pointer;
+    typedef const value_type&                                                                reference;
+    typedef size_t                                                                           size_type;
+    typedef ptrdiff_t                                                                        difference_type;
+    typedef const mstl::hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>*              contain_ptr;
+    typedef typename ht_iterator_base<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr node_ptr;
+
+    typedef ht_const_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>             self;
+    typedef ht_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>                   local_iterator;
+    typedef ht_const_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>             const_local_iterator;
 
-    node_ptr node; 
+    node_ptr    node;
+    size_type   bucket;
+    contain_ptr ht;
 
-    ht_const_local_iterator(node_ptr n) : node(n) {}
+    ht_const_local_iterator(node_ptr n, size_type b, contain_ptr c) : node(n), bucket(b), ht(c) {}
 
-    ht_const_local_iterator(const local_iterator& rhs) : node(rhs.node) {}
+    ht_const_local_iterator(const local_iterator& rhs) : node(rhs.node), bucket(rhs.bucket), ht(rhs.ht) {}
 
-    ht_const_local_iterator(const const_local_iterator& rhs) : node(rhs.node) {}
+    ht_const_local_iterator(const const_local_iterator& rhs) : node(rhs.node), bucket(rhs.bucket), ht(rhs.ht) {}
 
     reference operator*() const {
         return node->value;
@@ -383,7 +492,10 @@ struct ht_const_local_iterator : public mstl::iterator<mstl::forward_iterator_ta
 
     self& operator++() {
         MSTL_DEBUG(node != nullptr);
-        node = node->next;
+        node = node->next_node();
+        if (node != nullptr && !ht->in_bucket(node, ht->buckets_[bucket])) {
+            node = nullptr;
+        }
         return *this;
     }
 
@@ -467,39 +579,429 @@ inline size_t ht_next_prime(size_t n) {
     return pos == last ? *(last - 1) : *pos;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+// bucket下标策略，hashtable通过它把哈希值映射为bucket下标，需要提供以下接口：
+//   static size_t next_size(size_t n)  不小于n的合法bucket个数
+//   static size_t max_size()           最大的bucket个数
+//   void reset(size_t n)               bucket个数变为n时重新计算内部常量
+//   size_t index(size_t h) const       把哈希值h映射到[0, n)
+
+// 乘法常数需要两倍于size_t的位数，64位平台上缺少128位整数时退回到除法
+#ifdef SYSTEM_64
+#if defined(__SIZEOF_INT128__)
+#define MSTL_HT_FASTMOD 1
+typedef unsigned __int128  ht_magic_type;
+#endif
+#else
+#define MSTL_HT_FASTMOD 1
+typedef unsigned long long ht_magic_type;
+#endif
+
+// 素数大小的bucket，保持原有的 h % n 语义，但不使用除法指令：
+// bucket个数改变时预先计算 M = ceil(2^(2w) / n)，之后 h % n = ((M * h mod 2^(2w)) * n) >> 2w，
+// 其中w为size_t的位数，这样每次取模只需要几次乘法 (Lemire fastmod)
+struct ht_prime_bucket_policy {
+    size_t        n_;
+#ifdef MSTL_HT_FASTMOD
+    ht_magic_type magic_;
+#endif
+
+    explicit ht_prime_bucket_policy(size_t n = 0) {
+        reset(n);
+    }
+
+    static size_t next_size(size_t n) {
+        return ht_next_prime(n);
+    }
+
+    static size_t max_size() {
+        return ht_prime_list[PRIME_NUM - 1];
+    }
+
+    void reset(size_t n) {
+        n_ = n;
+#ifdef MSTL_HT_FASTMOD
+        magic_ = n == 0 ? 0 : static_cast<ht_magic_type>(-1) / n + 1;
+#endif
+    }
+
+    size_t index(size_t h) const {
+        MSTL_DEBUG(n_ != 0);
+#ifdef MSTL_HT_FASTMOD
+        // low * n 的结果有3w位，分成高低两半相乘，只保留最高的w位
+        const size_t        bits = sizeof(size_t) * 8;
+        const ht_magic_type low = magic_ * h;
+        const ht_magic_type bottom = (static_cast<ht_magic_type>(static_cast<size_t>(low)) * n_) >> bits;
+        const ht_magic_type top = (low >> bits) * n_;
+        return static_cast<size_t>((bottom + top) >> bits);
+#else
+        return h % n_;
+#endif
+    }
+};
+
+// 2的幂大小的bucket，下标取乘以黄金分割常数后的高位 (Fibonacci hashing)，
+// 乘法会把哈希值低位的差异扩散到高位，因此恒等映射的整数哈希也能均匀分布，
+// 代价是bucket个数只能成倍增长，且bucket(key)不再等于 hash(key) % n
+struct ht_pow2_bucket_policy {
+    size_t shift_;
+
+    explicit ht_pow2_bucket_policy(size_t n = 0) {
+        reset(n);
+    }
+
+    static size_t next_size(size_t n) {
+        size_t size = 16;
+        while (size < n && size < max_size()) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static size_t max_size() {
+        return static_cast<size_t>(1) << (sizeof(size_t) * 8 - 1);
+    }
+
+    void reset(size_t n) {
+        MSTL_DEBUG((n & (n - 1)) == 0);
+        size_t log2 = 0;
+        while ((static_cast<size_t>(1) << log2) < n) {
+            ++log2;
+        }
+        // n由next_size给出，至少为16；n == 0 时不会调用index，只需保证移位合法
+        shift_ = sizeof(size_t) * 8 - (log2 == 0 ? 1 : log2);
+    }
+
+    size_t index(size_t h) const {
+#ifdef SYSTEM_64
+        return static_cast<size_t>(h * 0x9e3779b97f4a7c15ull) >> shift_;
+#else
+        return static_cast<size_t>(h * 0x9e3779b9u) >> shift_;
+#endif
+    }
+};
+
+// 节点内存策略，hashtable通过它申请与释放节点的内存，策略对象是hashtable的成员，需要提供以下接口：
+//   static constexpr bool bulk_release  为true时clear与析构不再逐个释放节点的内存，而是调用release整体回收，
+//                                       值类型可以平凡析构时连遍历链表也省去
+//   static constexpr bool concurrent_allocate  allocate能否被多个线程同时调用，并行构建时据此决定能否并行地创建节点
+//   static constexpr bool transferable  节点能否离开所在的表 (extract/insert节点句柄与merge)，
+//                                       为true时节点必须单独来自mstl::allocator<Node>
+//   template<typename Node> Node* allocate()           申请一个节点的内存
+//   template<typename Node> void deallocate(Node* p)   释放单个节点的内存，erase时调用
+//   void release()                                     回收全部节点的内存
+//   void swap(policy& rhs)                             交换两个策略对象，移动构造时由缺省构造的对象交换得到
+
+// 每个节点单独从堆上申请，与节点的生存期一致
+struct ht_heap_node_policy {
+    static constexpr bool bulk_release = false;
+    static constexpr bool concurrent_allocate = true;
+    static constexpr bool transferable = true;
+
+    template<typename Node>
+    Node* allocate() {
+        return mstl::allocator<Node>::allocate(1);
+    }
+
+    template<typename Node>
+    void deallocate(Node* p) noexcept {
+        mstl::allocator<Node>::deallocate(p);
+    }
+
+    void release() noexcept {}
+
+    void swap(ht_heap_node_policy&) noexcept {}
+};
+
+// 节点来自表自己持有的分块内存 (arena)，块内从前向后顺序切分，块的大小成倍增长直到上限。
+// 同一个表的节点大小相同，erase释放的节点放入空闲链表供之后的插入复用；
+// clear时整体回收，只保留最近申请的 (也是最大的) 一块供之后继续使用，析构时释放全部块。
+// 适合构建后只读取一次就整体丢弃的表，节点在内存中也更紧凑
+class ht_arena_node_policy {
+public:
+    static constexpr bool bulk_release = true;
+    static constexpr bool concurrent_allocate = false;
+    static constexpr bool transferable = false;
+
+private:
+    // 每个块的头部，块之间串成单链表，最近申请的块在最前面
+    struct block_header {
+        block_header* next;
+        size_t        size;
+    };
+
+    // 空闲节点复用节点自身的内存保存链接
+    struct free_node {
+        free_node* next;
+    };
+
+    static constexpr size_t min_block_size = 4096;
+    static constexpr size_t max_block_size = 1 << 20;
+
+    block_header* blocks_;
+    char*         cur_;
+    char*         end_;
+    free_node*    free_;
+    // 下一次申请的块大小
+    size_t        next_size_;
+
+public:
+    ht_arena_node_policy() noexcept
+        : blocks_(nullptr), cur_(nullptr), end_(nullptr), free_(nullptr), next_size_(min_block_size) {}
+
+    ht_arena_node_policy(const ht_arena_node_policy&) = delete;
+    ht_arena_node_policy& operator=(const ht_arena_node_policy&) = delete;
+
+    ht_arena_node_policy(ht_arena_node_policy&& rhs) noexcept : ht_arena_node_policy() {
+        swap(rhs);
+    }
+
+    ht_arena_node_policy& operator=(ht_arena_node_policy&& rhs) noexcept {
+        if (this != &rhs) {
+            ht_arena_node_policy temp(mstl::move(rhs));
+            swap(temp);
+        }
+        return *this;
+    }
+
+    ~ht_arena_node_policy() {
+        free_blocks(blocks_);
+    }
+
+    template<typename Node>
+    Node* allocate() {
+        static_assert(sizeof(Node) >= sizeof(free_node), "node is too small to be linked into the free list");
+        if (free_ != nullptr) {
+            free_node* p = free_;
+            free_ = p->next;
+            return reinterpret_cast<Node*>(p);
+        }
+        return static_cast<Node*>(bump(sizeof(Node), alignof(Node)));
+    }
+
+    template<typename Node>
+    void deallocate(Node* p) noexcept {
+        free_node* f = reinterpret_cast<free_node*>(p);
+        f->next = free_;
+        free_ = f;
+    }
+
+    // 回收全部节点，保留最近申请的块
+    void release() noexcept {
+        free_ = nullptr;
+        if (blocks_ != nullptr) {
+            free_blocks(blocks_->next);
+            blocks_->next = nullptr;
+            cur_ = reinterpret_cast<char*>(blocks_ + 1);
+            end_ = reinterpret_cast<char*>(blocks_) + blocks_->size;
+        }
+    }
+
+    void swap(ht_arena_node_policy& rhs) noexcept {
+        mstl::swap(blocks_, rhs.blocks_);
+        mstl::swap(cur_, rhs.cur_);
+        mstl::swap(end_, rhs.end_);
+        mstl::swap(free_, rhs.free_);
+        mstl::swap(next_size_, rhs.next_size_);
+    }
+
+private:
+    static char* align_up(char* p, size_t align) noexcept {
+        const uintptr_t n = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char*>((n + align - 1) & ~static_cast<uintptr_t>(align - 1));
+    }
+
+    void* bump(size_t size, size_t align) {
+        char* p = cur_ != nullptr ? align_up(cur_, align) : nullptr;
+        if (p == nullptr || size > static_cast<size_t>(end_ - p)) {
+            add_block(size + align);
+            p = align_up(cur_, align);
+        }
+        cur_ = p + size;
+        return p;
+    }
+
+    // 申请一个至少能容纳need字节的新块
+    void add_block(size_t need) {
+        size_t n = next_size_;
+        while (n < need + sizeof(block_header)) {
+            n <<= 1;
+        }
+        block_header* b = static_cast<block_header*>(::operator new(n));
+        b->next = blocks_;
+        b->size = n;
+        blocks_ = b;
+        cur_ = reinterpret_cast<char*>(b + 1);
+        end_ = reinterpret_cast<char*>(b) + n;
+        if (next_size_ < max_block_size) {
+            next_size_ <<= 1;
+        }
+    }
+
+    static void free_blocks(block_header* b) noexcept {
+        while (b != nullptr) {
+            block_header* next = b->next;
+            ::operator delete(b);
+            b = next;
+        }
+    }
+};
+
+// 哈希函数与键值比较函数都是透明的才能进行异构查找，K只用于让条件依赖于成员函数的模板参数
+template<typename Hash, typename KeyEqual, typename K>
+struct ht_is_transparent : public m_bool_constant<mstl::is_transparent<Hash>::value &&
+                                                  mstl::is_transparent<KeyEqual>::value> {};
+
+// hashtable::stats()的结果。bucket相关的部分每次调用时遍历整个表得到，总是可用；
+// 探测与rehash的计数只在定义了MSTL_HT_STATS时记录，否则为0。
+// 查找包括find、count等接口以及unique插入前的查重，一次查找的探测次数是经过的节点个数，
+// 缓存哈希值时哈希值不同、不需要比较键值的节点也计入
+struct ht_stats {
+    size_t size;
+    size_t bucket_count;
+    size_t empty_buckets;
+    size_t max_chain;
+    // chain_histogram[i]为长度为i的bucket个数，最后一格包含所有更长的bucket
+    mstl::vector<size_t> chain_histogram;
+    // 最长的几个bucket，pair为 (bucket下标, 长度)，按长度从大到小排列
+    mstl::vector<mstl::pair<size_t, size_t>> hot_buckets;
+
+    size_t hits;
+    size_t misses;
+    size_t hit_probes;
+    size_t miss_probes;
+    size_t max_hit_probes;
+    size_t max_miss_probes;
+    // replace_bucket与开始渐进式迁移的次数，以及重新链接节点花费的时间
+    size_t rehash_count;
+    uint64_t rehash_ns;
+
+    double empty_ratio() const noexcept {
+        return bucket_count == 0 ? 0.0 : (double)empty_buckets / (double)bucket_count;
+    }
+
+    double avg_hit_probes() const noexcept {
+        return hits == 0 ? 0.0 : (double)hit_probes / (double)hits;
+    }
+
+    double avg_miss_probes() const noexcept {
+        return misses == 0 ? 0.0 : (double)miss_probes / (double)misses;
+    }
+};
+
+#ifdef MSTL_HT_STATS
+// 运行期计数，含义与ht_stats中的同名成员相同
+// 共享读锁下的const查找也会更新计数，所以全部使用原子变量
+struct ht_stats_counters {
+    std::atomic<size_t>   hits;
+    std::atomic<size_t>   misses;
+    std::atomic<size_t>   hit_probes;
+    std::atomic<size_t>   miss_probes;
+    std::atomic<size_t>   max_hit_probes;
+    std::atomic<size_t>   max_miss_probes;
+    std::atomic<size_t>   rehash_count;
+    std::atomic<uint64_t> rehash_ns;
+
+    ht_stats_counters() noexcept { reset(); }
+
+    void reset() noexcept {
+        hits.store(0, std::memory_order_relaxed);
+        misses.store(0, std::memory_order_relaxed);
+        hit_probes.store(0, std::memory_order_relaxed);
+        miss_probes.store(0, std::memory_order_relaxed);
+        max_hit_probes.store(0, std::memory_order_relaxed);
+        max_miss_probes.store(0, std::memory_order_relaxed);
+        rehash_count.store(0, std::memory_order_relaxed);
+        rehash_ns.store(0, std::memory_order_relaxed);
+    }
+
+    void record_find(bool hit, size_t probes) noexcept {
+        if (hit) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            hit_probes.fetch_add(probes, std::memory_order_relaxed);
+            update_max(max_hit_probes, probes);
+        } else {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            miss_probes.fetch_add(probes, std::memory_order_relaxed);
+            update_max(max_miss_probes, probes);
+        }
+    }
+
+    void record_rehash() noexcept {
+        rehash_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    // 先读后比较，探测次数不超过已有最大值时不写共享变量
+    static void update_max(std::atomic<size_t>& m, size_t v) noexcept {
+        size_t cur = m.load(std::memory_order_relaxed);
+        while (v > cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+// 在作用域内计时，离开时把耗时累加到counters上
+class ht_rehash_timer {
+public:
+    explicit ht_rehash_timer(ht_stats_counters& c) noexcept
+        : counters_(c), start_(std::chrono::steady_clock::now()) {}
+
+    ~ht_rehash_timer() {
+        counters_.rehash_ns.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count()), std::memory_order_relaxed);
+    }
+
+private:
+    ht_stats_counters&                    counters_;
+    std::chrono::steady_clock::time_point start_;
+};
+#endif
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 class hashtable {
-    // 允许两个iterator类访问自身的私有成员
-    friend struct mstl::ht_iterator<T, Hash, KeyEqual>;
-    friend struct mstl::ht_const_iterator<T, Hash, KeyEqual>;
+    // 允许迭代器类访问自身的私有成员
+    friend struct mstl::ht_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>;
+    friend struct mstl::ht_const_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>;
+    friend struct mstl::ht_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>;
+    friend struct mstl::ht_const_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>;
 
 public:
-    typedef ht_value_traits<T>                               value_traits;
-    typedef typename value_traits::key_type                  key_type;
-    typedef typename value_traits::mapped_type               mapped_type;
-    typedef typename value_traits::value_type                value_type;
-    typedef Hash                                             hasher;
-    typedef KeyEqual                                         key_equal;
-
-    typedef hashtable_node<T>                                node_type;
-    typedef node_type*                                       node_ptr;
-    typedef mstl::vector<node_ptr>                           bucket_type;
-
-    typedef mstl::allocator<T>                               allocator_type;
-    typedef mstl::allocator<T>                               data_allocator;
-    typedef mstl::allocator<node_type>                       node_allocator;
-
-    typedef typename allocator_type::pointer                 pointer;
-    typedef typename allocator_type::const_pointer           const_pointer;
-    typedef typename allocator_type::reference               reference;
-    typedef typename allocator_type::const_reference         const_reference;
-    typedef typename allocator_type::size_type               size_type;
-    typedef typename allocator_type::difference_type         difference_type;
-
-    typedef mstl::ht_iterator<T, Hash, KeyEqual>             iterator;
-    typedef mstl::ht_const_iterator<T, Hash, KeyEqual>       const_iterator;
-    typedef mstl::ht_local_iterator<T>                       local_iterator;
-    typedef mstl::ht_const_local_iterator<T>                 const_local_iterator;
+    typedef ht_value_traits<T>                                                         value_traits;
+    typedef typename value_traits::key_type                                            key_type;
+    typedef typename value_traits::mapped_type                                         mapped_type;
+    typedef typename value_traits::value_type                                          value_type;
+    typedef Hash                                                                       hasher;
+    typedef KeyEqual                                                                   key_equal;
+    typedef BucketPolicy                                                               bucket_policy;
+    typedef NodePolicy                                                                 node_policy;
+
+    // 是否在节点中缓存哈希值
+    static constexpr bool cache_hash_code = ht_cache_hash_code<key_type, Hash>::value;
+
+    typedef hashtable_node<T, cache_hash_code>                                         node_type;
+    typedef node_type*                                                                 node_ptr;
+    typedef hashtable_node_base                                                        node_base;
+    typedef node_base*                                                                 base_ptr;
+    // bucket中保存的是该bucket第一个节点在全局链表中的前驱，空bucket为nullptr
+    typedef mstl::vector<base_ptr>                                                     bucket_type;
+
+    typedef mstl::allocator<T>                                                         allocator_type;
+    typedef mstl::allocator<T>                                                         data_allocator;
+
+    typedef typename allocator_type::pointer                                           pointer;
+    typedef typename allocator_type::const_pointer                                     const_pointer;
+    typedef typename allocator_type::reference                                         reference;
+    typedef typename allocator_type::const_reference                                   const_reference;
+    typedef typename allocator_type::size_type                                         size_type;
+    typedef typename allocator_type::difference_type                                   difference_type;
+
+    typedef mstl::ht_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>             iterator;
+    typedef mstl::ht_const_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>       const_iterator;
+    typedef mstl::ht_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy>       local_iterator;
+    typedef mstl::ht_const_local_iterator<T, Hash, KeyEqual, BucketPolicy, NodePolicy> const_local_iterator;
+
+    // 节点句柄，只有节点策略的transferable为true时可以使用
+    typedef mstl::node_handle<T, node_type>                                            node_handle;
+    typedef mstl::node_insert_return<iterator, node_handle>                            insert_return_type;
 
     allocator_type get_allocator() {
         return allocator_type();
@@ -507,12 +1009,43 @@ public:
 
 private:
     bucket_type buckets_;
-    size_type   bucket_size_;
-    size_type   size_;
+    size_type     bucket_size_;
+    size_type     size_;
     // 负载因子
-    float       mlf_;
-    hasher      hash_;
-    key_equal   equal_;
+    float         mlf_;
+    hasher        hash_;
+    key_equal     equal_;
+    // 与bucket_size_同步更新，负责计算bucket下标
+    bucket_policy policy_;
+    // 节点内存的来源
+    node_policy   node_policy_;
+    // 所有节点串成一条单链表，before_begin_.next为第一个节点，同一个bucket的节点在链表中相邻，
+    // begin()与迭代器++都是O(1)，遍历与clear只与元素个数有关，与bucket个数无关
+    node_base     before_begin_;
+
+    // 渐进式rehash，开启后扩容时保留旧的bucket数组，之后每次插入只迁移rehash_step_个旧bucket，
+    // 旧数组中下标小于migrate_pos_的bucket已经迁移到新数组，其余的仍留在旧数组中，
+    // old_bucket_size_为0表示当前没有正在进行的迁移。两个数组中的bucket共用同一条链表
+    bucket_type   old_buckets_;
+    size_type     old_bucket_size_;
+    size_type     migrate_pos_;
+    // 每次插入迁移的bucket个数，为0时不开启渐进式rehash
+    size_type     rehash_step_;
+    bucket_policy old_policy_;
+    // 并行rehash使用的线程池，为nullptr时单线程。实现需要完整的thread_pool类型，
+    // 因此通过成员函数指针调用，只在设置了线程池时才实例化
+    thread_pool*  pool_;
+    void (hashtable::*parallel_replace_)(size_type);
+    // 查找前先询问的分块布隆过滤器，filter_bits_为每个元素分得的位数，为0时不使用过滤器。
+    // 渐进式rehash期间新插入与已迁移的元素记录在filter_中，尚未迁移的元素仍由old_filter_覆盖
+    bloom_block_array filter_;
+    bloom_block_array old_filter_;
+    size_type         filter_bits_;
+    size_type         filter_stale_;  // 上次重建之后删除的元素个数，它们的位仍留在过滤器中
+#ifdef MSTL_HT_STATS
+    // 查找会更新计数，因此是mutable
+    mutable ht_stats_counters counters_;
+#endif
 
 private:
     bool is_equal(const key_type& k1, const key_type k2) {
@@ -522,35 +1055,87 @@ private:
     bool is_equal(const key_type& k1, const key_type k2) const {
         return equal_(k1, k2);
     }
+
+    // 节点的完整哈希值，缓存时直接读取
+    size_type node_hash(node_ptr np) const {
+        return np->hash_code(hash_, value_traits::get_key(np->value));
+    }
+
+    size_type node_bucket(node_ptr np) const {
+        return policy_.index(node_hash(np));
+    }
+
+    // 完整哈希值为code的键所在的bucket，迁移期间尚未迁移的键仍在旧数组中，
+    // 同一个键的所有节点总是在同一个bucket中，查找只需要访问一个bucket。
+    // 新旧数组中的bucket以其地址区分
+    base_ptr& M_bucket(size_type code) noexcept {
+        if (old_bucket_size_ != 0) {
+            const size_type n = old_policy_.index(code);
+            if (n >= migrate_pos_) {
+                return old_buckets_[n];
+            }
+        }
+        return buckets_[policy_.index(code)];
+    }
+
+    const base_ptr& M_bucket(size_type code) const noexcept {
+        if (old_bucket_size_ != 0) {
+            const size_type n = old_policy_.index(code);
+            if (n >= migrate_pos_) {
+                return old_buckets_[n];
+            }
+        }
+        return buckets_[policy_.index(code)];
+    }
+
+    // bucket的第一个节点
+    static node_ptr bucket_begin(base_ptr prev) noexcept {
+        return prev != nullptr ? static_cast<node_ptr>(prev->next) : nullptr;
+    }
+
+    // 节点np是否属于bucket，bucket为M_bucket返回的引用
+    bool in_bucket(node_ptr np, const base_ptr& bucket) const {
+        return &M_bucket(node_hash(np)) == &bucket;
+    }
+
+    node_ptr begin_node() const noexcept {
+        return static_cast<node_ptr>(before_begin_.next);
+    }
+
+    // code为key的完整哈希值，缓存时哈希值不同即可跳过键值比较，key可以是透明查找的任意类型
+    template<typename K>
+    bool node_equal(node_ptr np, const K& key, size_type code) const {
+        return np->same_hash_code(code) && equal_(value_traits::get_key(np->value), key);
+    }
     
     // 生成const迭代器
     const_iterator M_cit(node_ptr node) const noexcept {
         return const_iterator(node, const_cast<hashtable*>(this));
     }
 
+    pair<iterator, iterator> M_range(const pair<node_ptr, node_ptr>& p) noexcept {
+        return mstl::make_pair(iterator(p.first, this), iterator(p.second, this));
+    }
+
+    pair<const_iterator, const_iterator> M_crange(const pair<node_ptr, node_ptr>& p) const noexcept {
+        return mstl::make_pair(M_cit(p.first), M_cit(p.second));
+    }
+
     iterator M_begin() noexcept {
-        for (size_type n = 0; n < bucket_size_; ++n) {
-            if (buckets_[n]) {
-                return iterator(buckets_[n], this);
-            }
-        }
-        return iterator(nullptr, this);
+        return iterator(begin_node(), this);
     }
 
-    iterator M_begin() const noexcept {
-        for (size_type n = 0; n < bucket_size_; ++n) {
-            if (buckets_[n]) {
-                return M_cit(buckets_[n]);
-            }
-        }
-        return M_cit(nullptr);
+    const_iterator M_begin() const noexcept {
+        return M_cit(begin_node());
     }
 
 public:
     // 各类构造函数
     explicit hashtable(size_type bucket_count, const Hash& hash = Hash(),
         const KeyEqual& equal = KeyEqual())
-        : size_(0), mlf_(1.0f), hash_(hash), equal_(equal) {
+        : size_(0), mlf_(1.0f), hash_(hash), equal_(equal),
+          old_bucket_size_(0), migrate_pos_(0), rehash_step_(0), pool_(nullptr), parallel_replace_(nullptr),
+          filter_bits_(0), filter_stale_(0) {
         init(bucket_count);
     }
 
@@ -559,7 +1144,9 @@ public:
     hashtable(InputIter first, InputIter last,
               size_type bucket_count, const Hash& hash = Hash(),
               const KeyEqual& equal = KeyEqual())
-    : size_(mstl::distance(first, last)), mlf_(1.0f), hash_(hash), equal_(equal) {
+    : size_(mstl::distance(first, last)), mlf_(1.0f), hash_(hash), equal_(equal),
+      old_bucket_size_(0), migrate_pos_(0), rehash_step_(0), pool_(nullptr), parallel_replace_(nullptr),
+      filter_bits_(0), filter_stale_(0) {
         init(mstl::max(bucket_count, static_cast<size_type>(mstl::distance(first, last))));
     }
 
@@ -569,18 +1156,41 @@ public:
 
     hashtable(hashtable&& rhs) noexcept 
         : bucket_size_(rhs.bucket_size_), size_(rhs.size_),
-        mlf_(rhs.mlf_), hash_(rhs.hash_), equal_(rhs.equal_) {
+        mlf_(rhs.mlf_), hash_(rhs.hash_), equal_(rhs.equal_), policy_(rhs.policy_),
+        old_bucket_size_(rhs.old_bucket_size_), migrate_pos_(rhs.migrate_pos_),
+        rehash_step_(rhs.rehash_step_), old_policy_(rhs.old_policy_),
+        pool_(rhs.pool_), parallel_replace_(rhs.parallel_replace_),
+        filter_(mstl::move(rhs.filter_)), old_filter_(mstl::move(rhs.old_filter_)),
+        filter_bits_(rhs.filter_bits_), filter_stale_(rhs.filter_stale_) {
         buckets_ = mstl::move(rhs.buckets_);
+        old_buckets_ = mstl::move(rhs.old_buckets_);
+        node_policy_.swap(rhs.node_policy_);
+        // 链表的头在对象内部，第一个节点所在bucket的前驱需要改为自身的before_begin_
+        before_begin_.next = rhs.before_begin_.next;
+        rhs.before_begin_.next = nullptr;
+        if (before_begin_.next != nullptr) {
+            M_bucket(node_hash(begin_node())) = &before_begin_;
+        }
         rhs.bucket_size_ = 0;
         rhs.size_ = 0;
         rhs.mlf_ = 0.0f;
+        rhs.policy_.reset(0);
+        rhs.old_bucket_size_ = 0;
+        rhs.migrate_pos_ = 0;
+        rhs.filter_bits_ = 0;
+        rhs.filter_stale_ = 0;
     }
 
     hashtable& operator=(const hashtable& rhs);
     hashtable& operator=(hashtable&& rhs) noexcept;
 
+    // 节点内存整体回收时只需析构元素
     ~hashtable() {
-        clear();
+        if (node_policy::bulk_release) {
+            destory_values();
+        } else {
+            clear();
+        }
     }
 
     iterator begin() noexcept {
@@ -654,10 +1264,26 @@ public:
         return insert_unique_noresize(value);
     }
 
-    pair<iterator, bool> insert_unique(value_traits&& value) {
-        return emplace_unique(mstl::move(value));
+    // 先查找，键值已经存在时不创建节点，value也不会被移动
+    pair<iterator, bool> insert_unique(value_type&& value);
+
+    // 键值不存在时才用key与args...在节点内原地构造元素，已经存在时不申请节点，参数也不会被移动。
+    // key的类型应为key_type，只用于map
+    template<typename K, typename... Args>
+    pair<iterator, bool> try_emplace_unique(K&& key, Args&&... args) {
+        const size_type code = hash_(key);
+        return try_emplace_hashed(mstl::forward<K>(key), code, mstl::forward<Args>(args)...);
     }
 
+    // 调用者已经用hash_func()算出key的哈希值code时使用，例如先用哈希值选择分片的并发容器，
+    // 不再重复调用哈希函数。code必须等于hash_func()(key)
+    template<typename K, typename... Args>
+    pair<iterator, bool> try_emplace_hashed(K&& key, size_type code, Args&&... args);
+
+    // 键值存在时把obj赋值给已有元素的值，否则插入，返回的bool表示是否为新插入
+    template<typename K, typename M>
+    pair<iterator, bool> insert_or_assign_unique(K&& key, M&& obj);
+
     // 同样，我们对于 hint 方法不做理会
     iterator insert_multi_use_hint(const_iterator /*hint*/, const value_type& value) {
         return insert_multi(value);
@@ -672,7 +1298,7 @@ public:
     }
 
     iterator insert_unique_use_hint(const_iterator /*hint*/, value_type&& value) {
-        return emplace_unique(mstl::move(value));
+        return insert_unique(mstl::move(value)).first;
     }
 
     template <class InputIter>
@@ -689,72 +1315,202 @@ public:
     void erase(const_iterator first, const_iterator last);
 
     size_type erase_multi(const key_type& key);
-    size_type erase_unique(const key_type& key);
+    size_type erase_unique(const key_type& key) {
+        return erase_unique_hashed(key, hash_(key));
+    }
+
+    size_type erase_unique_hashed(const key_type& key, size_type code);
+
+    // 节点句柄，摘下与链接节点都不申请内存也不复制元素，要求节点策略的transferable为true
+    // extract(key)摘下第一个键值与key相等的节点，不存在时返回空句柄
+    node_handle extract(const_iterator pos);
+    node_handle extract(const key_type& key);
+
+    // 键值已经存在时不插入，节点留在返回值的node中
+    insert_return_type insert_unique(node_handle&& nh);
+    iterator insert_multi(node_handle&& nh);
+
+    // 把other的节点逐个移到本表，other可以是同类型的任意表。
+    // 不可重复版本中键值已经存在的节点留在other中；扩容失败时已经移动的节点不会退回
+    void merge_unique(hashtable& other);
+    void merge_multi(hashtable& other);
 
     void clear();
 
     void swap(hashtable& rhs) noexcept;
 
     // hashtable查找相关
-    size_type count(const key_type& key) const;
+    // 哈希函数与键值比较函数都声明了is_transparent时，查找接口另有接受任意类型K的模板版本，
+    // 例如以string为键时可以直接用const char*查找，不必为每次查找构造临时的key_type
+    size_type count(const key_type& key) const {
+        return count_key(key);
+    }
 
-    iterator find(const key_type& key);
-    const_iterator find(const key_type& key) const;
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    size_type count(const K& key) const {
+        return count_key(key);
+    }
 
-    pair<iterator, iterator> equal_range_multi(const key_type& key);
-    pair<const_iterator, const_iterator> equal_range_multi(const key_type& key) const;
-    pair<iterator, iterator> equal_range_unique(const key_type& key);
-    pair<const_iterator, const_iterator> equal_range_unique(const key_type& key) const;
+    bool contains(const key_type& key) const {
+        return find_node(key) != nullptr;
+    }
 
-    // 每个篮子中链表的迭代器相关
-    local_iterator begin(size_type n) noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return buckets_[n];
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return find_node(key) != nullptr;
     }
 
-    const_local_iterator begin(size_type n) const noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return buckets_[n];
+    iterator find(const key_type& key) {
+        return iterator(find_node(key), this);
     }
 
-    const_local_iterator cbegin(size_type n) const noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return buckets_[n];
+    const_iterator find(const key_type& key) const {
+        return M_cit(find_node(key));
     }
 
-    local_iterator end(size_type n) noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return nullptr;
+    // 由表中的元素得到指向它的迭代器，不查找也不调用哈希函数，value必须位于本表中
+    iterator iterator_to(value_type& value) noexcept {
+        return iterator(member_offset<node_type, value_type, &node_type::value>::container_of(&value), this);
     }
 
-    const_local_iterator end(size_type n) const noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return nullptr;
+    const_iterator iterator_to(const value_type& value) const noexcept {
+        return M_cit(const_cast<node_ptr>(
+            member_offset<node_type, value_type, &node_type::value>::container_of(&value)));
     }
 
-    const_local_iterator cend(size_type n) const noexcept {
-        MSTL_DEBUG(n < bucket_size_);
-        return nullptr;
+    // 已经算出哈希值时的查找，code必须等于hash_func()(key)
+    iterator find_hashed(const key_type& key, size_type code) {
+        return iterator(find_node(key, code), this);
     }
 
-    size_type bucket_count() const noexcept {
-        return bucket_size_;
+    const_iterator find_hashed(const key_type& key, size_type code) const {
+        return M_cit(find_node(key, code));
     }
 
-    size_type max_bucket_count() const noexcept {
-        return ht_prime_list[PRIME_NUM - 1];
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return iterator(find_node(key), this);
     }
 
-    size_type bucket_size(size_type n) const noexcept;
-    size_type bucket(const key_type& key) const {
-        return hash(key);
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return M_cit(find_node(key));
     }
 
-    float load_factor() const noexcept {
-        return bucket_size_ != 0 ? (float)size_ / bucket_size_ : 0.0f; 
+    // 批量查找，keys[i]的结果写入out[i]。每组键值先统一计算哈希值并预取bucket，再预取各bucket的首节点，
+    // 最后逐个比较，使互不相关的多次查找的访存延迟相互重叠，表远大于缓存时效果明显
+    // K为key_type，或者哈希函数与比较函数都是透明的
+    template<typename K, typename mstl::enable_if<std::is_same<K, key_type>::value ||
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    void find_batch(const K* keys, size_type n, iterator* out) {
+        find_batch_impl(keys, n, out);
     }
-    
-    float max_load_factor() const noexcept {
+
+    template<typename K, typename mstl::enable_if<std::is_same<K, key_type>::value ||
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    void find_batch(const K* keys, size_type n, const_iterator* out) const {
+        find_batch_impl(keys, n, out);
+    }
+
+    template<typename K, typename mstl::enable_if<std::is_same<K, key_type>::value ||
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    void count_batch(const K* keys, size_type n, size_type* out) const {
+        count_batch_impl(keys, n, out);
+    }
+
+    pair<iterator, iterator> equal_range_multi(const key_type& key) {
+        return M_range(equal_range_multi_node(key));
+    }
+
+    pair<const_iterator, const_iterator> equal_range_multi(const key_type& key) const {
+        return M_crange(equal_range_multi_node(key));
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range_multi(const K& key) {
+        return M_range(equal_range_multi_node(key));
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range_multi(const K& key) const {
+        return M_crange(equal_range_multi_node(key));
+    }
+
+    pair<iterator, iterator> equal_range_unique(const key_type& key) {
+        return M_range(equal_range_unique_node(key));
+    }
+
+    pair<const_iterator, const_iterator> equal_range_unique(const key_type& key) const {
+        return M_crange(equal_range_unique_node(key));
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range_unique(const K& key) {
+        return M_range(equal_range_unique_node(key));
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range_unique(const K& key) const {
+        return M_crange(equal_range_unique_node(key));
+    }
+
+    // 每个篮子中链表的迭代器相关
+    local_iterator begin(size_type n) noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return local_iterator(bucket_begin(buckets_[n]), n, this);
+    }
+
+    const_local_iterator begin(size_type n) const noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return const_local_iterator(bucket_begin(buckets_[n]), n, this);
+    }
+
+    const_local_iterator cbegin(size_type n) const noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return const_local_iterator(bucket_begin(buckets_[n]), n, this);
+    }
+
+    local_iterator end(size_type n) noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return local_iterator(nullptr, n, this);
+    }
+
+    const_local_iterator end(size_type n) const noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return const_local_iterator(nullptr, n, this);
+    }
+
+    const_local_iterator cend(size_type n) const noexcept {
+        MSTL_DEBUG(n < bucket_size_);
+        return const_local_iterator(nullptr, n, this);
+    }
+
+    size_type bucket_count() const noexcept {
+        return bucket_size_;
+    }
+
+    size_type max_bucket_count() const noexcept {
+        return bucket_policy::max_size();
+    }
+
+    size_type bucket_size(size_type n) const noexcept;
+    size_type bucket(const key_type& key) const {
+        return hash(key);
+    }
+
+    float load_factor() const noexcept {
+        return bucket_size_ != 0 ? (float)size_ / bucket_size_ : 0.0f; 
+    }
+    
+    float max_load_factor() const noexcept {
         return mlf_;
     }
 
@@ -770,11 +1526,79 @@ public:
         mlf_ = ml;
     }
 
+    // rehash与reserve总是立即完成，包括尚未完成的渐进式迁移
     void rehash(size_type count);
     void reserve(size_type count) {
         return rehash(static_cast<size_type>((float)count / max_load_factor() + 0.5f));
     }
 
+    // 渐进式rehash，step为每次插入时迁移的旧bucket个数，为0时关闭，缺省关闭
+    // 开启后插入引起的扩容只申请新的bucket数组，元素在之后的插入中分批迁移，单次插入的耗时有上界，
+    // 查找与删除在迁移期间同时使用新旧两个数组。迁移期间bucket相关的接口只反映新数组，
+    // 需要时先调用finish_rehash
+    size_type rehash_step() const noexcept {
+        return rehash_step_;
+    }
+
+    void rehash_step(size_type step) {
+        // 关闭时不再有插入推进迁移，立即完成剩余部分
+        if (step == 0) {
+            finish_rehash();
+        }
+        rehash_step_ = step;
+    }
+
+    bool rehashing() const noexcept {
+        return old_bucket_size_ != 0;
+    }
+
+    void finish_rehash() {
+        if (old_bucket_size_ != 0) {
+            migrate_buckets(old_bucket_size_);
+        }
+    }
+
+    // 并行rehash，pool非空时元素不少于MSTL_HT_PARALLEL_MIN的表在扩容、rehash与reserve时
+    // 把节点重新链接的工作分给pool中的线程，缺省为nullptr。渐进式迁移仍在插入的线程中进行。
+    // 表只保存指针，pool需要比表活得更久，或者在销毁前改回nullptr
+    thread_pool* rehash_pool() const noexcept {
+        return pool_;
+    }
+
+    void rehash_pool(thread_pool* pool) noexcept {
+        pool_ = pool;
+        parallel_replace_ = &hashtable::parallel_replace_bucket;
+    }
+
+    // 并行构建，在pool上创建节点并链接，得到的元素与逐个insert_unique/insert_multi相同，
+    // unique时每个键保留第一次出现的元素。随机访问的输入并且节点内存策略允许并发申请时
+    // 节点的创建也是并行的，否则只有链接是并行的。表非空时退化为逐个插入
+    template<typename InputIter>
+    void parallel_build_unique(InputIter first, InputIter last, thread_pool& pool) {
+        parallel_build(first, last, pool, link_unique);
+    }
+
+    template<typename InputIter>
+    void parallel_build_multi(InputIter first, InputIter last, thread_pool& pool) {
+        parallel_build(first, last, pool, link_multi);
+    }
+
+    // 查找前先询问分块布隆过滤器，过滤器判定不存在时不再访问bucket与节点，
+    // 适合大部分查找都失败的表。bits_per_key为每个元素分得的位数，10时误判率约为1%，为0时关闭过滤器。
+    // 过滤器在插入时更新，rehash时随节点重新链接一起重建；删除的元素只在累计足够多之后才整体重建
+    void enable_filter(size_type bits_per_key = 10);
+
+    void disable_filter() noexcept {
+        filter_bits_ = 0;
+        filter_stale_ = 0;
+        filter_.release();
+        old_filter_.release();
+    }
+
+    bool filter_enabled() const noexcept {
+        return filter_bits_ != 0;
+    }
+
     hasher hash_func() const {
         return hash_;
     }
@@ -783,6 +1607,16 @@ public:
         return equal_;
     }
 
+    // 统计链长分布、空bucket比例与最长的top个bucket，需要遍历整个表，迁移期间只统计新数组。
+    // 定义了MSTL_HT_STATS时还包括自上次reset_stats以来的探测与rehash计数
+    ht_stats stats(size_type top = 8) const;
+
+    void reset_stats() noexcept {
+#ifdef MSTL_HT_STATS
+        counters_.reset();
+#endif
+    }
+
     // 判断hashtable是否相同
     bool equal_to_multi(const hashtable& other) const;
     bool equal_to_unique(const hashtable& other) const;
@@ -794,13 +1628,37 @@ private:
     template<typename ...Args>
     node_ptr create_node(Args&& ...args);
     void destory_node(node_ptr n);
+    void destory_values() noexcept;
 
     size_type next_size(size_type n) const;
 
     size_type hash(const key_type& key) const;
-    size_type hash(const key_type& key, size_type n) const;
     void rehash_if_need(size_type n);
 
+    template<typename K>
+    node_ptr find_node(const K& key) const;
+    template<typename K>
+    node_ptr find_node(const K& key, size_type code) const;
+    template<typename K>
+    size_type count_key(const K& key) const;
+    template<typename K>
+    base_ptr find_before_node(const base_ptr& bucket, const K& key, size_type code) const;
+    template<typename K>
+    node_ptr find_in_bucket(const base_ptr& bucket, node_ptr first, const K& key, size_type code) const;
+    template<typename K>
+    size_type count_in_bucket(const base_ptr& bucket, node_ptr first, const K& key, size_type code) const;
+    template<typename K>
+    void prefetch_group(const K* keys, size_type n, size_type* codes,
+                        const base_ptr** buckets, node_ptr* firsts) const;
+    template<typename K, typename Iter>
+    void find_batch_impl(const K* keys, size_type n, Iter* out) const;
+    template<typename K>
+    void count_batch_impl(const K* keys, size_type n, size_type* out) const;
+    template<typename K>
+    pair<node_ptr, node_ptr> equal_range_multi_node(const K& key) const;
+    template<typename K>
+    pair<node_ptr, node_ptr> equal_range_unique_node(const K& key) const;
+
 
 
 
@@ -812,9 +1670,9 @@ private:
     template<typename forwardIter>
     void copy_insert_multi(forwardIter first, forwardIter last, mstl::forward_iterator_tag);
     template<typename InputIter>
-    void copy_insert_unqiue(InputIter first, InputIter last, mstl::input_iterator_tag);
+    void copy_insert_unique(InputIter first, InputIter last, mstl::input_iterator_tag);
     template<typename forwardIter>
-    void copy_insert_unqiue(forwardIter first, forwardIter last, mstl::forward_iterator_tag);
+    void copy_insert_unique(forwardIter first, forwardIter last, mstl::forward_iterator_tag);
 
 
 
@@ -823,44 +1681,84 @@ private:
 
     iterator insert_node_multi(node_ptr np);
     pair<iterator, bool> insert_node_unique(node_ptr np);
+    iterator insert_new_node(node_ptr np, size_type code);
+    void link_new_node(node_ptr np, size_type code);
+    void insert_bucket_begin(base_ptr& bucket, node_ptr first, node_ptr last);
+    void erase_node(base_ptr& bucket, base_ptr prev, node_ptr np);
+    void unlink_node(base_ptr& bucket, base_ptr prev, node_ptr np);
+    void remove_bucket_begin(base_ptr& bucket, node_ptr next, base_ptr* next_bucket);
 
 
     void replace_bucket(size_type bucket_count);
-    void erase_bucket(size_type n, node_ptr first, node_ptr last);
-    void erase_bucket(size_type n, node_ptr last);
+    void relink_nodes(node_ptr first);
+    void start_rehash(size_type bucket_count);
+    void migrate_buckets(size_type count);
+
+    // 布隆过滤器的维护，过滤器按bucket_count个bucket装满时的元素个数分配
+    size_type filter_capacity(size_type bucket_count) const {
+        const size_type n = static_cast<size_type>((float)bucket_count * mlf_);
+        return n < size_ ? size_ : n;
+    }
+
+    void filter_insert(size_type code) noexcept {
+        if (filter_bits_ != 0) {
+            filter_.insert(code);
+        }
+    }
+
+    bool filter_may_contain(size_type code) const noexcept {
+        return filter_bits_ == 0 || filter_.may_contain(code) ||
+               (old_filter_.block_count() != 0 && old_filter_.may_contain(code));
+    }
+
+    void filter_erased(size_type n) noexcept;
+    void rebuild_filter();
+
+    // 并行链接时节点的插入方式：rehash时相同键值的一段整体移动，构建时需要查找相同的键
+    enum link_mode { link_rehash, link_unique, link_multi };
+    typedef typename ht_dependent_pool<thread_pool, T>::type pool_type;
+    void parallel_replace_bucket(size_type bucket_count);
+    template<typename InputIter>
+    void parallel_build(InputIter first, InputIter last, pool_type& pool, link_mode mode);
+    template<typename InputIter>
+    void parallel_create_nodes(InputIter first, InputIter last, mstl::vector<node_ptr>& nodes,
+                               pool_type& pool, mstl::input_iterator_tag);
+    template<typename RandomIter>
+    void parallel_create_nodes(RandomIter first, RandomIter last, mstl::vector<node_ptr>& nodes,
+                               pool_type& pool, mstl::random_access_iterator_tag);
+    node_ptr parallel_link(pool_type& pool, size_type parts, mstl::vector<node_base>& chains,
+                           link_mode mode, size_type& discarded);
 
 };
 
-template<typename T, typename Hash, typename KeyEqual>
-hashtable<T, Hash, KeyEqual>&
-hashtable<T, Hash, KeyEqual>::operator=(const hashtable& rhs) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>&
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::operator=(const hashtable& rhs) {
     if (this != &rhs) {
         hashtable temp(rhs);
-        swap(rhs);
+        swap(temp);
     }
     return *this;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-hashtable<T, Hash, KeyEqual>&
-hashtable<T, Hash, KeyEqual>::operator=(hashtable&& rhs) noexcept {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>&
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::operator=(hashtable&& rhs) noexcept {
     if (this != &rhs) {
         hashtable temp(mstl::move(rhs));
-        swap(rhs);
+        swap(temp);
     }
     return *this;
 }
 
 // 插入元素可重复
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename... Args>
-typename hashtable<T, Hash, KeyEqual>::iterator 
-hashtable<T, Hash, KeyEqual>::emplace_multi(Args&&... args) {
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator 
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::emplace_multi(Args&&... args) {
     node_ptr np = create_node(mstl::forward<Args>(args)...);
     try {
-        if ((float)(size_ + 1) > (float)bucket_size_ * max_load_factor()) {
-            rehash(size_ + 1);
-        }
+        rehash_if_need(1);
     } catch (...) {
         destory_node(np);
         throw;
@@ -869,15 +1767,13 @@ hashtable<T, Hash, KeyEqual>::emplace_multi(Args&&... args) {
 }
 
 // 插入元素不可重复
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename... Args>
-pair<typename hashtable<T, Hash, KeyEqual>::iterator, bool>
-hashtable<T, Hash, KeyEqual>::emplace_unique(Args&&... args) {
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::emplace_unique(Args&&... args) {
     node_ptr np = create_node(mstl::forward<Args>(args)...);
     try {
-        if ((float)(size_ + 1) > (float)bucket_size_ * max_load_factor()) {
-            rehash(size_ + 1);
-        }
+        rehash_if_need(1);
     } catch (...) {
         destory_node(np);
         throw;
@@ -885,155 +1781,304 @@ hashtable<T, Hash, KeyEqual>::emplace_unique(Args&&... args) {
     return insert_node_unique(np);
 }
 
-// 可重复插入相同元素
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::iterator
-hashtable<T, Hash, KeyEqual>::insert_multi_noresize(const value_type& value) {
-    const size_type n = hash(value_traits::get_key(value));
-    node_ptr first = buckets_[n];
-    node_ptr temp = create_node(value);
-    for (node_ptr cur = first; cur != nullptr; cur = cur->next) {
-        if (is_equal(value_traits::get_key(value), value_traits::get_key(cur->value))) {
-            temp->next = cur->next;
-            cur->next = temp;
-            ++size_;
-            return iterator(temp, this);
-        }
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_unique(value_type&& value) {
+    const key_type& key = value_traits::get_key(value);
+    const size_type code = hash_(key);
+    node_ptr cur = find_node(key, code);
+    if (cur != nullptr) {
+        return mstl::make_pair(iterator(cur, this), false);
     }
-    temp->next = first;
-    buckets_[n] = temp;
-    ++size_;
-    return iterator(temp, this);
+    return mstl::make_pair(insert_new_node(create_node(mstl::move(value)), code), true);
 }
 
-// 不可重复插入相同元素
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::iterator, bool>
-hashtable<T, Hash, KeyEqual>::insert_unique_noresize(const value_type& value) {
-    const size_type n = hash(value_traits::get_key(value));
-    node_ptr first = buckets_[n];
-    for (node_ptr cur = first; cur != nullptr; cur = cur->next) {
-        if (is_equal(value_traits::get_key(value), value_traits::get_key(cur->value))) {
-            return mstl::make_pair(iterator(cur, this), false);
-        }
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K, typename... Args>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::try_emplace_hashed(K&& key, size_type code,
+                                                                         Args&&... args) {
+    node_ptr cur = find_node(key, code);
+    if (cur != nullptr) {
+        return mstl::make_pair(iterator(cur, this), false);
+    }
+    node_ptr np = create_node(mstl::piecewise_construct,
+                              std::forward_as_tuple(mstl::forward<K>(key)),
+                              std::forward_as_tuple(mstl::forward<Args>(args)...));
+    return mstl::make_pair(insert_new_node(np, code), true);
+}
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K, typename M>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_or_assign_unique(K&& key, M&& obj) {
+    const size_type code = hash_(key);
+    node_ptr cur = find_node(key, code);
+    if (cur != nullptr) {
+        cur->value.second = mstl::forward<M>(obj);
+        return mstl::make_pair(iterator(cur, this), false);
+    }
+    node_ptr np = create_node(mstl::forward<K>(key), mstl::forward<M>(obj));
+    return mstl::make_pair(insert_new_node(np, code), true);
+}
+
+// 可重复插入相同元素
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_multi_noresize(const value_type& value) {
+    return insert_node_multi(create_node(value));
+}
+
+// 不可重复插入相同元素，已经存在时不创建节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_unique_noresize(const value_type& value) {
+    const size_type code = hash_(value_traits::get_key(value));
+    base_ptr& bucket = M_bucket(code);
+    node_ptr cur = find_in_bucket(bucket, bucket_begin(bucket), value_traits::get_key(value), code);
+    if (cur != nullptr) {
+        return mstl::make_pair(iterator(cur, this), false);
     }
     node_ptr temp = create_node(value);
-    temp->next = first;
-    buckets_[n] = temp;
+    temp->set_hash_code(code);
+    insert_bucket_begin(bucket, temp, temp);
+    filter_insert(code);
     ++size_;
     return mstl::make_pair(iterator(temp, this), true);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::erase(const_iterator pos) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::erase(const_iterator pos) {
     node_ptr p = pos.node;
     if (p == nullptr) {
         return;
     }
-    const size_type n = hash(value_traits::get_key(p->value));
-    node_ptr cur = buckets_[n];
-    if (cur == p) {
-        buckets_[n] = cur->next;
-        destory_node(p);
-        --size_;
-    } else {
-        node_ptr next = cur->next;
-        while (next != nullptr) {
-            if (next == p) {
-                cur->next = next->next;
-                destory_node(next);
-                --size_;
-                break;
-            } else {
-                cur = next;
-                next = cur->next;
-            }
-        }
+    base_ptr& bucket = M_bucket(node_hash(p));
+    // 单链表只能从bucket的前驱开始寻找p的前驱
+    base_ptr prev = bucket;
+    while (prev->next != p) {
+        prev = prev->next;
     }
+    erase_node(bucket, prev, p);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::erase(const_iterator first, const_iterator last) {
-    if (first.node == last.node) {
+// [first, last)是全局链表上连续的一段，可能横跨多个bucket，逐个bucket删除并修正bucket的前驱
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::erase(const_iterator first, const_iterator last) {
+    node_ptr np = first.node;
+    if (np == last.node) {
         return;
     }
-    const size_type first_bucket = first.node != nullptr ? hash(value_traits::get_key(first.node->value))
-                                    : bucket_size_;
-    const size_type last_bucket = last.node != nullptr ? hash(value_traits::get_key(last.node->value))
-                                    : bucket_size_;
-    if (first_bucket == last_bucket) {
-        erase_bucket(first_bucket, first.node, last.node);
-    } else {
-        erase_bucket(first_bucket, first.node, nullptr);
-        for (size_type n = first_bucket + 1; n < last_bucket; ++n) {
-            if (buckets_[n] != nullptr) {
-                erase_bucket(n, nullptr);
+    base_ptr* bucket = &M_bucket(node_hash(np));
+    base_ptr prev = *bucket;
+    while (prev->next != np) {
+        prev = prev->next;
+    }
+    bool is_bucket_begin = prev == *bucket;
+    base_ptr* next_bucket = bucket;
+    size_type count = 0;
+    for (;;) {
+        // 删除当前bucket中位于范围内的节点
+        do {
+            node_ptr temp = np;
+            np = np->next_node();
+            destory_node(temp);
+            --size_;
+            ++count;
+            if (np == nullptr) {
+                break;
             }
+            next_bucket = &M_bucket(node_hash(np));
+        } while (np != last.node && next_bucket == bucket);
+        if (is_bucket_begin) {
+            remove_bucket_begin(*bucket, np, next_bucket);
         }
-        if (last_bucket != bucket_size_) {
-            erase_bucket(last_bucket, last.node);
+        if (np == last.node) {
+            break;
         }
+        // 之后的bucket都从第一个节点开始删除
+        is_bucket_begin = true;
+        bucket = next_bucket;
     }
+    // 剩余的第一个节点现在接在prev之后
+    if (np != nullptr && (next_bucket != bucket || is_bucket_begin)) {
+        *next_bucket = prev;
+    }
+    prev->next = np;
+    filter_erased(count);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::erase_multi(const key_type& key) {
-    auto p = equal_range_multi(key);
-    if (p.first.node != nullptr) {
-        erase(p.first, p.second);
-        return mstl::distance(p.first, p.second);
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::erase_multi(const key_type& key) {
+    const size_type code = hash_(key);
+    base_ptr& bucket = M_bucket(code);
+    base_ptr prev = find_before_node(bucket, key, code);
+    if (prev == nullptr) {
+        return 0;
+    }
+    // 相同键值的节点相邻。key可能引用其中某个节点的元素，所以先数出这一段的长度，
+    // 再依次删除prev之后的节点，删除开始后不再使用key
+    size_type n = 1;
+    for (node_ptr cur = static_cast<node_ptr>(prev->next)->next_node();
+         cur != nullptr && node_equal(cur, key, code); cur = cur->next_node()) {
+        ++n;
     }
-    return 0;
+    for (size_type i = 0; i < n; ++i) {
+        erase_node(bucket, prev, static_cast<node_ptr>(prev->next));
+    }
+    return n;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::erase_unique(const key_type& key) {
-    const size_type n = hash(key);
-    node_ptr first = buckets_[n];
-    if (first == nullptr) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::erase_unique_hashed(const key_type& key,
+                                                                          size_type code) {
+    base_ptr& bucket = M_bucket(code);
+    base_ptr prev = find_before_node(bucket, key, code);
+    if (prev == nullptr) {
         return 0;
     }
-    if (is_equal(value_traits::get_key(first.value), key)) {
-        buckets_[n] = first->next;
-        destory_node(first);
-        --size_;
-        return 1;
-    } else {
-        node_ptr next = first->next;
-        while (next != nullptr) {
-            if (is_equal(value_traits::get_key(next->value), key)) {
-                first->next = next->next;
-                destory_node(next);
-                --size_;
-                return 1;
-            }
-            first = next;
-            next = first->next;
+    erase_node(bucket, prev, static_cast<node_ptr>(prev->next));
+    return 1;
+}
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_handle
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::extract(const_iterator pos) {
+    static_assert(node_policy::transferable, "node handles need a node policy with transferable nodes");
+    node_ptr p = pos.node;
+    if (p == nullptr) {
+        return node_handle();
+    }
+    base_ptr& bucket = M_bucket(node_hash(p));
+    base_ptr prev = bucket;
+    while (prev->next != p) {
+        prev = prev->next;
+    }
+    unlink_node(bucket, prev, p);
+    return node_handle(p);
+}
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_handle
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::extract(const key_type& key) {
+    static_assert(node_policy::transferable, "node handles need a node policy with transferable nodes");
+    const size_type code = hash_(key);
+    base_ptr& bucket = M_bucket(code);
+    base_ptr prev = find_before_node(bucket, key, code);
+    if (prev == nullptr) {
+        return node_handle();
+    }
+    node_ptr p = static_cast<node_ptr>(prev->next);
+    unlink_node(bucket, prev, p);
+    return node_handle(p);
+}
+
+// 先查找再扩容，扩容失败时节点仍由nh持有
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_return_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_unique(node_handle&& nh) {
+    static_assert(node_policy::transferable, "node handles need a node policy with transferable nodes");
+    if (nh.empty()) {
+        return insert_return_type{end(), false, node_handle()};
+    }
+    const key_type& key = value_traits::get_key(nh.node_->value);
+    const size_type code = hash_(key);
+    node_ptr cur = find_node(key, code);
+    if (cur != nullptr) {
+        return insert_return_type{iterator(cur, this), false, mstl::move(nh)};
+    }
+    rehash_if_need(1);
+    node_ptr np = nh.release();
+    link_new_node(np, code);
+    return insert_return_type{iterator(np, this), true, node_handle()};
+}
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_multi(node_handle&& nh) {
+    static_assert(node_policy::transferable, "node handles need a node policy with transferable nodes");
+    if (nh.empty()) {
+        return end();
+    }
+    rehash_if_need(1);
+    return insert_node_multi(nh.release());
+}
+
+// 沿other的链表逐个摘下节点，每个节点在摘下之前完成查找与扩容，
+// 扩容失败时当前节点仍在other中，两个表都保持完整
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::merge_unique(hashtable& other) {
+    static_assert(node_policy::transferable, "merge needs a node policy with transferable nodes");
+    if (&other == this) {
+        return;
+    }
+    base_ptr prev = &other.before_begin_;
+    while (prev->next != nullptr) {
+        node_ptr np = static_cast<node_ptr>(prev->next);
+        const key_type& key = value_traits::get_key(np->value);
+        const size_type code = hash_(key);
+        if (find_node(key, code) != nullptr) {
+            prev = np;
+            continue;
         }
+        rehash_if_need(1);
+        other.unlink_node(other.M_bucket(other.node_hash(np)), prev, np);
+        link_new_node(np, code);
     }
-    return 0;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::clear() {
-    if (size_ != 0) {
-        for (size_type i = 0; i < bucket_size_; ++i) {
-            node_ptr cur = buckets_[i];
-            while (cur != nullptr) {
-                node_ptr next = cur->next;
-                destory_node(cur);
-                cur = next;
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::merge_multi(hashtable& other) {
+    static_assert(node_policy::transferable, "merge needs a node policy with transferable nodes");
+    if (&other == this) {
+        return;
+    }
+    while (other.before_begin_.next != nullptr) {
+        node_ptr np = other.begin_node();
+        rehash_if_need(1);
+        other.unlink_node(other.M_bucket(other.node_hash(np)), &other.before_begin_, np);
+        insert_node_multi(np);
+    }
+}
+
+// 沿链表释放节点，同时清空节点所在的bucket，耗时与元素个数成正比，与bucket个数无关。
+// 节点内存整体回收时只析构元素，清空bucket数组后一次回收全部节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::clear() {
+    if (node_policy::bulk_release) {
+        if (before_begin_.next != nullptr) {
+            destory_values();
+            for (size_type i = 0; i < bucket_size_; ++i) {
+                buckets_[i] = nullptr;
             }
-            buckets_[i] = nullptr;
         }
-        size_ = 0;
+        node_policy_.release();
+    } else {
+        node_ptr cur = begin_node();
+        while (cur != nullptr) {
+            node_ptr next = cur->next_node();
+            M_bucket(node_hash(cur)) = nullptr;
+            destory_node(cur);
+            cur = next;
+        }
+    }
+    before_begin_.next = nullptr;
+    size_ = 0;
+    filter_.clear();
+    old_filter_.release();
+    filter_stale_ = 0;
+    // 没有元素需要迁移，直接结束迁移
+    if (old_bucket_size_ != 0) {
+        bucket_type().swap(old_buckets_);
+        old_bucket_size_ = 0;
+        migrate_pos_ = 0;
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::swap(hashtable& rhs) noexcept {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::swap(hashtable& rhs) noexcept {
     if (this != &rhs) {
         buckets_.swap(rhs.buckets_);
         mstl::swap(bucket_size_, rhs.bucket_size_);
@@ -1041,158 +2086,283 @@ void hashtable<T, Hash, KeyEqual>::swap(hashtable& rhs) noexcept {
         mstl::swap(mlf_, rhs.mlf_);
         mstl::swap(hash_, rhs.hash_);
         mstl::swap(equal_, rhs.equal_);
+        mstl::swap(policy_, rhs.policy_);
+        node_policy_.swap(rhs.node_policy_);
+        mstl::swap(before_begin_.next, rhs.before_begin_.next);
+        old_buckets_.swap(rhs.old_buckets_);
+        mstl::swap(old_bucket_size_, rhs.old_bucket_size_);
+        mstl::swap(migrate_pos_, rhs.migrate_pos_);
+        mstl::swap(rehash_step_, rhs.rehash_step_);
+        mstl::swap(old_policy_, rhs.old_policy_);
+        mstl::swap(pool_, rhs.pool_);
+        mstl::swap(parallel_replace_, rhs.parallel_replace_);
+        filter_.swap(rhs.filter_);
+        old_filter_.swap(rhs.old_filter_);
+        mstl::swap(filter_bits_, rhs.filter_bits_);
+        mstl::swap(filter_stale_, rhs.filter_stale_);
+        // 两边第一个节点的前驱仍指向对方的before_begin_
+        if (before_begin_.next != nullptr) {
+            M_bucket(node_hash(begin_node())) = &before_begin_;
+        }
+        if (rhs.before_begin_.next != nullptr) {
+            rhs.M_bucket(rhs.node_hash(rhs.begin_node())) = &rhs.before_begin_;
+        }
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::count(const key_type& key) const {
-    const size_type n = hash(key);
-    size_type count = 0;
-    for (node_ptr cur = buckets_[n]; cur != nullptr; cur = cur->next) {
-        if (is_equal(value_traits::get_key(cur->value), key)) {
-            ++count;
-        }
+// 查找键值与key相等的第一个节点，不存在时返回nullptr
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::find_node(const K& key) const {
+    return find_node(key, hash_(key));
+}
+
+// 已经算出key的哈希值code时使用
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::find_node(const K& key, size_type code) const {
+    if (!filter_may_contain(code)) {
+        return nullptr;
     }
-    return count;
+    const base_ptr& bucket = M_bucket(code);
+    return find_in_bucket(bucket, bucket_begin(bucket), key, code);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::iterator
-hashtable<T, Hash, KeyEqual>::find(const key_type& key) {
-    const size_type n = hash(key);
-    node_ptr cur = buckets_[n];
-    while (cur != nullptr) {
-        if (is_equal(value_traits::get_key(cur->value), key)) {
-            break;
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::count_key(const K& key) const {
+    const size_type code = hash_(key);
+    if (!filter_may_contain(code)) {
+        return 0;
+    }
+    const base_ptr& bucket = M_bucket(code);
+    return count_in_bucket(bucket, bucket_begin(bucket), key, code);
+}
+
+// 在bucket中查找第一个与key相等的节点的前驱，不存在时返回nullptr
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::base_ptr
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::find_before_node(const base_ptr& bucket, const K& key, size_type code) const {
+    base_ptr prev = bucket;
+    if (prev == nullptr) {
+        return nullptr;
+    }
+    for (node_ptr cur = static_cast<node_ptr>(prev->next);; cur = cur->next_node()) {
+        if (node_equal(cur, key, code)) {
+            return prev;
         }
-        cur = cur->next;
+        // 下一个节点属于其他bucket时结束
+        if (cur->next == nullptr || !in_bucket(cur->next_node(), bucket)) {
+            return nullptr;
+        }
+        prev = cur;
     }
-    return iterator(cur, this);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::const_iterator
-hashtable<T, Hash, KeyEqual>::find(const key_type& key) const {
-    const size_type n = hash(key);
-    node_ptr cur = buckets_[n];
-    while (cur != nullptr) {
-        if (is_equal(value_traits::get_key(cur->value), key)) {
+// 从bucket的第一个节点first开始查找，code为key的完整哈希值
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::find_in_bucket(const base_ptr& bucket, node_ptr first,
+                                                           const K& key, size_type code) const {
+#ifdef MSTL_HT_STATS
+    size_type probes = 0;
+#endif
+    for (; first != nullptr; first = first->next_node()) {
+#ifdef MSTL_HT_STATS
+        ++probes;
+#endif
+        if (node_equal(first, key, code)) {
+#ifdef MSTL_HT_STATS
+            counters_.record_find(true, probes);
+#endif
+            return first;
+        }
+        if (first->next == nullptr || !in_bucket(first->next_node(), bucket)) {
             break;
         }
-        cur = cur->next;
     }
-    return M_cit(cur);
+#ifdef MSTL_HT_STATS
+    counters_.record_find(false, probes);
+#endif
+    return nullptr;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::iterator, typename hashtable<T, Hash, KeyEqual>::iterator>
-hashtable<T, Hash, KeyEqual>::equal_range_multi(const key_type& key) {
-    const size_type n = hash(key);
-    for (node_ptr first = buckets_[n]; first != nullptr; first = first->next) {
-        // 找到第一个相等的位置
-        if (is_equal(value_traits::get_key(first->value), key)) {
-            // 开始寻找最后一个相等的位置
-            for (node_ptr second = first->next; second != nullptr; second = second->next) {
-                if (!is_equal(value_traits::get_key(second->value), key)) {
-                    return mstl::make_pair(iterator(first, this), iterator(second, this));
-                }
-            }
-            // 如果first开始的整个链表全都相等，那么寻找下一个非空的bucket作为尾节点last
-            for (size_type m = n + 1; m < bucket_size_; ++m) {
-                if (buckets_[m] != nullptr) {
-                    return mstl::make_pair(iterator(first, this), iterator(buckets_[m], this));
-                }
-            }
-            return mstl::make_pair(iterator(first, this), end());
-        }
+// 相同键值的节点相邻，找到第一个之后数出连续相等的个数即可
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::count_in_bucket(const base_ptr& bucket, node_ptr first,
+                                                            const K& key, size_type code) const {
+    size_type count = 0;
+    for (first = find_in_bucket(bucket, first, key, code);
+         first != nullptr && node_equal(first, key, code); first = first->next_node()) {
+        ++count;
     }
-    return mstl::make_pair(end(), end());
+    return count;
 }
 
-// 寻找键值为key的所有节点，并返回pair表示起止位置
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::const_iterator, typename hashtable<T, Hash, KeyEqual>::const_iterator>
-hashtable<T, Hash, KeyEqual>::equal_range_multi(const key_type& key) const {
-    const size_type n = hash(key);
-    for (node_ptr first = buckets_[n]; first != nullptr; first = first->next) {
-        // 找到第一个相等的位置
-        if (is_equal(value_traits::get_key(first->value), key)) {
-            // 开始寻找最后一个相等的位置
-            for (node_ptr second = first->next; second != nullptr; second = second->next) {
-                if (!is_equal(value_traits::get_key(second->value), key)) {
-                    return mstl::make_pair(M_cit(first), M_cit(second));
-                }
-            }
-            // 如果first开始的整个链表全都相等，那么寻找下一个非空的bucket作为尾节点last
-            for (size_type m = n + 1; m < bucket_size_; ++m) {
-                if (buckets_[m] != nullptr) {
-                    return mstl::make_pair(M_cit(first), M_cit(buckets_[m]));
-                }
-            }
-            return mstl::make_pair(M_cit(first), cend());
+// 批量查找的前三个阶段：计算n个键值的哈希值并预取所在的bucket，再预取bucket中保存的前驱节点，
+// 最后读出各bucket的第一个节点写入firsts并预取，n不超过MSTL_HT_BATCH_SIZE。
+// 使用过滤器时第一阶段同时预取过滤器的块，第二阶段询问过滤器，判定不存在的键值firsts为nullptr
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::prefetch_group(const K* keys, size_type n, size_type* codes,
+                                                                 const base_ptr** buckets, node_ptr* firsts) const {
+    bool pass[MSTL_HT_BATCH_SIZE];
+    for (size_type i = 0; i < n; ++i) {
+        codes[i] = hash_(keys[i]);
+        buckets[i] = &M_bucket(codes[i]);
+        MSTL_PREFETCH(buckets[i]);
+        if (filter_bits_ != 0) {
+            MSTL_PREFETCH(filter_.block_of(codes[i]));
+        }
+    }
+    for (size_type i = 0; i < n; ++i) {
+        pass[i] = filter_may_contain(codes[i]);
+        if (pass[i] && *buckets[i] != nullptr) {
+            MSTL_PREFETCH(*buckets[i]);
+        }
+    }
+    for (size_type i = 0; i < n; ++i) {
+        firsts[i] = pass[i] ? bucket_begin(*buckets[i]) : nullptr;
+        if (firsts[i] != nullptr) {
+            MSTL_PREFETCH(firsts[i]);
         }
     }
-    return mstl::make_pair(cend(), cend());
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::iterator, typename hashtable<T, Hash, KeyEqual>::iterator>
-hashtable<T, Hash, KeyEqual>::equal_range_unique(const key_type& key) {
-    const size_type n = hash(key);
-    for (node_ptr first = buckets_[n]; first != nullptr; first = first->next) {
-        if (is_equal(value_traits::get_key(first->value), key)) {
-            if (first->next != nullptr) {
-                return mstl::make_pair(iterator(first, this), iterator(first->next, this));
-            }
-            // 如果相等的节点是链表的最后一个节点，那么需要找到下一个非空的bucket作为结尾
-            for (size_type m = n + 1; m < bucket_size_; ++m) {
-                if (buckets_[m] != nullptr) {
-                    return mstl::make_pair(iterator(first, this), iterator(buckets_[m], this));
-                }
-            }
-            return mstl::make_pair(iterator(first, this), end());
+// 迭代器可以由const_iterator赋值，iterator与const_iterator共用同一份实现
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K, typename Iter>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::find_batch_impl(const K* keys, size_type n, Iter* out) const {
+    size_type codes[MSTL_HT_BATCH_SIZE];
+    const base_ptr* buckets[MSTL_HT_BATCH_SIZE];
+    node_ptr firsts[MSTL_HT_BATCH_SIZE];
+    for (size_type base = 0; base < n; base += MSTL_HT_BATCH_SIZE) {
+        const size_type m = mstl::min(n - base, static_cast<size_type>(MSTL_HT_BATCH_SIZE));
+        prefetch_group(keys + base, m, codes, buckets, firsts);
+        for (size_type i = 0; i < m; ++i) {
+            out[base + i] = M_cit(find_in_bucket(*buckets[i], firsts[i], keys[base + i], codes[i]));
         }
     }
-    return mstl::make_pair(end(), end());
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::const_iterator, typename hashtable<T, Hash, KeyEqual>::const_iterator>
-hashtable<T, Hash, KeyEqual>::equal_range_unique(const key_type& key) const {
-    const size_type n = hash(key);
-    for (node_ptr first = buckets_[n]; first != nullptr; first = first->next) {
-        if (is_equal(value_traits::get_key(first->value), key)) {
-            if (first->next != nullptr) {
-                return mstl::make_pair(M_cit(first), M_cit(first->next));
-            }
-            // 如果相等的节点是链表的最后一个节点，那么需要找到下一个非空的bucket作为结尾
-            for (size_type m = n + 1; m < bucket_size_; ++m) {
-                if (buckets_[m] != nullptr) {
-                    return mstl::make_pair(M_cit(first), M_cit(buckets_[m]));
-                }
-            }
-            return mstl::make_pair(M_cit(first), cend());
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::count_batch_impl(const K* keys, size_type n, size_type* out) const {
+    size_type codes[MSTL_HT_BATCH_SIZE];
+    const base_ptr* buckets[MSTL_HT_BATCH_SIZE];
+    node_ptr firsts[MSTL_HT_BATCH_SIZE];
+    for (size_type base = 0; base < n; base += MSTL_HT_BATCH_SIZE) {
+        const size_type m = mstl::min(n - base, static_cast<size_type>(MSTL_HT_BATCH_SIZE));
+        prefetch_group(keys + base, m, codes, buckets, firsts);
+        for (size_type i = 0; i < m; ++i) {
+            out[base + i] = count_in_bucket(*buckets[i], firsts[i], keys[base + i], codes[i]);
         }
     }
-    return mstl::make_pair(cend(), cend());
+}
+
+// 寻找键值为key的所有节点，并返回pair表示起止位置
+// 相同键值的节点在链表中相邻，范围的结尾就是最后一个相等节点的下一个节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr, typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::equal_range_multi_node(const K& key) const {
+    const size_type code = hash_(key);
+    node_ptr first = find_node(key, code);
+    if (first == nullptr) {
+        return mstl::make_pair(node_ptr(nullptr), node_ptr(nullptr));
+    }
+    node_ptr second = first->next_node();
+    while (second != nullptr && node_equal(second, key, code)) {
+        second = second->next_node();
+    }
+    return mstl::make_pair(first, second);
+}
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename K>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr, typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::equal_range_unique_node(const K& key) const {
+    node_ptr first = find_node(key);
+    if (first == nullptr) {
+        return mstl::make_pair(node_ptr(nullptr), node_ptr(nullptr));
+    }
+    return mstl::make_pair(first, first->next_node());
 }
 
 // 返回一个篮子中有多少节点
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::bucket_size(size_type n) const noexcept {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::bucket_size(size_type n) const noexcept {
     size_type result = 0;
-    for (node_ptr cur = buckets_[n]; cur != nullptr; cur = cur->next) {
+    for (node_ptr cur = bucket_begin(buckets_[n]); cur != nullptr && in_bucket(cur, buckets_[n]);
+         cur = cur->next_node()) {
         ++result;
     }
     return result;
 }
 
+// 逐个bucket数出链长，同时维护最长的top个bucket，top很小，直接插入排序
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+ht_stats hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::stats(size_type top) const {
+    ht_stats st;
+    st.size = size_;
+    st.bucket_count = bucket_size_;
+    st.empty_buckets = 0;
+    st.max_chain = 0;
+    st.chain_histogram.assign(MSTL_HT_STATS_HISTOGRAM, 0);
+    st.hot_buckets.reserve(top);
+    for (size_type n = 0; n < bucket_size_; ++n) {
+        const size_type len = bucket_size(n);
+        if (len == 0) {
+            ++st.empty_buckets;
+        }
+        st.max_chain = mstl::max(st.max_chain, len);
+        ++st.chain_histogram[mstl::min(len, static_cast<size_type>(MSTL_HT_STATS_HISTOGRAM - 1))];
+        if (len == 0 || top == 0) {
+            continue;
+        }
+        if (st.hot_buckets.size() == top) {
+            if (st.hot_buckets.back().second >= len) {
+                continue;
+            }
+            st.hot_buckets.pop_back();
+        }
+        size_type i = st.hot_buckets.size();
+        st.hot_buckets.push_back(mstl::pair<size_t, size_t>(n, len));
+        for (; i > 0 && st.hot_buckets[i - 1].second < len; --i) {
+            st.hot_buckets[i] = st.hot_buckets[i - 1];
+        }
+        st.hot_buckets[i] = mstl::pair<size_t, size_t>(n, len);
+    }
+#ifdef MSTL_HT_STATS
+    st.hits = counters_.hits.load(std::memory_order_relaxed);
+    st.misses = counters_.misses.load(std::memory_order_relaxed);
+    st.hit_probes = counters_.hit_probes.load(std::memory_order_relaxed);
+    st.miss_probes = counters_.miss_probes.load(std::memory_order_relaxed);
+    st.max_hit_probes = counters_.max_hit_probes.load(std::memory_order_relaxed);
+    st.max_miss_probes = counters_.max_miss_probes.load(std::memory_order_relaxed);
+    st.rehash_count = counters_.rehash_count.load(std::memory_order_relaxed);
+    st.rehash_ns = counters_.rehash_ns.load(std::memory_order_relaxed);
+#else
+    st.hits = st.misses = st.hit_probes = st.miss_probes = 0;
+    st.max_hit_probes = st.max_miss_probes = st.rehash_count = 0;
+    st.rehash_ns = 0;
+#endif
+    return st;
+}
+
 // rehash分为两种情况，扩容和缩容
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::rehash(size_type count) {
-    size_type n = ht_next_prime(count);
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::rehash(size_type count) {
+    finish_rehash();
+    size_type n = next_size(count);
     // n > bucket_size_需要扩容
     if (n > bucket_size_) {
         replace_bucket(n);
@@ -1207,8 +2377,8 @@ void hashtable<T, Hash, KeyEqual>::rehash(size_type count) {
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::init(size_type n) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::init(size_type n) {
     const size_type bucket_nums = next_size(n);
     try {
         // 注意vector扩容后大小不一定为bucket_nums
@@ -1220,235 +2390,736 @@ void hashtable<T, Hash, KeyEqual>::init(size_type n) {
         throw;
     }
     bucket_size_ = buckets_.size();
+    policy_.reset(bucket_size_);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::copy_init(const hashtable& ht) {
-    bucket_size_ = 0;
+// 迁移期间的状态原样复制，副本之后独立地继续迁移
+// 按链表顺序逐个复制节点，bucket的划分与原表相同，每个bucket的前驱就是复制时它前面的节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::copy_init(const hashtable& ht) {
     buckets_.reserve(ht.bucket_size_);
     buckets_.assign(ht.bucket_size_, nullptr);
+    if (ht.old_bucket_size_ != 0) {
+        old_buckets_.assign(ht.old_bucket_size_, nullptr);
+    }
+    bucket_size_ = ht.bucket_size_;
+    policy_ = ht.policy_;
+    old_bucket_size_ = ht.old_bucket_size_;
+    migrate_pos_ = ht.migrate_pos_;
+    old_policy_ = ht.old_policy_;
+    rehash_step_ = ht.rehash_step_;
+    pool_ = ht.pool_;
+    parallel_replace_ = ht.parallel_replace_;
+    // 过滤器的位与节点无关，原样复制
+    filter_ = ht.filter_;
+    old_filter_ = ht.old_filter_;
+    filter_bits_ = ht.filter_bits_;
+    filter_stale_ = ht.filter_stale_;
+    mlf_ = ht.mlf_;
+    // 链表在复制的每一步都是完整的，中途抛出异常时clear可以释放已复制的节点
+    size_ = 0;
     try {
-        for (int i = 0; i < ht.bucket_size_; ++i) {
-            node_ptr cur = ht.buckets_[i];
-            if (cur != nullptr) {
-                node_ptr copy = create_node(cur->value);
-                buckets_[i] = copy;
-                for (node_ptr next = cur->next; next != nullptr; cur = next, next = cur->next) {
-                    copy->next = create_node(next->value);
-                    copy = copy->next;
-                }
-                copy->next = nullptr;
+        base_ptr prev = &before_begin_;
+        for (node_ptr cur = ht.begin_node(); cur != nullptr; cur = cur->next_node()) {
+            node_ptr np = create_node(cur->value);
+            np->copy_hash_code(*cur);
+            prev->next = np;
+            base_ptr& bucket = M_bucket(node_hash(np));
+            if (bucket == nullptr) {
+                bucket = prev;
             }
+            prev = np;
+            ++size_;
         }
-        bucket_size_ = ht.bucket_size_;
-        mlf_ = ht.mlf_;
-        size_ = ht.size_;
     } catch (...) {
         clear();
+        throw;
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename ...Args>
-typename hashtable<T, Hash, KeyEqual>::node_ptr 
-hashtable<T, Hash, KeyEqual>::create_node(Args&& ...args) {
-    node_ptr temp = node_allocator::allocate(1);
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr 
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::create_node(Args&& ...args) {
+    node_ptr temp = node_policy_.template allocate<node_type>();
     try {
         data_allocator::construct(mstl::address_of(temp->value), mstl::forward<Args>(args)...);
         temp->next = nullptr;
 
     } catch(...) {
-        node_allocator::deallocate(temp);
+        node_policy_.deallocate(temp);
         throw;
     }
     return temp;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::destory_node(node_ptr node) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::destory_node(node_ptr node) {
     data_allocator::destory(mstl::address_of(node->value));
-    node_allocator::deallocate(node);
+    node_policy_.deallocate(node);
     node = nullptr;
 }
 
-// 找到大于n的下一个bucket大小
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::next_size(size_type n) const {
-    return ht_next_prime(n);
+// 只析构元素，不释放节点的内存，值类型可以平凡析构时不必遍历
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::destory_values() noexcept {
+    if (!std::is_trivially_destructible<value_type>::value) {
+        for (node_ptr cur = begin_node(); cur != nullptr; cur = cur->next_node()) {
+            data_allocator::destory(mstl::address_of(cur->value));
+        }
+    }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::hash(const key_type& key) const {
-    return hash_(key) % bucket_size_;
+// 找到大于n的下一个bucket大小
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::next_size(size_type n) const {
+    return bucket_policy::next_size(n);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::size_type
-hashtable<T, Hash, KeyEqual>::hash(const key_type& key, size_type n) const {
-    return hash_(key) % n;
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::size_type
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::hash(const key_type& key) const {
+    return policy_.index(hash_(key));
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::rehash_if_need(size_type n) {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::rehash_if_need(size_type n) {
+    if (old_bucket_size_ != 0) {
+        migrate_buckets(rehash_step_);
+    }
     if (static_cast<float>(size_ + n) > (float)bucket_size_ * max_load_factor()) {
-        rehash(size_ + n);
+        // 空表直接扩容即可，没有需要迁移的元素
+        if (rehash_step_ != 0 && size_ != 0) {
+            start_rehash(next_size(size_ + n));
+        } else {
+            rehash(size_ + n);
+        }
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename InputIter>
-void hashtable<T, Hash, KeyEqual>::copy_insert_multi(InputIter first, InputIter last, mstl::input_iterator_tag) {
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::copy_insert_multi(InputIter first, InputIter last, mstl::input_iterator_tag) {
     rehash_if_need(mstl::distance(first, last));
     for (; first != last; ++first) {
         insert_multi_noresize(*first);
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename forwardIter>
-void hashtable<T, Hash, KeyEqual>::copy_insert_multi(forwardIter first, forwardIter last, mstl::forward_iterator_tag) {
-    const size_type n = mstl::distance(first, last);
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::copy_insert_multi(forwardIter first, forwardIter last, mstl::forward_iterator_tag) {
+    size_type n = mstl::distance(first, last);
     rehash_if_need(n);
     for (; n > 0; --n, ++first) {
         insert_multi_noresize(*first);
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename InputIter>
-void hashtable<T, Hash, KeyEqual>::copy_insert_unqiue(InputIter first, InputIter last, mstl::input_iterator_tag) {
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::copy_insert_unique(InputIter first, InputIter last, mstl::input_iterator_tag) {
     rehash_if_need(mstl::distance(first, last));
     for (; first != last; ++first) {
         insert_unique_noresize(*first);
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
 template<typename forwardIter>
-void hashtable<T, Hash, KeyEqual>::copy_insert_unqiue(forwardIter first, forwardIter last, mstl::forward_iterator_tag) {
-    const size_type n = mstl::distance(first, last);
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::copy_insert_unique(forwardIter first, forwardIter last, mstl::forward_iterator_tag) {
+    size_type n = mstl::distance(first, last);
     rehash_if_need(n);
     for (; n > 0; --n, ++first) {
         insert_unique_noresize(*first);
     }
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-typename hashtable<T, Hash, KeyEqual>::iterator
-hashtable<T, Hash, KeyEqual>::insert_node_multi(node_ptr np) {
-    const size_type n = hash(value_traits::get_key(np->value));
-    node_ptr cur = buckets_[n];
-    if (cur == nullptr) {
-        buckets_[n] = np;
-        ++size_;
-        return iterator(np, this);
+// 插入到第一个键值相同的节点之前，没有相同键值时插入到bucket的开头，相同键值的节点始终相邻
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_node_multi(node_ptr np) {
+    const size_type code = hash_(value_traits::get_key(np->value));
+    np->set_hash_code(code);
+    base_ptr& bucket = M_bucket(code);
+    base_ptr prev = find_before_node(bucket, value_traits::get_key(np->value), code);
+    if (prev != nullptr) {
+        np->next = prev->next;
+        prev->next = np;
+    } else {
+        insert_bucket_begin(bucket, np, np);
     }
-    for (; cur != nullptr; cur = cur->next) {
-        if (is_equal(value_traits::get_key(cur->value), value_traits::get_key(np->value))) {
-            np->next = cur->next;
-            cur->next = np;
-            ++size_;
-            return iterator(np, this);
-        }
+    filter_insert(code);
+    ++size_;
+    return iterator(np, this);
+}
+
+// 键值已经存在时释放np，返回已有的节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+pair<typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator, bool>
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_node_unique(node_ptr np) {
+    const size_type code = hash_(value_traits::get_key(np->value));
+    np->set_hash_code(code);
+    base_ptr& bucket = M_bucket(code);
+    node_ptr cur = find_in_bucket(bucket, bucket_begin(bucket), value_traits::get_key(np->value), code);
+    if (cur != nullptr) {
+        // 重复则不插入
+        destory_node(np);
+        return mstl::make_pair(iterator(cur, this), false);
     }
-    np->next = buckets_[n];
-    buckets_[n] = np;
+    insert_bucket_begin(bucket, np, np);
+    filter_insert(code);
     ++size_;
+    return mstl::make_pair(iterator(np, this), true);
+}
+
+// 插入确定不在表中的节点np，code为键值的哈希值。查找在扩容之前完成，
+// 扩容 (或迁移) 后bucket可能改变，需要重新取得，扩容失败时释放np
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::iterator
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_new_node(node_ptr np, size_type code) {
+    try {
+        rehash_if_need(1);
+    } catch (...) {
+        destory_node(np);
+        throw;
+    }
+    link_new_node(np, code);
     return iterator(np, this);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-pair<typename hashtable<T, Hash, KeyEqual>::iterator, bool>
-hashtable<T, Hash, KeyEqual>::insert_node_unique(node_ptr np) {
-    const size_type n = hash(value_traits::get_key(np->value));
-    node_ptr cur = buckets_[n];
-    if (cur == nullptr) {
-        buckets_[n] = np;
-        ++size_;
-        return mstl::make_pair(iterator(np, this), true);
+// 把键值确定不在表中的节点np链接到表中，不检查是否需要扩容
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::link_new_node(node_ptr np, size_type code) {
+    np->set_hash_code(code);
+    insert_bucket_begin(M_bucket(code), np, np);
+    filter_insert(code);
+    ++size_;
+}
+
+// 把已经链接好的first到last一段节点插入到bucket的开头
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::insert_bucket_begin(base_ptr& bucket, node_ptr first, node_ptr last) {
+    if (bucket != nullptr) {
+        last->next = bucket->next;
+        bucket->next = first;
+    } else {
+        // 空bucket插入到整个链表的开头，原来的第一个节点改为以last为前驱
+        last->next = before_begin_.next;
+        before_begin_.next = first;
+        if (last->next != nullptr) {
+            M_bucket(node_hash(last->next_node())) = last;
+        }
+        bucket = &before_begin_;
     }
-    for (; cur != nullptr; cur = cur->next) {
-        if (is_equal(value_traits::get_key(cur->value), value_traits::get_key(np->value))) {
-            // 重复则不插入
-            return mstl::make_pair(iterator(np, this), false);
+}
+
+// 把bucket中前驱为prev的节点np从表中摘下，不销毁节点
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::unlink_node(base_ptr& bucket, base_ptr prev, node_ptr np) {
+    node_ptr next = np->next_node();
+    if (prev == bucket) {
+        remove_bucket_begin(bucket, next, next != nullptr ? &M_bucket(node_hash(next)) : nullptr);
+    } else if (next != nullptr) {
+        // np是bucket的最后一个节点时，下一个bucket的前驱变为prev
+        base_ptr& next_bucket = M_bucket(node_hash(next));
+        if (&next_bucket != &bucket) {
+            next_bucket = prev;
         }
     }
-    np->next = buckets_[n];
-    buckets_[n] = np;
-    ++size_;
-    return mstl::make_pair(iterator(np, this), true);
+    prev->next = next;
+    --size_;
+    filter_erased(1);
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::replace_bucket(size_type bucket_count) {
-    bucket_type bucket(bucket_count);
-    if (size_ != 0) {
-        for (size_type i = 0; i < bucket_size_; ++i) {
-            for (node_ptr first = buckets_[i]; first != nullptr; first = first->next) {
-                node_ptr temp = create_node(first->value);
-                const size_type n = hash(value_traits::get_key(first->value), bucket_count);
-                node_ptr f = bucket[n];
-                bool is_insert = false;
-                for (node_ptr cur = f; cur != nullptr; cur = cur->next) {
-                    // 键值相同则插入到相同节点后面
-                    if (is_equal(value_traits::get_key(cur->value), value_traits::get_key(first->value))) {
-                        temp->next = cur->next;
-                        cur->next = temp;
-                        is_insert = true;
-                        break;
-                    }
-                }
-                // 没有重复则头插法
-                if (!is_insert) {
-                    temp->next = f;
-                    bucket[n] = temp;
-                }
+// 删除bucket中前驱为prev的节点np
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::erase_node(base_ptr& bucket, base_ptr prev, node_ptr np) {
+    unlink_node(bucket, prev, np);
+    destory_node(np);
+}
+
+// bucket的第一个节点将被删除，next为其后继，next_bucket为next所在的bucket。
+// 删除后bucket为空时，next所在bucket的前驱改为bucket原来的前驱
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::remove_bucket_begin(base_ptr& bucket, node_ptr next,
+                                                                      base_ptr* next_bucket) {
+    if (next == nullptr || next_bucket != &bucket) {
+        if (next != nullptr) {
+            *next_bucket = bucket;
+        }
+        bucket = nullptr;
+    }
+}
+
+// 直接把现有节点重新链接到新的bucket数组中，不复制元素，除新的bucket数组外不申请内存。
+// 唯一可能抛出异常的申请发生在修改任何状态之前，失败时原表保持不变
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::replace_bucket(size_type bucket_count) {
+#ifdef MSTL_HT_STATS
+    counters_.record_rehash();
+    ht_rehash_timer timer(counters_);
+#endif
+    // 过滤器按新的bucket个数重建，删除留下的位也一并清除
+    bloom_block_array filter;
+    if (filter_bits_ != 0) {
+        filter.assign(bloom_block_array::blocks_for(filter_capacity(bucket_count), filter_bits_));
+    }
+    if (pool_ != nullptr && size_ >= MSTL_HT_PARALLEL_MIN) {
+        (this->*parallel_replace_)(bucket_count);
+        filter_.swap(filter);
+        old_filter_.release();
+        filter_stale_ = 0;
+        if (filter_bits_ != 0) {
+            for (node_ptr cur = begin_node(); cur != nullptr; cur = cur->next_node()) {
+                filter_.insert(node_hash(cur));
             }
         }
+        return;
     }
+    bucket_type bucket(bucket_count);
+    // 新的下标常数只需计算一次
+    const bucket_policy policy(bucket_count);
+    node_ptr first = begin_node();
+    before_begin_.next = nullptr;
     buckets_.swap(bucket);
     bucket_size_ = buckets_.size();
+    policy_ = policy;
+    filter_.swap(filter);
+    old_filter_.release();
+    filter_stale_ = 0;
+    // 缓存哈希值时不再调用哈希函数，相同键值的节点相邻，整段移动即可保持相邻，过滤器同时重建
+    relink_nodes(first);
 }
 
-// 删除第n个bucket(篮子)中[first, last)位置的节点
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::erase_bucket(size_type n, node_ptr first, node_ptr last) {
-    node_ptr cur = buckets_[n];
-    if (cur == first) {
-        erase_bucket(n, last);
-    } else {
-        node_ptr next = cur->next;
-        while (next != first) {
-            cur = next;
-            next = cur->next;
+// 把一条以nullptr结尾的节点链按当前的bucket重新链接，节点不在任何bucket中。
+// 链中相同键值的节点相邻，它们作为一段整体插入，插入后仍然相邻
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::relink_nodes(node_ptr first) {
+    while (first != nullptr) {
+        const size_type code = node_hash(first);
+        node_ptr last = first;
+        while (last->next != nullptr &&
+               node_equal(last->next_node(), value_traits::get_key(first->value), code)) {
+            last = last->next_node();
         }
-        while (next != last) {
-            cur->next = next->next;
-            destory_node(next);
-            next = cur->next;
-            --size_;
+        node_ptr next = last->next_node();
+        insert_bucket_begin(M_bucket(code), first, last);
+        filter_insert(code);
+        first = next;
+    }
+}
+
+// 开始一次渐进式rehash，只申请新的bucket数组，原数组留作old_buckets_等待迁移
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::start_rehash(size_type bucket_count) {
+    if (bucket_count <= bucket_size_) {
+        return;
+    }
+    // 上一次迁移还没有完成时先完成它，同一时刻最多只有两个bucket数组
+    finish_rehash();
+#ifdef MSTL_HT_STATS
+    counters_.record_rehash();
+#endif
+    bucket_type bucket(bucket_count);
+    // 原来的过滤器留作old_filter_覆盖未迁移的元素，新的过滤器记录之后插入与迁移的元素
+    bloom_block_array filter;
+    if (filter_bits_ != 0) {
+        filter.assign(bloom_block_array::blocks_for(filter_capacity(bucket_count), filter_bits_));
+    }
+    old_buckets_.swap(buckets_);
+    buckets_.swap(bucket);
+    old_bucket_size_ = bucket_size_;
+    old_policy_ = policy_;
+    migrate_pos_ = 0;
+    bucket_size_ = buckets_.size();
+    policy_.reset(bucket_size_);
+    if (filter_bits_ != 0) {
+        old_filter_.swap(filter_);
+        filter_.swap(filter);
+    }
+}
+
+// 把旧数组中接下来的count个bucket迁移到新数组，直接移动节点，不复制元素
+// 每个旧bucket在链表中是连续的一段，先把这一段从链表中摘下，再按新数组重新链接
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::migrate_buckets(size_type count) {
+#ifdef MSTL_HT_STATS
+    ht_rehash_timer timer(counters_);
+#endif
+    const size_type last = count < old_bucket_size_ - migrate_pos_ ? migrate_pos_ + count : old_bucket_size_;
+    for (; migrate_pos_ < last;) {
+        base_ptr& bucket = old_buckets_[migrate_pos_];
+        if (bucket == nullptr) {
+            ++migrate_pos_;
+            continue;
+        }
+        base_ptr prev = bucket;
+        node_ptr first = static_cast<node_ptr>(prev->next);
+        node_ptr tail = first;
+        while (tail->next != nullptr && in_bucket(tail->next_node(), bucket)) {
+            tail = tail->next_node();
+        }
+        node_ptr next = tail->next_node();
+        prev->next = next;
+        tail->next = nullptr;
+        if (next != nullptr) {
+            M_bucket(node_hash(next)) = prev;
+        }
+        bucket = nullptr;
+        // 先推进migrate_pos_，这一段节点之后按新数组计算bucket
+        ++migrate_pos_;
+        relink_nodes(first);
+    }
+    if (migrate_pos_ == old_bucket_size_) {
+        bucket_type().swap(old_buckets_);
+        old_bucket_size_ = 0;
+        migrate_pos_ = 0;
+        old_filter_.release();
+    }
+}
+
+// 申请失败时原来的过滤器与设置保持不变
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::enable_filter(size_type bits_per_key) {
+    if (bits_per_key == 0) {
+        disable_filter();
+        return;
+    }
+    const size_type old_bits = filter_bits_;
+    filter_bits_ = bits_per_key;
+    try {
+        rebuild_filter();
+    } catch (...) {
+        filter_bits_ = old_bits;
+        throw;
+    }
+}
+
+// 布隆过滤器不能删除，被删除元素的位留在过滤器中只会提高误判率。
+// 累计删除的个数超过现有元素个数与一半容量中的较大者时重建，重建的耗时均摊到每次删除上是常数。
+// 重建失败时继续使用原来的过滤器，它仍然覆盖所有元素，删除本身不会因此失败
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::filter_erased(size_type n) noexcept {
+    if (filter_bits_ == 0) {
+        return;
+    }
+    filter_stale_ += n;
+    if (filter_stale_ > mstl::max(size_, filter_capacity(bucket_size_) / 2)) {
+        try {
+            rebuild_filter();
+        } catch (...) {
         }
     }
 }
 
-// 删除第n个bucket(篮子)中从开始到last位置的节点
-template<typename T, typename Hash, typename KeyEqual>
-void hashtable<T, Hash, KeyEqual>::erase_bucket(size_type n, node_ptr last) {
-    node_ptr cur = buckets_[n];
-    while (cur != last) {
-        node_ptr next = cur->next;
-        destory_node(cur);
-        cur = next;
-        --size_;
+// 按当前的元素重新构建过滤器，迁移期间也只构建一个覆盖全部元素的过滤器
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::rebuild_filter() {
+    bloom_block_array filter(bloom_block_array::blocks_for(filter_capacity(bucket_size_), filter_bits_));
+    for (node_ptr cur = begin_node(); cur != nullptr; cur = cur->next_node()) {
+        filter.insert(node_hash(cur));
+    }
+    filter_.swap(filter);
+    old_filter_.release();
+    filter_stale_ = 0;
+}
+
+// 并行rehash分为三步，每一步之间由parallel_for的返回隔开：
+//   1. 旧数组按下标分成parts段，把每个bucket保存的前驱改为bucket的第一个节点，
+//      此后各段只需读取自己的节点的next，不会与其他线程改写的next冲突
+//   2. 每段沿自己的bucket遍历节点，按新的bucket下标所在的段q追加到中间链表chains[p * parts + q]
+//   3. parallel_link按段q把chains[* * parts + q]链接到新数组中，最后把各段首尾相接
+// 遍历时需要读取下一个节点的哈希值来判断它是否属于同一个bucket，这个节点可能属于其他线程，
+// 但其他线程只改写它的next，哈希值与键值不变
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::parallel_replace_bucket(size_type bucket_count) {
+    pool_type& pool = *pool_;
+    // 等待的线程也会执行任务
+    const size_type parts = (pool.size() + 1) * MSTL_HT_PARALLEL_PARTS;
+    // 所有申请都在修改状态之前完成
+    bucket_type old(bucket_count);
+    mstl::vector<node_base> chains(parts * parts);
+    mstl::vector<base_ptr> tails(parts * parts);
+    const bucket_policy policy(bucket_count);
+    const bucket_policy old_policy = policy_;
+    old.swap(buckets_);
+    bucket_size_ = buckets_.size();
+    policy_ = policy;
+
+    const size_type old_count = old.size();
+    const size_type old_per = (old_count + parts - 1) / parts;
+    const size_type per = (bucket_size_ + parts - 1) / parts;
+    pool.parallel_for(static_cast<size_type>(0), parts, [&](size_type p) {
+        const size_type last = mstl::min(old_count, (p + 1) * old_per);
+        for (size_type b = p * old_per; b < last; ++b) {
+            if (old[b] != nullptr) {
+                old[b] = old[b]->next;
+            }
+        }
+    }, static_cast<size_type>(1));
+    // 第一个bucket的前驱是before_begin_，取出之后才能清空
+    before_begin_.next = nullptr;
+    pool.parallel_for(static_cast<size_type>(0), parts, [&](size_type p) {
+        base_ptr* tail = &tails[p * parts];
+        for (size_type q = 0; q < parts; ++q) {
+            tail[q] = &chains[p * parts + q];
+        }
+        const size_type last = mstl::min(old_count, (p + 1) * old_per);
+        for (size_type b = p * old_per; b < last; ++b) {
+            node_ptr cur = static_cast<node_ptr>(old[b]);
+            if (cur == nullptr) {
+                continue;
+            }
+            size_type code = node_hash(cur);
+            while (true) {
+                node_ptr next = cur->next_node();
+                size_type next_code = 0;
+                const bool more = next != nullptr && old_policy.index(next_code = node_hash(next)) == b;
+                const size_type q = policy_.index(code) / per;
+                tail[q]->next = cur;
+                tail[q] = cur;
+                if (!more) {
+                    break;
+                }
+                cur = next;
+                code = next_code;
+            }
+        }
+        for (size_type q = 0; q < parts; ++q) {
+            tail[q]->next = nullptr;
+        }
+    }, static_cast<size_type>(1));
+    size_type discarded = 0;
+    parallel_link(pool, parts, chains, link_rehash, discarded);
+}
+
+// 表为空时才并行构建，节点先全部创建好，按输入的顺序保存在nodes中，之后与并行rehash的后两步相同
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename InputIter>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::parallel_build(InputIter first, InputIter last,
+                                                                pool_type& pool, link_mode mode) {
+    if (!empty() || old_bucket_size_ != 0) {
+        if (mode == link_unique) {
+            insert_unique(first, last);
+        } else {
+            insert_multi(first, last);
+        }
+        return;
+    }
+    mstl::vector<node_ptr> nodes;
+    try {
+        parallel_create_nodes(first, last, nodes, pool, iterator_category(first));
+    } catch (...) {
+        for (size_type i = 0; i < nodes.size(); ++i) {
+            if (nodes[i] != nullptr) {
+                destory_node(nodes[i]);
+            }
+        }
+        throw;
+    }
+    const size_type n = nodes.size();
+    // 等待的线程也会执行任务
+    const size_type parts = (pool.size() + 1) * MSTL_HT_PARALLEL_PARTS;
+    try {
+        const size_type want = next_size(static_cast<size_type>((float)n / max_load_factor() + 0.5f));
+        if (want > bucket_size_) {
+            bucket_type bucket(want);
+            buckets_.swap(bucket);
+            bucket_size_ = buckets_.size();
+            policy_.reset(bucket_size_);
+        }
+        bloom_block_array filter;
+        if (filter_bits_ != 0) {
+            filter.assign(bloom_block_array::blocks_for(filter_capacity(bucket_size_), filter_bits_));
+        }
+        mstl::vector<node_base> chains(parts * parts);
+        mstl::vector<base_ptr> tails(parts * parts);
+        const size_type node_per = (n + parts - 1) / parts;
+        const size_type per = (bucket_size_ + parts - 1) / parts;
+        pool.parallel_for(static_cast<size_type>(0), parts, [&](size_type p) {
+            base_ptr* tail = &tails[p * parts];
+            for (size_type q = 0; q < parts; ++q) {
+                tail[q] = &chains[p * parts + q];
+            }
+            const size_type end = mstl::min(n, (p + 1) * node_per);
+            for (size_type i = p * node_per; i < end; ++i) {
+                node_ptr np = nodes[i];
+                const size_type code = hash_(value_traits::get_key(np->value));
+                np->set_hash_code(code);
+                const size_type q = policy_.index(code) / per;
+                tail[q]->next = np;
+                tail[q] = np;
+            }
+            for (size_type q = 0; q < parts; ++q) {
+                tail[q]->next = nullptr;
+            }
+        }, static_cast<size_type>(1));
+        size_type discarded = 0;
+        node_ptr dup = parallel_link(pool, parts, chains, mode, discarded);
+        size_ = n - discarded;
+        filter_.swap(filter);
+        filter_stale_ = 0;
+        if (filter_bits_ != 0) {
+            for (node_ptr cur = begin_node(); cur != nullptr; cur = cur->next_node()) {
+                filter_.insert(node_hash(cur));
+            }
+        }
+        while (dup != nullptr) {
+            node_ptr next = dup->next_node();
+            destory_node(dup);
+            dup = next;
+        }
+    } catch (...) {
+        // 只有链接开始之前的申请可能失败，此时节点还不在表中
+        for (size_type i = 0; i < n; ++i) {
+            destory_node(nodes[i]);
+        }
+        throw;
+    }
+}
+
+// 单次遍历的输入只能逐个创建
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename InputIter>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::parallel_create_nodes(InputIter first, InputIter last,
+    mstl::vector<node_ptr>& nodes, pool_type&, mstl::input_iterator_tag) {
+    for (; first != last; ++first) {
+        nodes.push_back(nullptr);
+        nodes.back() = create_node(*first);
+    }
+}
+
+// 各线程创建的节点写入nodes中互不重叠的位置，抛出异常时未创建的位置保持为nullptr
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+template<typename RandomIter>
+void hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::parallel_create_nodes(RandomIter first, RandomIter last,
+    mstl::vector<node_ptr>& nodes, pool_type& pool, mstl::random_access_iterator_tag) {
+    const size_type n = static_cast<size_type>(last - first);
+    nodes.assign(n, nullptr);
+    if (!node_policy::concurrent_allocate) {
+        for (size_type i = 0; i < n; ++i) {
+            nodes[i] = create_node(first[i]);
+        }
+        return;
+    }
+    pool.parallel_for(static_cast<size_type>(0), n, [&](size_type i) {
+        nodes[i] = create_node(first[i]);
+    });
+}
+
+// 第q段负责新数组中[q * per, (q + 1) * per)的bucket，依次取出各段p交给它的节点插入。
+// 链接期间bucket中暂存该bucket最后一个节点，bucket内的节点连成环，最后一个节点的next为第一个节点，
+// 于是插入到开头与找到结尾都是O(1)。全部插入后按下标顺序把各bucket连成一条链表，
+// bucket改回保存前驱，最后把各段的链表首尾相接。
+// unique时与已有节点键值相同的节点串成链表返回，由调用者销毁，discarded为其个数
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+typename hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::node_ptr
+hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::parallel_link(pool_type& pool, size_type parts,
+    mstl::vector<node_base>& chains, link_mode mode, size_type& discarded) {
+    const size_type per = (bucket_size_ + parts - 1) / parts;
+    mstl::vector<node_base> heads(parts);
+    mstl::vector<base_ptr> tails(parts);
+    mstl::vector<size_type> firsts(parts);
+    mstl::vector<node_ptr> dups(parts);
+    mstl::vector<size_type> counts(parts);
+    pool.parallel_for(static_cast<size_type>(0), parts, [&](size_type q) {
+        node_ptr dup = nullptr;
+        size_type count = 0;
+        for (size_type p = 0; p < parts; ++p) {
+            for (node_ptr cur = static_cast<node_ptr>(chains[p * parts + q].next); cur != nullptr;) {
+                const size_type code = node_hash(cur);
+                base_ptr& bucket = buckets_[policy_.index(code)];
+                node_ptr last = cur;
+                base_ptr prev = bucket;
+                if (mode == link_rehash) {
+                    while (last->next != nullptr &&
+                           node_equal(last->next_node(), value_traits::get_key(cur->value), code)) {
+                        last = last->next_node();
+                    }
+                } else if (bucket != nullptr) {
+                    // 找到第一个相同键值的节点的前驱，没有时prev仍为环的结尾，即插入到开头
+                    base_ptr pos = bucket;
+                    bool found = false;
+                    do {
+                        if (node_equal(static_cast<node_ptr>(pos->next), value_traits::get_key(cur->value), code)) {
+                            found = true;
+                            break;
+                        }
+                        pos = pos->next;
+                    } while (pos != bucket);
+                    if (found && mode == link_unique) {
+                        node_ptr next = cur->next_node();
+                        cur->next = dup;
+                        dup = cur;
+                        ++count;
+                        cur = next;
+                        continue;
+                    }
+                    if (found) {
+                        prev = pos;
+                    }
+                }
+                node_ptr next = last->next_node();
+                if (bucket == nullptr) {
+                    last->next = cur;
+                    bucket = last;
+                } else {
+                    last->next = prev->next;
+                    prev->next = cur;
+                }
+                cur = next;
+            }
+        }
+        // 按下标顺序把各bucket的环拆开接成一条链表
+        base_ptr prev = &heads[q];
+        size_type first_bucket = bucket_size_;
+        const size_type end = mstl::min(bucket_size_, (q + 1) * per);
+        for (size_type b = q * per; b < end; ++b) {
+            if (buckets_[b] != nullptr) {
+                base_ptr tail = buckets_[b];
+                prev->next = tail->next;
+                buckets_[b] = prev;
+                prev = tail;
+                if (first_bucket == bucket_size_) {
+                    first_bucket = b;
+                }
+            }
+        }
+        prev->next = nullptr;
+        tails[q] = prev;
+        firsts[q] = first_bucket;
+        dups[q] = dup;
+        counts[q] = count;
+    }, static_cast<size_type>(1));
+
+    base_ptr prev = &before_begin_;
+    node_ptr dup = nullptr;
+    discarded = 0;
+    for (size_type q = 0; q < parts; ++q) {
+        if (firsts[q] != bucket_size_) {
+            prev->next = heads[q].next;
+            buckets_[firsts[q]] = prev;
+            prev = tails[q];
+        }
+        if (dups[q] != nullptr) {
+            node_ptr d = dups[q];
+            while (d->next != nullptr) {
+                d = d->next_node();
+            }
+            d->next = dup;
+            dup = dups[q];
+        }
+        discarded += counts[q];
     }
-    buckets_[n] = last;
+    prev->next = nullptr;
+    return dup;
 }
 
 // 判断两个hashtable是否相同
-template<typename T, typename Hash, typename KeyEqual>
-bool hashtable<T, Hash, KeyEqual>::equal_to_multi(const hashtable& other) const {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::equal_to_multi(const hashtable& other) const {
     if (size_ != other.size_) {
         return false;
     }
@@ -1466,8 +3137,8 @@ bool hashtable<T, Hash, KeyEqual>::equal_to_multi(const hashtable& other) const
     return true;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-bool hashtable<T, Hash, KeyEqual>::equal_to_unique(const hashtable& other) const {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>::equal_to_unique(const hashtable& other) const {
     if (size_ != other.size_) {
         return false;
     }
@@ -1480,8 +3151,8 @@ bool hashtable<T, Hash, KeyEqual>::equal_to_unique(const hashtable& other) const
     return true;
 }
 
-template<typename T, typename Hash, typename KeyEqual>
-void swap(hashtable<T, Hash, KeyEqual>& lhs, hashtable<T, Hash, KeyEqual>& rhs) noexcept {
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void swap(hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs, hashtable<T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) noexcept {
     lhs.swap(rhs);
 }
 
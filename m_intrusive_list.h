@@ -0,0 +1,619 @@
+#ifndef M_INTRUSIVE_LIST_H_
+#define M_INTRUSIVE_LIST_H_
+
+// 侵入式双向链表intrusive_list
+// 链表不拥有元素，也不申请任何内存：前后指针保存在元素自身的成员hook中，
+// 链表只在自身内部保存一个哨兵节点，与list一样由哨兵节点与元素组成一个环。
+// 链接与剔除操作复用m_list.h中的list_link_nodes/list_unlink_nodes。
+// hook有三种模式：
+//   normal_link：不做任何额外工作，元素必须在销毁前由使用者从链表中移除
+//   safe_link：未链接时指针为nullptr，可以用is_linked查询，重复插入或带着链接销毁会触发断言
+//   auto_unlink：在safe_link的基础上，元素销毁时自动从所在链表中移除，也可以直接调用hook的unlink，
+//                此时链表无法得知元素个数的变化，size()需要遍历链表
+// 用法：
+//   struct timer { intrusive_list_hook<> hook; ... };
+//   intrusive_list<timer, intrusive_list_hook<>, &timer::hook> timers;
+// hook以类型加成员指针两个模板参数给出：本库按C++14编写，template<auto>要到C++17才可用
+
+#include <type_traits>
+
+#include "m_list.h"
+#include "m_iterator.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+enum intrusive_link_mode {
+    normal_link,
+    safe_link,
+    auto_unlink
+};
+
+// hook中保存的节点，链表的哨兵节点也使用这个类型
+struct intrusive_list_node {
+    typedef intrusive_list_node* node_ptr;
+
+    node_ptr prev;
+    node_ptr next;
+
+    intrusive_list_node() = default;
+
+    // 与list中的node_一样，初始化时前后指针都指向自己
+    void unlink() {
+        prev = next = this;
+    }
+};
+
+template<intrusive_link_mode Mode = safe_link>
+class intrusive_list_hook : public intrusive_list_node {
+public:
+    static constexpr intrusive_link_mode link_mode = Mode;
+
+    intrusive_list_hook() {
+        init();
+    }
+
+    // hook不随元素一起拷贝，拷贝得到的元素处于未链接状态
+    intrusive_list_hook(const intrusive_list_hook&) : intrusive_list_hook() {}
+
+    intrusive_list_hook& operator=(const intrusive_list_hook&) {
+        return *this;
+    }
+
+    ~intrusive_list_hook() {
+        destroy(std::integral_constant<bool, Mode == auto_unlink>());
+    }
+
+    // normal_link模式下没有记录链接状态，总是返回false
+    bool is_linked() const noexcept {
+        return Mode != normal_link && next != nullptr;
+    }
+
+    // 将所在的元素从链表中移除，只有auto_unlink模式可以直接调用
+    void unlink() {
+        static_assert(Mode == auto_unlink,
+                      "only auto_unlink hook can unlink itself, use intrusive_list::erase instead");
+        if (is_linked()) {
+            list_unlink_nodes(static_cast<node_ptr>(this), static_cast<node_ptr>(this));
+            init();
+        }
+    }
+
+    // 以下两个函数供intrusive_list使用
+    // 链接前检查hook是否已经在其他链表中
+    void check_unlinked() const {
+        MSTL_DEBUG(Mode == normal_link || next == nullptr);
+    }
+
+    // 从链表剔除后恢复为未链接状态
+    void init() {
+        if (Mode != normal_link) {
+            prev = next = nullptr;
+        }
+    }
+
+private:
+    void destroy(std::true_type) {
+        unlink();
+    }
+
+    void destroy(std::false_type) {
+        // safe_link模式下元素销毁时不能仍然位于链表中
+        MSTL_DEBUG(Mode == normal_link || next == nullptr);
+    }
+};
+
+// 在元素与hook之间相互转化
+template<typename T, typename Hook, Hook T::*HookPtr>
+struct intrusive_list_traits {
+    typedef intrusive_list_node* node_ptr;
+    typedef T*                   pointer;
+    typedef const T*             const_pointer;
+
+    static node_ptr to_node(T& value) {
+        return static_cast<node_ptr>(&(value.*HookPtr));
+    }
+
+    static pointer to_value(node_ptr node) {
+        return mstl::member_offset<T, Hook, HookPtr>::container_of(static_cast<Hook*>(node));
+    }
+
+    static Hook* to_hook(node_ptr node) {
+        return static_cast<Hook*>(node);
+    }
+};
+
+// intrusive_list的迭代器定义
+template<typename T, typename Hook, Hook T::*HookPtr>
+class intrusive_list_iterator : public iterator<mstl::bidirectional_iterator_tag, T> {
+public:
+    typedef T                                          value_type;
+    typedef T*                                         pointer;
+    typedef T&                                         reference;
+    typedef intrusive_list_traits<T, Hook, HookPtr>    traits;
+    typedef typename traits::node_ptr                  node_ptr;
+    typedef intrusive_list_iterator<T, Hook, HookPtr>  self;
+
+    node_ptr node_;
+
+    intrusive_list_iterator() = default;
+
+    explicit intrusive_list_iterator(node_ptr ptr) : node_(ptr) {}
+
+    reference operator*() const {
+        return *traits::to_value(node_);
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(node_ != nullptr);
+        node_ = node_->next;
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*(this);
+        return temp;
+    }
+
+    self& operator--() {
+        MSTL_DEBUG(node_ != nullptr);
+        node_ = node_->prev;
+        return *this;
+    }
+
+    self operator--(int) {
+        self temp = *this;
+        --*(this);
+        return temp;
+    }
+
+    bool operator==(const self& rhs) const {
+        return node_ == rhs.node_;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return node_ != rhs.node_;
+    }
+};
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+class intrusive_list_const_iterator : public iterator<mstl::bidirectional_iterator_tag, T> {
+public:
+    typedef T                                                value_type;
+    typedef const T*                                         pointer;
+    typedef const T&                                         reference;
+    typedef intrusive_list_traits<T, Hook, HookPtr>          traits;
+    typedef typename traits::node_ptr                        node_ptr;
+    typedef intrusive_list_const_iterator<T, Hook, HookPtr>  self;
+
+    node_ptr node_;
+
+    intrusive_list_const_iterator() = default;
+
+    explicit intrusive_list_const_iterator(node_ptr ptr) : node_(ptr) {}
+
+    intrusive_list_const_iterator(const intrusive_list_iterator<T, Hook, HookPtr>& rhs) : node_(rhs.node_) {}
+
+    reference operator*() const {
+        return *traits::to_value(node_);
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(node_ != nullptr);
+        node_ = node_->next;
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*(this);
+        return temp;
+    }
+
+    self& operator--() {
+        MSTL_DEBUG(node_ != nullptr);
+        node_ = node_->prev;
+        return *this;
+    }
+
+    self operator--(int) {
+        self temp = *this;
+        --*(this);
+        return temp;
+    }
+
+    bool operator==(const self& rhs) const {
+        return node_ == rhs.node_;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return node_ != rhs.node_;
+    }
+};
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+class intrusive_list {
+public:
+    typedef T                                                  value_type;
+    typedef T*                                                 pointer;
+    typedef const T*                                           const_pointer;
+    typedef T&                                                 reference;
+    typedef const T&                                           const_reference;
+    typedef size_t                                             size_type;
+    typedef ptrdiff_t                                          difference_type;
+
+    typedef intrusive_list_iterator<T, Hook, HookPtr>          iterator;
+    typedef intrusive_list_const_iterator<T, Hook, HookPtr>    const_iterator;
+    typedef mstl::reverse_iterator<iterator>                   reverse_iterator;
+    typedef mstl::reverse_iterator<const_iterator>             const_reverse_iterator;
+
+    typedef intrusive_list_traits<T, Hook, HookPtr>            traits;
+    typedef typename traits::node_ptr                          node_ptr;
+
+    // auto_unlink的元素可能在链表不知情时被移除，此时不维护元素个数
+    static constexpr bool constant_time_size = Hook::link_mode != auto_unlink;
+
+private:
+    // 哨兵节点直接保存在链表对象中，因此链表对象不能按位移动
+    intrusive_list_node node_;
+    size_type           size_;
+
+public:
+    intrusive_list() : size_(0) {
+        node_.unlink();
+    }
+
+    template<typename Iter, typename mstl::enable_if<
+            mstl::is_input_iterator<Iter>::value, int>::type = 0>
+    intrusive_list(Iter first, Iter last) : intrusive_list() {
+        insert(end(), first, last);
+    }
+
+    intrusive_list(const intrusive_list&) = delete;
+    intrusive_list& operator=(const intrusive_list&) = delete;
+
+    intrusive_list(intrusive_list&& rhs) noexcept : intrusive_list() {
+        swap(rhs);
+    }
+
+    intrusive_list& operator=(intrusive_list&& rhs) noexcept {
+        if (this != &rhs) {
+            clear();
+            swap(rhs);
+        }
+        return *this;
+    }
+
+    // 只解除链接，元素的生命周期由使用者管理
+    ~intrusive_list() {
+        clear();
+    }
+
+public:
+    // 迭代器相关操作
+    iterator begin() noexcept {
+        return iterator(node_.next);
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(node_.next);
+    }
+
+    iterator end() noexcept {
+        return iterator(&node_);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(const_cast<node_ptr>(&node_));
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    const_reverse_iterator crbegin() const noexcept {
+        return rbegin();
+    }
+
+    const_reverse_iterator crend() const noexcept {
+        return rend();
+    }
+
+    // 由元素得到指向它的迭代器，元素必须位于链表中
+    static iterator iterator_to(reference value) {
+        return iterator(traits::to_node(value));
+    }
+
+    static const_iterator iterator_to(const_reference value) {
+        return const_iterator(traits::to_node(const_cast<reference>(value)));
+    }
+
+    // 容量相关方法
+    bool empty() const noexcept {
+        return node_.next == &node_;
+    }
+
+    size_type size() const noexcept {
+        if (constant_time_size) {
+            return size_;
+        }
+        return static_cast<size_type>(mstl::distance(begin(), end()));
+    }
+
+    // 访问元素
+    reference front() {
+        MSTL_DEBUG(!empty());
+        return *begin();
+    }
+
+    const_reference front() const {
+        MSTL_DEBUG(!empty());
+        return *begin();
+    }
+
+    reference back() {
+        MSTL_DEBUG(!empty());
+        return *(--end());
+    }
+
+    const_reference back() const {
+        MSTL_DEBUG(!empty());
+        return *(--end());
+    }
+
+    // 插入元素，元素在插入前不能位于任何链表中
+    void push_front(reference value) {
+        insert(begin(), value);
+    }
+
+    void push_back(reference value) {
+        insert(end(), value);
+    }
+
+    iterator insert(const_iterator pos, reference value) {
+        node_ptr n = traits::to_node(value);
+        traits::to_hook(n)->check_unlinked();
+        list_link_nodes(pos.node_, n, n);
+        ++size_;
+        return iterator(n);
+    }
+
+    // 插入[first, last)所指的元素，迭代器解引用得到的是元素的引用
+    template<typename Iter, typename mstl::enable_if<
+            mstl::is_input_iterator<Iter>::value, int>::type = 0>
+    void insert(const_iterator pos, Iter first, Iter last) {
+        for (; first != last; ++first) {
+            insert(pos, *first);
+        }
+    }
+
+    void pop_front() {
+        MSTL_DEBUG(!empty());
+        erase(begin());
+    }
+
+    void pop_back() {
+        MSTL_DEBUG(!empty());
+        erase(--end());
+    }
+
+    // 移除元素，只解除链接而不销毁元素
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    // O(1)地将元素从链表中移除，元素必须位于本链表中
+    void erase(reference value) {
+        erase(iterator_to(value));
+    }
+
+    void clear() {
+        clear_and_dispose([](pointer) {});
+    }
+
+    // 移除元素并对每个元素调用disposer，通常用于释放链表实际拥有的元素
+    template<typename Disposer>
+    iterator erase_and_dispose(const_iterator pos, Disposer disposer);
+
+    template<typename Disposer>
+    void clear_and_dispose(Disposer disposer);
+
+    void swap(intrusive_list& rhs) noexcept;
+
+    // list相关操作
+    void splice(const_iterator pos, intrusive_list& x);
+    void splice(const_iterator pos, intrusive_list& x, const_iterator it);
+    void splice(const_iterator pos, intrusive_list& x, const_iterator first, const_iterator last);
+
+    template<typename UnaryPredicate>
+    void remove_if(UnaryPredicate pred);
+
+    void reverse();
+
+private:
+    // 解除n的链接，并恢复hook的状态
+    void unlink_node(node_ptr n) {
+        list_unlink_nodes(n, n);
+        traits::to_hook(n)->init();
+        --size_;
+    }
+};
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+typename intrusive_list<T, Hook, HookPtr>::iterator
+intrusive_list<T, Hook, HookPtr>::erase(const_iterator pos) {
+    MSTL_DEBUG(pos != cend());
+    node_ptr n = pos.node_;
+    node_ptr next = n->next;
+    unlink_node(n);
+    return iterator(next);
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+typename intrusive_list<T, Hook, HookPtr>::iterator
+intrusive_list<T, Hook, HookPtr>::erase(const_iterator first, const_iterator last) {
+    while (first != last) {
+        first = erase(first);
+    }
+    return iterator(last.node_);
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+template<typename Disposer>
+typename intrusive_list<T, Hook, HookPtr>::iterator
+intrusive_list<T, Hook, HookPtr>::erase_and_dispose(const_iterator pos, Disposer disposer) {
+    MSTL_DEBUG(pos != cend());
+    node_ptr n = pos.node_;
+    node_ptr next = n->next;
+    unlink_node(n);
+    disposer(traits::to_value(n));
+    return iterator(next);
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+template<typename Disposer>
+void intrusive_list<T, Hook, HookPtr>::clear_and_dispose(Disposer disposer) {
+    node_ptr cur = node_.next;
+    while (cur != &node_) {
+        node_ptr next = cur->next;
+        traits::to_hook(cur)->init();
+        disposer(traits::to_value(cur));
+        cur = next;
+    }
+    node_.unlink();
+    size_ = 0;
+}
+
+// 哨兵节点位于链表对象内部，交换时需要修正首尾元素指向哨兵的指针
+template<typename T, typename Hook, Hook T::*HookPtr>
+void intrusive_list<T, Hook, HookPtr>::swap(intrusive_list& rhs) noexcept {
+    if (this == &rhs) {
+        return;
+    }
+    intrusive_list_node temp;
+    temp.unlink();
+    if (!empty()) {
+        list_transfer_nodes(static_cast<node_ptr>(&temp), node_.next, node_.prev);
+    }
+    if (!rhs.empty()) {
+        list_transfer_nodes(static_cast<node_ptr>(&node_), rhs.node_.next, rhs.node_.prev);
+    }
+    if (temp.next != &temp) {
+        list_transfer_nodes(static_cast<node_ptr>(&rhs.node_), temp.next, temp.prev);
+    }
+    mstl::swap(size_, rhs.size_);
+}
+
+// 将x的所有元素插入到pos位置之前
+template<typename T, typename Hook, Hook T::*HookPtr>
+void intrusive_list<T, Hook, HookPtr>::splice(const_iterator pos, intrusive_list& x) {
+    MSTL_DEBUG(this != &x);
+    if (!x.empty()) {
+        list_transfer_nodes(pos.node_, x.node_.next, x.node_.prev);
+        size_ += x.size_;
+        x.size_ = 0;
+    }
+}
+
+// 将x中it所指的元素插入到pos位置之前
+template<typename T, typename Hook, Hook T::*HookPtr>
+void intrusive_list<T, Hook, HookPtr>::splice(const_iterator pos, intrusive_list& x, const_iterator it) {
+    if (pos.node_ != it.node_ && pos.node_ != it.node_->next) {
+        list_transfer_nodes(pos.node_, it.node_, it.node_);
+        ++size_;
+        --x.size_;
+    }
+}
+
+// 将x中[first, last)所指的元素插入到pos位置之前
+template<typename T, typename Hook, Hook T::*HookPtr>
+void intrusive_list<T, Hook, HookPtr>::splice(const_iterator pos, intrusive_list& x,
+                                              const_iterator first, const_iterator last) {
+    if (first != last && this != &x) {
+        // auto_unlink模式下不维护元素个数，无需遍历计算区间长度
+        const size_type n = constant_time_size ? static_cast<size_type>(mstl::distance(first, last)) : 0;
+        list_transfer_nodes(pos.node_, first.node_, last.node_->prev);
+        size_ += n;
+        x.size_ -= n;
+    } else if (first != last) {
+        list_transfer_nodes(pos.node_, first.node_, last.node_->prev);
+    }
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+template<typename UnaryPredicate>
+void intrusive_list<T, Hook, HookPtr>::remove_if(UnaryPredicate pred) {
+    iterator f = begin();
+    iterator l = end();
+    for (iterator next = f; next != l; f = next) {
+        ++next;
+        if (pred(*f)) {
+            erase(f);
+        }
+    }
+}
+
+// 交换每个节点的前后指针即可反转整个环
+template<typename T, typename Hook, Hook T::*HookPtr>
+void intrusive_list<T, Hook, HookPtr>::reverse() {
+    node_ptr cur = &node_;
+    do {
+        mstl::swap(cur->prev, cur->next);
+        cur = cur->prev;
+    } while (cur != &node_);
+}
+
+// 重载比较操作符
+template<typename T, typename Hook, Hook T::*HookPtr>
+bool operator==(const intrusive_list<T, Hook, HookPtr>& lhs, const intrusive_list<T, Hook, HookPtr>& rhs) {
+    auto f1 = lhs.cbegin();
+    auto f2 = rhs.cbegin();
+    auto l1 = lhs.cend();
+    auto l2 = rhs.cend();
+    for (; f1 != l1 && f2 != l2 && *f1 == *f2; ++f1, ++f2) {
+    }
+    return f1 == l1 && f2 == l2;
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+bool operator!=(const intrusive_list<T, Hook, HookPtr>& lhs, const intrusive_list<T, Hook, HookPtr>& rhs) {
+    return !(lhs == rhs);
+}
+
+template<typename T, typename Hook, Hook T::*HookPtr>
+void swap(intrusive_list<T, Hook, HookPtr>& lhs, intrusive_list<T, Hook, HookPtr>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // mstl
+
+#endif
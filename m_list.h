@@ -199,6 +199,31 @@ public:
     }
 };
 
+// 与节点类型无关的链接操作，NodePtr只需要指向带有prev、next成员的节点，
+// list与intrusive_list共用这一组函数
+// 将[first, last]范围的节点插入到pos之前
+template<typename NodePtr>
+inline void list_link_nodes(NodePtr pos, NodePtr first, NodePtr last) {
+    pos->prev->next = first;
+    first->prev = pos->prev;
+    pos->prev = last;
+    last->next = pos;
+}
+
+// 将[first, last]范围的节点从所在链表中剔除，节点自身的指针保持不变
+template<typename NodePtr>
+inline void list_unlink_nodes(NodePtr first, NodePtr last) {
+    first->prev->next = last->next;
+    last->next->prev = first->prev;
+}
+
+// 将[first, last]范围的节点从所在链表中取下，插入到pos之前
+template<typename NodePtr>
+inline void list_transfer_nodes(NodePtr pos, NodePtr first, NodePtr last) {
+    list_unlink_nodes(first, last);
+    list_link_nodes(pos, first, last);
+}
+
 template<typename T>
 class list {
 public:
@@ -527,12 +552,12 @@ public:
     void merge(list& x, Compare cmp);
 
     void sort() {
-        list_sort(begin(), end(), size_, mstl::less<T>());
+        list_sort(mstl::less<T>());
     }
 
     template<typename Compare>
     void sort(Compare cmp) {
-        list_sort(begin(), end(), size_, cmp);
+        list_sort(cmp);
     }
 
     void reverse();
@@ -563,7 +588,9 @@ template <typename Iter>
 iterator copy_insert(const_iterator pos, size_type n, Iter first);
 
 template <typename Compared>
-iterator list_sort(iterator first, iterator last, size_type n, Compared comp);
+void list_sort(Compared comp);
+template <typename Compared>
+static base_ptr merge_chain(base_ptr first1, base_ptr first2, Compared& comp);
 
 };
 
@@ -847,35 +874,25 @@ list<T>::link_iter_node(const_iterator pos, base_ptr link_node) {
 // 在链表中间位置pos插入节点
 template<typename T>
 void list<T>::link_nodes(base_ptr pos, base_ptr first, base_ptr last) {
-    pos->prev->next = first;
-    first->prev = pos->prev;
-    pos->prev = last;
-    last->next = pos;
+    list_link_nodes(pos, first, last);
 }
 
 // 在链表头插入节点
 template<typename T>
 void list<T>::link_nodes_at_front(base_ptr first, base_ptr last) {
-    first->prev = node_;
-    last->next = node_->next;
-    last->next->prev = last;
-    node_->next = first;
+    list_link_nodes(node_->next, first, last);
 }
 
 // 在链表尾部插入节点
 template<typename T>
 void list<T>::link_nodes_at_back(base_ptr first, base_ptr last) {
-    last->next = node_;
-    first->prev = node_->prev;
-    first->prev->next = first;
-    node_->prev = last;
+    list_link_nodes(node_, first, last);
 }
 
 // 将[first, last)范围的节点剔除 
 template<typename T>
 void list<T>::unlink_nodes(base_ptr first, base_ptr last) {
-    first->prev->next = last->next;
-    last->next->prev = first->prev;
+    list_unlink_nodes(first, last);
 }
 
 // 将n个value赋值给当前list
@@ -980,71 +997,173 @@ list<T>::copy_insert(const_iterator pos, size_type n, Iter first) {
     return r;
 }
 
-// 对list进行归并排序，并返回最小的迭代器
+// 对list进行自底向上的归并排序，排序是稳定的
+// 排序期间把环形链表断开为以nullptr结尾的单链表，只修改next指针，
+// 在最后一次归并时再恢复prev指针，整个过程不申请内存，也不需要遍历寻找中点。
+// 每次从链表中取出一段自然有序的run（非递减，或严格递减后原地反转），
+// 像二进制计数器一样放入bins：bins[i]中保存由2^i个run归并得到的有序链，
+// 因此已经有序或逆序的输入只需要O(n)次比较。
+// comp抛出异常时list仍然完整：最后一次归并之前prev指针没有被修改，沿prev恢复原来的顺序；
+// 最后一次归并中则把尚未归并的两条链接在已经连好的部分之后
 template<typename T>
 template <typename Compared>
-typename list<T>::iterator
-list<T>::list_sort(iterator first, iterator last, size_type n, Compared comp) {
-    if (n < 2) {
-        return first;
+void list<T>::list_sort(Compared comp) {
+    if (size_ < 2) {
+        return;
     }
 
-    if (n == 2) {
-        if (comp(*--last, *first)) {
-            base_ptr cur = last.node_;
-            unlink_nodes(cur, cur);
-            link_nodes(first.node_, cur, cur);
-            return last;
-        }
-        return first;
+    // 快速路径：已经有序时直接返回
+    base_ptr cur = node_->next;
+    while (cur->next != node_ && !comp(cur->next->as_node()->value, cur->as_node()->value)) {
+        cur = cur->next;
+    }
+    if (cur->next == node_) {
+        return;
     }
 
-    size_type n1 = n / 2;
-    iterator last2 = first;
-    mstl::advance(last2, n1);
-    iterator result = first = list_sort(first, last2, n1, comp);
-    iterator first2 = last2 = list_sort(last2, last, n - n1, comp);
+    const size_type max_bins = 64;
+    base_ptr bins[max_bins] = {};
+    size_type fill = 0;
+    base_ptr result = nullptr;
+    size_type last = 0;
 
-    // 先判断归并的两部分头结点哪个大，首先处理头部
-    if (comp(*first2, *first)) {
-        iterator m = first2;
-        ++m;
-        while (m != last && comp(*m, *first)) {
-            ++m;
+    node_->prev->next = nullptr;
+    try {
+        cur = node_->next;
+        while (cur != nullptr) {
+            // 取出从cur开始的一段run
+            base_ptr run = cur;
+            base_ptr next = cur->next;
+            if (next != nullptr && comp(next->as_node()->value, cur->as_node()->value)) {
+                // 严格递减的run，边取边反转，严格递减保证反转后仍然稳定
+                run->next = nullptr;
+                while (next != nullptr && comp(next->as_node()->value, cur->as_node()->value)) {
+                    base_ptr after = next->next;
+                    cur = next;
+                    cur->next = run;
+                    run = cur;
+                    next = after;
+                }
+            } else {
+                while (next != nullptr && !comp(next->as_node()->value, cur->as_node()->value)) {
+                    cur = next;
+                    next = cur->next;
+                }
+                cur->next = nullptr;
+            }
+            cur = next;
+
+            // 与bins中较早的链依次归并，bins中的元素总是位于run之前
+            size_type i = 0;
+            for (; i < fill && bins[i] != nullptr; ++i) {
+                run = merge_chain(bins[i], run, comp);
+                bins[i] = nullptr;
+            }
+            if (i == max_bins) {
+                --i;
+            }
+            bins[i] = run;
+            if (i == fill) {
+                ++fill;
+            }
         }
-        base_ptr f = first2.node_;
-        base_ptr l = m.node_->prev;
-        result = first2;
-        first2 = last2 = m;
-        unlink_nodes(f, l);
-        link_nodes(first.node_, f, l);
-        ++first;
-    } else {
-        ++first;
+
+        // 从低位向高位归并剩余的链，高位的链中元素更靠前
+        last = fill - 1;
+        while (bins[last] == nullptr) {
+            --last;
+        }
+        for (size_type i = 0; i < last; ++i) {
+            if (bins[i] != nullptr) {
+                result = result == nullptr ? bins[i] : merge_chain(bins[i], result, comp);
+            }
+        }
+    } catch (...) {
+        base_ptr p = node_;
+        do {
+            p->prev->next = p;
+            p = p->prev;
+        } while (p != node_);
+        throw;
     }
 
-    // 然后将其余节点按照大小顺序merger起来即可
-    while (first != last2 && first2 != last) {
-        if (comp(*first2, *first)) {
-            iterator m = first2;
-            ++m;
-            while (m != last && comp(*m, *first)) {
-                ++m;
+    // 最后一次归并需要访问全部节点，顺便恢复prev指针以及与node_组成的环
+    base_ptr first1 = bins[last];
+    base_ptr tail = node_;
+    try {
+        while (first1 != nullptr && result != nullptr) {
+            if (comp(result->as_node()->value, first1->as_node()->value)) {
+                cur = result;
+                result = result->next;
+            } else {
+                cur = first1;
+                first1 = first1->next;
             }
-            base_ptr f = first2.node_;
-            base_ptr l = m.node_->prev;
-            if (last2 == first2) {
-                last2 = m;
+            tail->next = cur;
+            cur->prev = tail;
+            tail = cur;
+        }
+    } catch (...) {
+        for (cur = first1; cur != nullptr; cur = cur->next) {
+            tail->next = cur;
+            cur->prev = tail;
+            tail = cur;
+        }
+        for (cur = result; cur != nullptr; cur = cur->next) {
+            tail->next = cur;
+            cur->prev = tail;
+            tail = cur;
+        }
+        tail->next = node_;
+        node_->prev = tail;
+        throw;
+    }
+    for (cur = first1 != nullptr ? first1 : result; cur != nullptr; cur = cur->next) {
+        tail->next = cur;
+        cur->prev = tail;
+        tail = cur;
+    }
+    tail->next = node_;
+    node_->prev = tail;
+}
+
+// 归并两条以nullptr结尾的有序单链，first1中的元素位于first2之前，
+// 只有first2中的元素严格小于first1中的元素时才先取first2，从而保证稳定。
+// 连续从同一条链取出的节点之间的next本来就是正确的，只在切换链时才写next指针
+template<typename T>
+template <typename Compared>
+typename list<T>::base_ptr
+list<T>::merge_chain(base_ptr first1, base_ptr first2, Compared& comp) {
+    // tail来自first2时为true
+    bool from_second = comp(first2->as_node()->value, first1->as_node()->value);
+    base_ptr head;
+    if (from_second) {
+        head = first2;
+        first2 = first2->next;
+    } else {
+        head = first1;
+        first1 = first1->next;
+    }
+    base_ptr tail = head;
+    while (first1 != nullptr && first2 != nullptr) {
+        if (comp(first2->as_node()->value, first1->as_node()->value)) {
+            if (!from_second) {
+                tail->next = first2;
+                from_second = true;
             }
-            first2 = m;
-            unlink_nodes(f, l);
-            link_nodes(first.node_, f, l);
-            ++first;
+            tail = first2;
+            first2 = first2->next;
         } else {
-            ++first;
+            if (from_second) {
+                tail->next = first1;
+                from_second = false;
+            }
+            tail = first1;
+            first1 = first1->next;
         }
     }
-    return result;
+    tail->next = first1 != nullptr ? first1 : first2;
+    return head;
 }
 
 template<typename T>
@@ -1092,4 +1211,38 @@ void swap(list<T>& lhs, list<T>& rhs) noexcept {
 
 } // mstl
 
-#endif
\ No newline at end of file
+#endif
+
+// 简单的测试程序，需要在其他单独的cpp文件中运行
+// 比较函数在第150次比较时抛出异常，之后list仍然可以正常遍历，大小与元素都不变
+// struct throwing_less {
+//     int* calls;
+//     bool operator()(int a, int b) const {
+//         if (++*calls == 150) {
+//             throw std::runtime_error("compare failed");
+//         }
+//         return a < b;
+//     }
+// };
+
+// int main() {
+//     mstl::list<int> l;
+//     long sum = 0;
+//     for (int i = 0; i < 100; ++i) {
+//         l.push_back((i * 37) % 100);
+//         sum += (i * 37) % 100;
+//     }
+//     int calls = 0;
+//     try {
+//         l.sort(throwing_less{&calls});
+//     } catch (const std::runtime_error&) {
+//         std::cout << "caught\n";
+//     }
+//     size_t n = 0;
+//     for (auto it = l.begin(); it != l.end(); ++it) {
+//         ++n;
+//         sum -= *it;
+//     }
+//     assert(n == 100 && l.size() == 100 && sum == 0);
+//     return 0;
+// }
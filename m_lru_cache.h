@@ -0,0 +1,412 @@
+#ifndef M_LRU_CACHE_H_
+#define M_LRU_CACHE_H_
+
+// 按容量与权重淘汰的缓存 lru_cache
+// 元素保存在一个hashtable中，淘汰顺序用侵入式链表维护，链表的hook就放在hashtable节点的值里：
+// 每个元素只有一次内存申请，命中时查找到的节点同时就是链表中的节点，不需要再经过一次迭代器间接访问。
+// 淘汰顺序由策略决定 (见下方cache_lru_policy与cache_lfu_policy)，策略需要提供：
+//   struct meta                          每个元素额外保存的数据，缺省构造，作为元素的基类
+//   template<typename Slot> class impl   维护淘汰顺序的对象，是缓存的成员，提供以下接口：
+//     void link(Slot& s)      新元素 (或更新后重新加入的元素) 加入排序
+//     void touch(Slot& s)     元素被访问
+//     void unlink(Slot& s)    元素离开排序
+//     Slot* victim()          下一个被淘汰的元素，没有元素时返回nullptr
+//     void clear()            移除全部元素，不访问元素的内存
+//     void swap(impl& rhs)    交换两个对象
+// 缓存的容量上限为元素个数，权重上限为所有元素权重之和，put时超出任一上限就从victim开始淘汰，
+// 淘汰前调用淘汰回调，回调抛出异常时该元素保留在缓存中。
+// 用法：
+//   mstl::lru_cache<int, string> cache(1024);
+//   cache.put(1, "a");
+//   if (string* p = cache.get(1)) { ... }
+
+#include <cstdint>
+#include <functional>
+
+#include "m_hashtable.h"
+#include "m_intrusive_list.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+// 缓存中的一个元素，作为hashtable中pair的second，hook与权重都和值保存在同一个节点中
+template<typename T, typename Meta>
+struct cache_slot : public Meta {
+    typedef intrusive_list_hook<normal_link> hook_type;
+
+    hook_type hook;
+    size_t    weight;
+    T         value;
+
+    template<typename V>
+    cache_slot(V&& v, size_t w) : Meta(), hook(), weight(w), value(mstl::forward<V>(v)) {}
+};
+
+// 最近最少使用，一条链表，访问过的元素移到表头，从表尾淘汰
+struct cache_lru_policy {
+    struct meta {};
+
+    template<typename Slot>
+    class impl {
+    private:
+        typedef typename Slot::hook_type                       hook_type;
+        typedef intrusive_list<Slot, hook_type, &Slot::hook>   list_type;
+
+        list_type list_;
+
+    public:
+        void link(Slot& s) {
+            list_.push_front(s);
+        }
+
+        void touch(Slot& s) {
+            list_.splice(list_.begin(), list_, list_type::iterator_to(s));
+        }
+
+        void unlink(Slot& s) {
+            list_.erase(s);
+        }
+
+        Slot* victim() {
+            return list_.empty() ? nullptr : &list_.back();
+        }
+
+        void clear() {
+            list_.clear();
+        }
+
+        void swap(impl& rhs) noexcept {
+            list_.swap(rhs.list_);
+        }
+    };
+};
+
+// 最不经常使用，访问次数按2的幂分为16级，每一级是一条按最近使用排序的链表，
+// 次数达到2的幂时移到上一级，从最低的非空级的表尾淘汰，同一级内退化为lru。
+// 次数在65535处饱和，不会随时间衰减
+struct cache_lfu_policy {
+    struct meta {
+        uint16_t count;
+        uint16_t level;
+
+        meta() : count(0), level(0) {}
+    };
+
+    template<typename Slot>
+    class impl {
+    private:
+        typedef typename Slot::hook_type                       hook_type;
+        typedef intrusive_list<Slot, hook_type, &Slot::hook>   list_type;
+
+        static constexpr size_t level_count = 16;
+
+        list_type levels_[level_count];
+
+    public:
+        // 重新加入的元素保留原来的次数，与新元素一样记一次访问
+        void link(Slot& s) {
+            count_access(s);
+            levels_[s.level].push_front(s);
+        }
+
+        void touch(Slot& s) {
+            list_type& from = levels_[s.level];
+            count_access(s);
+            list_type& to = levels_[s.level];
+            to.splice(to.begin(), from, list_type::iterator_to(s));
+        }
+
+        void unlink(Slot& s) {
+            levels_[s.level].erase(s);
+        }
+
+        Slot* victim() {
+            for (size_t i = 0; i < level_count; ++i) {
+                if (!levels_[i].empty()) {
+                    return &levels_[i].back();
+                }
+            }
+            return nullptr;
+        }
+
+        void clear() {
+            for (size_t i = 0; i < level_count; ++i) {
+                levels_[i].clear();
+            }
+        }
+
+        void swap(impl& rhs) noexcept {
+            for (size_t i = 0; i < level_count; ++i) {
+                levels_[i].swap(rhs.levels_[i]);
+            }
+        }
+
+    private:
+        // 次数每次加一，恰好变为2的幂时级别加一，第一次访问后次数为1，级别为0
+        static void count_access(Slot& s) {
+            if (s.count == 0xffff) {
+                return;
+            }
+            ++s.count;
+            if (s.count > 1 && (s.count & (s.count - 1)) == 0) {
+                ++s.level;
+            }
+        }
+    };
+};
+
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，第四参数为键比较大小的函数类型，
+// 第五参数为淘汰策略
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename Policy = cache_lru_policy>
+class lru_cache {
+private:
+    typedef cache_slot<T, typename Policy::meta>                   slot_type;
+    typedef typename Policy::template impl<slot_type>              policy_type;
+    typedef mstl::hashtable<mstl::pair<const Key, slot_type>, Hash, KeyEqual> table_type;
+
+public:
+    typedef Key                                                    key_type;
+    typedef T                                                      mapped_type;
+    typedef typename table_type::value_type                        entry_type;
+    typedef typename table_type::hasher                            hasher;
+    typedef typename table_type::key_equal                         key_equal;
+    typedef typename table_type::size_type                         size_type;
+    // 淘汰回调，参数为被淘汰元素的键与值，值在回调返回后销毁，可以从中移出
+    typedef std::function<void(const key_type&, mapped_type&)>     evict_callback;
+
+private:
+    table_type     table_;
+    policy_type    policy_;
+    size_type      capacity_;
+    size_type      max_weight_;
+    size_type      weight_;
+    evict_callback on_evict_;
+
+public:
+    // capacity为元素个数的上限，max_weight为权重之和的上限，缺省不限制权重
+    explicit lru_cache(size_type capacity, size_type max_weight = static_cast<size_type>(-1),
+                       const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+        : table_(mstl::min(capacity, static_cast<size_type>(1024)), hash, equal),
+          policy_(), capacity_(capacity), max_weight_(max_weight), weight_(0), on_evict_() {
+        THROW_LENGTH_ERROR_IF(capacity == 0, "lru_cache capacity can not be zero");
+    }
+
+    lru_cache(const lru_cache&) = delete;
+    lru_cache& operator=(const lru_cache&) = delete;
+
+    // hashtable移动时节点不变，链表由策略对象交换得到
+    lru_cache(lru_cache&& rhs) noexcept
+        : table_(mstl::move(rhs.table_)), policy_(), capacity_(rhs.capacity_),
+          max_weight_(rhs.max_weight_), weight_(rhs.weight_), on_evict_(mstl::move(rhs.on_evict_)) {
+        policy_.swap(rhs.policy_);
+        rhs.weight_ = 0;
+    }
+
+    lru_cache& operator=(lru_cache&& rhs) noexcept {
+        if (this != &rhs) {
+            clear();
+            swap(rhs);
+        }
+        return *this;
+    }
+
+    // 链表节点位于hashtable的节点中，要先于hashtable解除链接
+    ~lru_cache() {
+        policy_.clear();
+    }
+
+    // 容量相关
+    bool empty() const noexcept {
+        return table_.empty();
+    }
+
+    size_type size() const noexcept {
+        return table_.size();
+    }
+
+    size_type capacity() const noexcept {
+        return capacity_;
+    }
+
+    size_type max_weight() const noexcept {
+        return max_weight_;
+    }
+
+    size_type weight() const noexcept {
+        return weight_;
+    }
+
+    // 修改上限，超出部分立即淘汰
+    void set_capacity(size_type capacity) {
+        THROW_LENGTH_ERROR_IF(capacity == 0, "lru_cache capacity can not be zero");
+        capacity_ = capacity;
+        shrink_to(capacity_, max_weight_);
+    }
+
+    void set_max_weight(size_type max_weight) {
+        max_weight_ = max_weight;
+        shrink_to(capacity_, max_weight_);
+    }
+
+    void set_evict_callback(evict_callback fn) {
+        on_evict_ = mstl::move(fn);
+    }
+
+    // 查找key并记一次访问，不存在时返回nullptr，指针在该元素被淘汰或删除前有效
+    mapped_type* get(const key_type& key) {
+        auto iter = table_.find(key);
+        if (iter == table_.end()) {
+            return nullptr;
+        }
+        slot_type& s = iter->second;
+        policy_.touch(s);
+        return &s.value;
+    }
+
+    // 只查找，不影响淘汰顺序
+    const mapped_type* peek(const key_type& key) const {
+        auto iter = table_.find(key);
+        return iter == table_.end() ? nullptr : &iter->second.value;
+    }
+
+    bool contains(const key_type& key) const {
+        return table_.contains(key);
+    }
+
+    // 插入或覆盖key对应的值，先按上限淘汰其他元素再放入。
+    // 单个元素的权重就超过上限时不放入，已有的同key元素也一并删除，返回false
+    template<typename V>
+    bool put(const key_type& key, V&& value, size_type weight = 1);
+
+    size_type erase(const key_type& key);
+
+    void clear() {
+        policy_.clear();
+        table_.clear();
+        weight_ = 0;
+    }
+
+    void reserve(size_type count) {
+        table_.reserve(count);
+    }
+
+    void swap(lru_cache& rhs) noexcept {
+        table_.swap(rhs.table_);
+        policy_.swap(rhs.policy_);
+        mstl::swap(capacity_, rhs.capacity_);
+        mstl::swap(max_weight_, rhs.max_weight_);
+        mstl::swap(weight_, rhs.weight_);
+        on_evict_.swap(rhs.on_evict_);
+    }
+
+    hasher hash_func() const {
+        return table_.hash_func();
+    }
+
+    key_equal key_eq() const {
+        return table_.key_eq();
+    }
+
+private:
+    // 由slot得到所在的pair
+    static entry_type& entry_of(slot_type& s) noexcept {
+        return *member_offset<entry_type, slot_type, &entry_type::second>::container_of(&s);
+    }
+
+    void evict_one();
+    void shrink_to(size_type count, size_type weight);
+};
+
+/**************************************************************************************/
+// 成员函数的定义
+
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Policy>
+template<typename V>
+bool lru_cache<Key, T, Hash, KeyEqual, Policy>::put(const key_type& key, V&& value, size_type weight) {
+    if (weight > max_weight_) {
+        erase(key);
+        return false;
+    }
+    // 只查找一次：键值不存在时直接插入新元素，新元素还没有链接到淘汰策略中，
+    // 之后的淘汰不会选中它，淘汰失败时再把它删除
+    auto res = table_.try_emplace_unique(key, mstl::forward<V>(value), weight);
+    slot_type& s = res.first->second;
+    if (res.second) {
+        try {
+            shrink_to(capacity_, max_weight_ - weight);
+        } catch (...) {
+            table_.erase(res.first);
+            throw;
+        }
+        weight_ += weight;
+        policy_.link(s);
+        return true;
+    }
+    // 先把自己移出排序，淘汰时就不会选中自己，个数不变，只需满足权重上限
+    policy_.unlink(s);
+    weight_ -= s.weight;
+    try {
+        shrink_to(capacity_, max_weight_ - weight);
+        s.value = mstl::forward<V>(value);
+    } catch (...) {
+        weight_ += s.weight;
+        policy_.link(s);
+        throw;
+    }
+    s.weight = weight;
+    weight_ += weight;
+    policy_.link(s);
+    return true;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Policy>
+typename lru_cache<Key, T, Hash, KeyEqual, Policy>::size_type
+lru_cache<Key, T, Hash, KeyEqual, Policy>::erase(const key_type& key) {
+    auto iter = table_.find(key);
+    if (iter == table_.end()) {
+        return 0;
+    }
+    policy_.unlink(iter->second);
+    weight_ -= iter->second.weight;
+    table_.erase(iter);
+    return 1;
+}
+
+// 淘汰victim，回调抛出异常时元素保持原样
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Policy>
+void lru_cache<Key, T, Hash, KeyEqual, Policy>::evict_one() {
+    slot_type* s = policy_.victim();
+    MSTL_DEBUG(s != nullptr);
+    entry_type& entry = entry_of(*s);
+    if (on_evict_) {
+        on_evict_(entry.first, s->value);
+    }
+    policy_.unlink(*s);
+    weight_ -= s->weight;
+    // 节点已知，按迭代器删除，不再计算哈希值查找键
+    table_.erase(table_.iterator_to(entry));
+}
+
+// 淘汰直到元素个数不超过count且权重之和不超过weight
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Policy>
+void lru_cache<Key, T, Hash, KeyEqual, Policy>::shrink_to(size_type count, size_type weight) {
+    while ((table_.size() > count || weight_ > weight) && policy_.victim() != nullptr) {
+        evict_one();
+    }
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Policy>
+void swap(lru_cache<Key, T, Hash, KeyEqual, Policy>& lhs,
+          lru_cache<Key, T, Hash, KeyEqual, Policy>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+// 按访问次数淘汰的缓存
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+using lfu_cache = lru_cache<Key, T, Hash, KeyEqual, cache_lfu_policy>;
+
+} // mstl
+
+#endif
@@ -6,6 +6,8 @@
 #include <cstdlib>
 #include <cstddef>
 #include <climits>
+#include <cstdint>
+#include <new>
 
 #include "m_algobase.h"
 #include "m_construct.h"
@@ -179,8 +181,52 @@ public:
     }
 };
 
+// 缓存行大小，用于分隔被不同线程频繁写入的变量，避免伪共享
+#ifndef MSTL_CACHE_LINE_SIZE
+#define MSTL_CACHE_LINE_SIZE 64
+#endif
 
+// 按缓存行对齐申请对象的分配器，其余接口与allocator相同
+// C++17之前operator new只保证alignof(max_align_t)的对齐，alignas(MSTL_CACHE_LINE_SIZE)的类型
+// 需要由它申请：多申请一个缓存行与一个指针，手动对齐后把原地址保存在返回地址之前
+template<typename T>
+class cache_aligned_allocator : public mstl::allocator<T> {
+public:
+    typedef T*          pointer;
+    typedef size_t      size_type;
+
+    static pointer allocate() {
+        return allocate(1);
+    }
 
+    static pointer allocate(size_type n) {
+        if (n == 0) {
+            return nullptr;
+        }
+        const size_type align = alignment();
+        char* raw = static_cast<char*>(::operator new(n * sizeof(T) + align + sizeof(void*)));
+        const uintptr_t p = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+        char* aligned = reinterpret_cast<char*>((p + align - 1) & ~static_cast<uintptr_t>(align - 1));
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<pointer>(aligned);
+    }
+
+    static void deallocate(pointer ptr) {
+        deallocate(ptr, 1);
+    }
+
+    static void deallocate(pointer ptr, size_type) {
+        if (ptr == nullptr) {
+            return;
+        }
+        ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+    }
+
+private:
+    static constexpr size_type alignment() noexcept {
+        return alignof(T) > MSTL_CACHE_LINE_SIZE ? alignof(T) : MSTL_CACHE_LINE_SIZE;
+    }
+};
 
 } //mstl
 
@@ -0,0 +1,508 @@
+#ifndef M_MPMC_QUEUE_H_
+#define M_MPMC_QUEUE_H_
+
+// 有界的多生产者多消费者无锁队列 mpmc_queue
+// 采用 Vyukov 的序号环形缓冲区实现：每个槽位带有一个序号 seq，
+// 生产者与消费者各自通过 CAS 争夺 enqueue_pos_ / dequeue_pos_，
+// 再根据槽位序号判断该槽位是否可写/可读，全程无锁。
+// 阻塞版本的 push/pop 先自旋一段时间，失败后在 linux 下使用 futex 休眠
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <climits>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "m_memory.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+// 阻塞操作在休眠之前的自旋次数
+#ifndef MPMC_SPIN_COUNT
+#define MPMC_SPIN_COUNT 128
+#endif
+
+// 在 addr 的值仍为 expected 时休眠，直到被 mpmc_futex_wake 唤醒
+// 非 linux 平台退化为让出时间片，由调用者循环重试
+inline void mpmc_futex_wait(std::atomic<uint32_t>* addr, uint32_t expected) {
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex requires a lock free 32 bit atomic");
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE,
+            expected, nullptr, nullptr, 0);
+#else
+    if (addr->load(std::memory_order_acquire) == expected) {
+        std::this_thread::yield();
+    }
+#endif
+}
+
+// 唤醒至多 count 个在 addr 上休眠的线程，缺省唤醒全部
+inline void mpmc_futex_wake(std::atomic<uint32_t>* addr, int count = INT_MAX) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE,
+            count, nullptr, nullptr, 0);
+#else
+    (void)addr;
+    (void)count;
+#endif
+}
+
+// 事件计数器，阻塞操作在失败后等待对端完成一次操作
+// 等待方先登记自己再重试，通知方在发布数据后检查是否有登记的等待者，
+// 两侧的 seq_cst 屏障保证要么通知方看到登记并增加 epoch，要么等待方的重试看到新数据。
+// 通知方的屏障在 epoch 自增之前，等待方以 acquire 读取 epoch，读到新值时重试也一定能看到对应的数据，
+// 不会带着新的 epoch 与旧的数据去休眠；
+// 没有等待者时通知只需一次屏障和一次读取，不会在共享变量上产生写竞争
+struct mpmc_event {
+    std::atomic<uint32_t> epoch;
+    std::atomic<uint32_t> waiters;
+
+    mpmc_event() : epoch(0), waiters(0) {}
+
+    // 登记为等待者，返回当前的事件序号，之后必须调用 retire
+    uint32_t prepare() noexcept {
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    void retire() noexcept {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // 等待 epoch 从 key 发生变化
+    void wait(uint32_t key) {
+        mpmc_futex_wait(&epoch, key);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            epoch.fetch_add(1, std::memory_order_relaxed);
+            mpmc_futex_wake(&epoch);
+        }
+    }
+
+    // 只唤醒一个休眠者，用于只有一份新工作的情况。
+    // epoch 仍然自增，尚未进入休眠的等待者会看到新的 epoch 而立即返回，不会错过这次通知
+    void notify_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            epoch.fetch_add(1, std::memory_order_relaxed);
+            mpmc_futex_wake(&epoch, 1);
+        }
+    }
+};
+
+template<typename T>
+class mpmc_queue {
+public:
+    typedef T           value_type;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef size_t      size_type;
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "the value_type of mpmc_queue should be nothrow move constructible");
+
+private:
+    // 每个槽位保存一个序号以及未初始化的元素空间
+    // seq == pos 表示第 pos 次入队可以写入该槽位
+    // seq == pos + 1 表示第 pos 次入队已经完成，可以被出队
+    struct cell {
+        std::atomic<size_type> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T* value_ptr() noexcept {
+            return reinterpret_cast<T*>(&storage);
+        }
+    };
+
+    typedef mstl::allocator<cell> cell_allocator;
+
+    // 只读的成员放在一起，与两个游标分别位于不同的缓存行
+    alignas(MSTL_CACHE_LINE_SIZE) cell*      buffer_;
+    size_type                                mask_;
+    alignas(MSTL_CACHE_LINE_SIZE) std::atomic<size_type> enqueue_pos_;
+    alignas(MSTL_CACHE_LINE_SIZE) std::atomic<size_type> dequeue_pos_;
+    // 阻塞操作使用：push_event_ 在每次入队后通知，pop_event_ 在每次出队后通知
+    alignas(MSTL_CACHE_LINE_SIZE) mpmc_event push_event_;
+    alignas(MSTL_CACHE_LINE_SIZE) mpmc_event pop_event_;
+
+public:
+    // 容量会被向上取整为 2 的幂次，以便使用位与代替取模
+    explicit mpmc_queue(size_type capacity) : enqueue_pos_(0), dequeue_pos_(0) {
+        THROW_LENGTH_ERROR_IF(capacity == 0 || capacity > (max_size() >> 1),
+                              "mpmc_queue<T> capacity is invalid");
+        size_type n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        buffer_ = cell_allocator::allocate(n);
+        mask_ = n - 1;
+        for (size_type i = 0; i < n; ++i) {
+            new (&buffer_[i].seq) std::atomic<size_type>(i);
+        }
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    ~mpmc_queue() {
+        // 析构时不再有并发访问，直接销毁 [dequeue_pos_, enqueue_pos_) 中的元素
+        const size_type tail = enqueue_pos_.load(std::memory_order_relaxed);
+        for (size_type pos = dequeue_pos_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+            mstl::destory(buffer_[pos & mask_].value_ptr());
+        }
+        cell_allocator::deallocate(buffer_, mask_ + 1);
+    }
+
+    size_type capacity() const noexcept {
+        return mask_ + 1;
+    }
+
+    size_type max_size() const noexcept {
+        return static_cast<size_type>(-1) / sizeof(cell);
+    }
+
+    // 并发情况下的结果仅供参考
+    size_type size_approx() const noexcept {
+        const size_type head = dequeue_pos_.load(std::memory_order_relaxed);
+        const size_type tail = enqueue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty_approx() const noexcept {
+        return size_approx() == 0;
+    }
+
+    bool full_approx() const noexcept {
+        return size_approx() > mask_;
+    }
+
+    // 非阻塞操作，队列满/空时立即返回 false
+    template<typename... Args>
+    bool try_emplace(Args&&... args) {
+        return emplace_dispatch(std::is_nothrow_constructible<T, Args&&...>(),
+                                mstl::forward<Args>(args)...);
+    }
+
+    bool try_push(const value_type& value) {
+        return try_emplace(value);
+    }
+
+    bool try_push(value_type&& value) {
+        return try_emplace(mstl::move(value));
+    }
+
+    bool try_pop(value_type& value);
+
+    // 批量操作，一次 CAS 占据多个连续槽位，返回实际处理的元素个数
+    template<typename ForwardIter>
+    size_type try_push_batch(ForwardIter first, size_type n);
+
+    // 写入 out 时抛出异常：之前的 i 个元素已经交给 out，第 i 个及其后已占据的元素被析构丢弃，
+    // 无法放回队列 (dequeue_pos_ 已越过这些槽位)，调用者也无法得知 i，需要不丢元素时应保证写入不抛出
+    template<typename OutputIter>
+    size_type try_pop_batch(OutputIter out, size_type max_count);
+
+    // 阻塞操作，先自旋 MPMC_SPIN_COUNT 次，之后休眠直到对端完成一次操作
+    void push(const value_type& value) {
+        blocking_push(value_type(value));
+    }
+
+    void push(value_type&& value) {
+        blocking_push(mstl::move(value));
+    }
+
+    void pop(value_type& value);
+
+    template<typename ForwardIter>
+    void push_batch(ForwardIter first, size_type n);
+
+    template<typename OutputIter>
+    size_type pop_batch(OutputIter out, size_type max_count);
+
+private:
+    bool claim_push(size_type& pos);
+    bool claim_pop(size_type& pos);
+
+    template<typename... Args>
+    bool emplace_dispatch(std::true_type, Args&&... args);
+    template<typename... Args>
+    bool emplace_dispatch(std::false_type, Args&&... args);
+
+    template<typename Ty>
+    void release_pop(size_type pos, Ty& value);
+
+    template<typename Op>
+    void wait_until(mpmc_event& ev, Op op);
+
+    void blocking_push(value_type&& value);
+};
+
+// 占据一个可写的槽位，队列已满时返回 false
+template<typename T>
+bool mpmc_queue<T>::claim_push(size_type& pos) {
+    pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        const size_type seq = buffer_[pos & mask_].seq.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            // 槽位空闲，尝试占据
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        } else if (diff < 0) {
+            // 槽位中的元素尚未被取走，队列已满
+            return false;
+        } else {
+            // 其他生产者抢先一步，重新读取位置
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// 占据一个可读的槽位，队列为空时返回 false
+template<typename T>
+bool mpmc_queue<T>::claim_pop(size_type& pos) {
+    pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        const size_type seq = buffer_[pos & mask_].seq.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        } else if (diff < 0) {
+            // 生产者尚未写入，队列为空
+            return false;
+        } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// 已占据的槽位无法归还，因此只有不抛出异常的构造才能直接在槽位上进行，
+// 否则先在槽位之外构造好元素，再以不抛出异常的移动构造放入槽位
+template<typename T>
+template<typename... Args>
+bool mpmc_queue<T>::emplace_dispatch(std::true_type, Args&&... args) {
+    size_type pos;
+    if (!claim_push(pos)) {
+        return false;
+    }
+    cell* c = &buffer_[pos & mask_];
+    mstl::construct(c->value_ptr(), mstl::forward<Args>(args)...);
+    c->seq.store(pos + 1, std::memory_order_release);
+    push_event_.notify();
+    return true;
+}
+
+template<typename T>
+template<typename... Args>
+bool mpmc_queue<T>::emplace_dispatch(std::false_type, Args&&... args) {
+    if (full_approx()) {
+        return false;
+    }
+    T temp(mstl::forward<Args>(args)...);
+    return emplace_dispatch(std::true_type(), mstl::move(temp));
+}
+
+template<typename T>
+bool mpmc_queue<T>::try_pop(value_type& value) {
+    size_type pos;
+    if (!claim_pop(pos)) {
+        return false;
+    }
+    release_pop(pos, value);
+    pop_event_.notify();
+    return true;
+}
+
+// 取出 pos 处的元素，并把槽位留给下一轮的第 pos + capacity 次入队
+template<typename T>
+template<typename Ty>
+void mpmc_queue<T>::release_pop(size_type pos, Ty& value) {
+    cell* c = &buffer_[pos & mask_];
+    try {
+        value = mstl::move(*c->value_ptr());
+    } catch (...) {
+        mstl::destory(c->value_ptr());
+        c->seq.store(pos + mask_ + 1, std::memory_order_release);
+        throw;
+    }
+    mstl::destory(c->value_ptr());
+    c->seq.store(pos + mask_ + 1, std::memory_order_release);
+}
+
+// 统计从 pos 开始连续可写的槽位个数，这些槽位在占据 enqueue_pos_ 之前不会被他人写入，
+// 因此一次 CAS 即可占据全部槽位
+template<typename T>
+template<typename ForwardIter>
+typename mpmc_queue<T>::size_type
+mpmc_queue<T>::try_push_batch(ForwardIter first, size_type n) {
+    typedef std::is_nothrow_constructible<T, decltype(*first)> nothrow;
+    if (!nothrow::value) {
+        size_type count = 0;
+        for (; count < n && try_push(*first); ++count, ++first) {}
+        return count;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    size_type pos = enqueue_pos_.load(std::memory_order_relaxed);
+    size_type count;
+    for (;;) {
+        count = 0;
+        while (count < n && count <= mask_ &&
+               buffer_[(pos + count) & mask_].seq.load(std::memory_order_acquire) == pos + count) {
+            ++count;
+        }
+        if (count == 0) {
+            const size_type seq = buffer_[pos & mask_].seq.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0) {
+                return 0;
+            }
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    for (size_type i = 0; i < count; ++i, ++first) {
+        cell* c = &buffer_[(pos + i) & mask_];
+        mstl::construct(c->value_ptr(), *first);
+        c->seq.store(pos + i + 1, std::memory_order_release);
+    }
+    push_event_.notify();
+    return count;
+}
+
+template<typename T>
+template<typename OutputIter>
+typename mpmc_queue<T>::size_type
+mpmc_queue<T>::try_pop_batch(OutputIter out, size_type max_count) {
+    if (max_count == 0) {
+        return 0;
+    }
+    size_type pos = dequeue_pos_.load(std::memory_order_relaxed);
+    size_type count;
+    for (;;) {
+        count = 0;
+        while (count < max_count && count <= mask_ &&
+               buffer_[(pos + count) & mask_].seq.load(std::memory_order_acquire) == pos + count + 1) {
+            ++count;
+        }
+        if (count == 0) {
+            const size_type seq = buffer_[pos & mask_].seq.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+                return 0;
+            }
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    size_type i = 0;
+    try {
+        for (; i < count; ++i, ++out) {
+            release_pop(pos + i, *out);
+        }
+    } catch (...) {
+        // 已占据的槽位必须全部归还，否则生产者将永远等待，其中剩余的元素随之丢失
+        for (++i; i < count; ++i) {
+            cell* c = &buffer_[(pos + i) & mask_];
+            mstl::destory(c->value_ptr());
+            c->seq.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        pop_event_.notify();
+        throw;
+    }
+    pop_event_.notify();
+    return count;
+}
+
+// 先自旋重试 op，之后登记为 ev 的等待者并休眠，直到 op 成功
+template<typename T>
+template<typename Op>
+void mpmc_queue<T>::wait_until(mpmc_event& ev, Op op) {
+    for (int spin = 0; spin < MPMC_SPIN_COUNT; ++spin) {
+        if (op()) {
+            return;
+        }
+    }
+    for (;;) {
+        // 先登记并取得事件序号再重试，避免在重试与休眠之间错过唤醒
+        const uint32_t key = ev.prepare();
+        bool done;
+        try {
+            done = op();
+        } catch (...) {
+            ev.retire();
+            throw;
+        }
+        if (!done) {
+            ev.wait(key);
+        }
+        ev.retire();
+        if (done) {
+            return;
+        }
+    }
+}
+
+template<typename T>
+void mpmc_queue<T>::blocking_push(value_type&& value) {
+    wait_until(pop_event_, [&]() {
+        return try_push(mstl::move(value));
+    });
+}
+
+template<typename T>
+void mpmc_queue<T>::pop(value_type& value) {
+    wait_until(push_event_, [&]() {
+        return try_pop(value);
+    });
+}
+
+template<typename T>
+template<typename ForwardIter>
+void mpmc_queue<T>::push_batch(ForwardIter first, size_type n) {
+    wait_until(pop_event_, [&]() {
+        const size_type count = try_push_batch(first, n);
+        mstl::advance(first, count);
+        n -= count;
+        return n == 0;
+    });
+}
+
+// 阻塞直到至少取得一个元素
+template<typename T>
+template<typename OutputIter>
+typename mpmc_queue<T>::size_type
+mpmc_queue<T>::pop_batch(OutputIter out, size_type max_count) {
+    size_type count = 0;
+    if (max_count != 0) {
+        wait_until(push_event_, [&]() {
+            count = try_pop_batch(out, max_count);
+            return count != 0;
+        });
+    }
+    return count;
+}
+
+} // mstl
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef M_NODE_HANDLE_H_
+#define M_NODE_HANDLE_H_
+
+// 节点句柄 node_handle
+// 由hashtable与rb_tree的extract得到，独占一个已经从容器中摘下的节点，再由insert链接到同类容器中，
+// 整个过程不申请内存也不复制元素。句柄只能移动，析构时若仍持有节点则销毁元素并释放节点。
+// 节点的内存必须来自mstl::allocator<Node>，hashtable只有在节点策略的transferable为true时才提供句柄
+
+#include "m_util.h"
+#include "m_allocator.h"
+#include "m_memory.h"
+#include "m_type_traits.h"
+#include "m_exceptdef.h"
+
+namespace mstl {
+
+template<typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+class hashtable;
+
+template<typename T, typename Compare>
+class rb_tree;
+
+// 第一参数为元素类型，第二参数为节点类型
+template<typename T, typename Node>
+class node_handle {
+    template<typename, typename, typename, typename, typename>
+    friend class hashtable;
+    template<typename, typename>
+    friend class rb_tree;
+
+public:
+    typedef T    value_type;
+    typedef Node node_type;
+
+private:
+    node_type* node_;
+
+public:
+    node_handle() noexcept : node_(nullptr) {}
+
+    node_handle(const node_handle&) = delete;
+    node_handle& operator=(const node_handle&) = delete;
+
+    node_handle(node_handle&& rhs) noexcept : node_(rhs.node_) {
+        rhs.node_ = nullptr;
+    }
+
+    node_handle& operator=(node_handle&& rhs) noexcept {
+        if (this != &rhs) {
+            reset();
+            node_ = rhs.node_;
+            rhs.node_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~node_handle() {
+        reset();
+    }
+
+    bool empty() const noexcept {
+        return node_ == nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return node_ != nullptr;
+    }
+
+    // set使用，元素作为键不能修改
+    const value_type& value() const {
+        MSTL_DEBUG(node_ != nullptr);
+        return node_->value;
+    }
+
+    // map使用
+    template<typename U = T, typename mstl::enable_if<mstl::is_pair<U>::value, int>::type = 0>
+    const typename U::first_type& key() const {
+        MSTL_DEBUG(node_ != nullptr);
+        return node_->value.first;
+    }
+
+    template<typename U = T, typename mstl::enable_if<mstl::is_pair<U>::value, int>::type = 0>
+    typename U::second_type& mapped() const {
+        MSTL_DEBUG(node_ != nullptr);
+        return node_->value.second;
+    }
+
+    void swap(node_handle& rhs) noexcept {
+        mstl::swap(node_, rhs.node_);
+    }
+
+private:
+    explicit node_handle(node_type* node) noexcept : node_(node) {}
+
+    // 交出节点，由容器重新链接
+    node_type* release() noexcept {
+        node_type* node = node_;
+        node_ = nullptr;
+        return node;
+    }
+
+    void reset() noexcept {
+        if (node_ != nullptr) {
+            mstl::allocator<T>::destory(mstl::address_of(node_->value));
+            mstl::allocator<node_type>::deallocate(node_);
+            node_ = nullptr;
+        }
+    }
+};
+
+template<typename T, typename Node>
+void swap(node_handle<T, Node>& lhs, node_handle<T, Node>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+// 不可重复容器的insert(node_handle&&)的返回值，插入失败时节点留在node中
+template<typename Iter, typename NodeHandle>
+struct node_insert_return {
+    Iter       position;
+    bool       inserted;
+    NodeHandle node;
+};
+
+} // mstl
+
+#endif
@@ -8,6 +8,7 @@
 #include "m_memory.h"
 #include "m_iterator.h"
 #include "m_type_traits.h"
+#include "m_node_handle.h"
 
 
 /* 红黑树的节点性质与要求
@@ -624,7 +625,7 @@ NodePtr rb_tree_erase_rebalance(NodePtr z, NodePtr& root, NodePtr& leftmost, Nod
     */
     if (!rb_tree_is_red(y)) {
         // 先判断x是否为红色，如果为红，直接将x变为黑色红黑树就可以平衡
-        while (x != root && !rb_tree_is_red(x)) {
+        while (x != root && (x == nullptr || !rb_tree_is_red(x))) {
             // 待删除节点为左子节点
             if (x == x_parent->left) {
                 NodePtr brother = x_parent->right;
@@ -711,6 +712,10 @@ NodePtr rb_tree_erase_rebalance(NodePtr z, NodePtr& root, NodePtr& leftmost, Nod
 }
 
 // rb_tree的模板类
+// 比较函数声明了is_transparent才能进行异构查找，K只用于让条件依赖于成员函数的模板参数
+template<typename Compare, typename K>
+struct rb_tree_is_transparent : public m_bool_constant<mstl::is_transparent<Compare>::value> {};
+
 template<typename T, typename Compare>
 class rb_tree {
 public:
@@ -743,6 +748,9 @@ public:
     typedef mstl::reverse_iterator<iterator>         reverse_iterator;
     typedef mstl::reverse_iterator<const_iterator>   const_reverse_iterator;
 
+    typedef mstl::node_handle<T, node_type>                  node_handle;
+    typedef mstl::node_insert_return<iterator, node_handle>  insert_return_type;
+
     allocator_type get_allocator() const {
         return node_allocator();
     }
@@ -781,6 +789,7 @@ public:
 
     ~rb_tree() {
         clear();
+        base_allocator::deallocate(header_);
     }
 public:
     iterator begin() noexcept {
@@ -883,9 +892,17 @@ public:
 
     mstl::pair<iterator, bool> insert_unique(const value_type& value);
 
-    mstl::pair<iterator, bool> insert_unique(value_type&& value) {
-        return emplace_unique(mstl::move(value));
-    }
+    // 先查找插入位置，键值已经存在时不创建节点，value也不会被移动
+    mstl::pair<iterator, bool> insert_unique(value_type&& value);
+
+    // 键值不存在时才用key与args...在节点内原地构造元素，已经存在时不申请节点，参数也不会被移动。
+    // key的类型应为key_type，只用于map
+    template<typename K, typename ...Args>
+    mstl::pair<iterator, bool> try_emplace_unique(K&& key, Args&& ...args);
+
+    // 键值存在时把obj赋值给已有元素的值，否则插入，返回的bool表示是否为新插入
+    template<typename K, typename M>
+    mstl::pair<iterator, bool> insert_or_assign_unique(K&& key, M&& obj);
 
     iterator insert_unique(iterator hint, const value_type& value) {
         return emplace_unique_use_hint(hint, value);
@@ -912,37 +929,140 @@ public:
 
     void erase(iterator first, iterator last);
 
+    // 节点句柄，摘下与链接节点都不申请内存也不复制元素
+    // extract(key)摘下第一个键值与key相等的节点，不存在时返回空句柄
+    node_handle extract(iterator pos);
+    node_handle extract(const key_type& key);
+
+    // 键值已经存在时不插入，节点留在返回值的node中
+    insert_return_type insert_unique(node_handle&& nh);
+    iterator insert_multi(node_handle&& nh);
+
+    // 把other的节点逐个移到本树，不可重复版本中键值已经存在的节点留在other中
+    void merge_unique(rb_tree& other);
+    void merge_multi(rb_tree& other);
+
     void clear();
 
     // 查找相关方法
-    iterator find(const key_type& key);
+    // 比较函数声明了is_transparent时，以下方法另有接受任意类型K的模板版本，
+    // 只要K能与key_type用key_comp()比较即可，不会构造临时的key_type
+    iterator find(const key_type& key) {
+        return find_node(key);
+    }
+
+    const_iterator find(const key_type& key) const {
+        return find_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return find_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return find_node(key);
+    }
 
-    const_iterator find(const key_type& key) const;
+    bool contains(const key_type& key) const {
+        return find_node(key) != header_;
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return find_node(key) != header_;
+    }
 
     size_type count_multi(const key_type& key) const {
         auto f = equal_range_multi(key);
         return static_cast<size_type>(mstl::distance(f.first, f.second));
     }
 
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    size_type count_multi(const K& key) const {
+        auto f = equal_range_multi(key);
+        return static_cast<size_type>(mstl::distance(f.first, f.second));
+    }
+
     size_type count_unique(const key_type& key) const {
-        return find(key) == end() ? 0 : 1;
+        return find_node(key) == header_ ? 0 : 1;
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    size_type count_unique(const K& key) const {
+        return find_node(key) == header_ ? 0 : 1;
     }
 
-    iterator lower_bound(const key_type& key);
-    const_iterator lower_bound(const key_type& key) const;
-    iterator upper_bound(const key_type& key);
-    const_iterator upper_bound(const key_type& key) const;
+    iterator lower_bound(const key_type& key) {
+        return lower_bound_node(key);
+    }
+
+    const_iterator lower_bound(const key_type& key) const {
+        return lower_bound_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    iterator lower_bound(const K& key) {
+        return lower_bound_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    const_iterator lower_bound(const K& key) const {
+        return lower_bound_node(key);
+    }
+
+    iterator upper_bound(const key_type& key) {
+        return upper_bound_node(key);
+    }
+
+    const_iterator upper_bound(const key_type& key) const {
+        return upper_bound_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    iterator upper_bound(const K& key) {
+        return upper_bound_node(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    const_iterator upper_bound(const K& key) const {
+        return upper_bound_node(key);
+    }
 
     mstl::pair<iterator, iterator>
     equal_range_multi(const key_type& key) {
         return mstl::make_pair(lower_bound(key), upper_bound(key));
     }
 
-    mstl::pair<iterator, iterator>
+    mstl::pair<const_iterator, const_iterator>
     equal_range_multi(const key_type& key) const {
         return mstl::make_pair(lower_bound(key), upper_bound(key));
     }
 
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    mstl::pair<iterator, iterator>
+    equal_range_multi(const K& key) {
+        return mstl::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    mstl::pair<const_iterator, const_iterator>
+    equal_range_multi(const K& key) const {
+        return mstl::make_pair(lower_bound(key), upper_bound(key));
+    }
+
     mstl::pair<iterator, iterator>
     equal_range_unique(const key_type& key) {
         iterator iter = find(key);
@@ -950,13 +1070,31 @@ public:
         return iter == end() ? mstl::make_pair(iter, iter) : mstl::make_pair(iter, ++next);
     }
 
-    mstl::pair<iterator, iterator>
+    mstl::pair<const_iterator, const_iterator>
     equal_range_unique(const key_type& key) const {
         const_iterator iter = find(key);
         const_iterator next = iter;
         return iter == end() ? mstl::make_pair(iter, iter) : mstl::make_pair(iter, ++next);
     }
 
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    mstl::pair<iterator, iterator>
+    equal_range_unique(const K& key) {
+        iterator iter = find(key);
+        iterator next = iter;
+        return iter == end() ? mstl::make_pair(iter, iter) : mstl::make_pair(iter, ++next);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        rb_tree_is_transparent<Compare, K>::value, int>::type = 0>
+    mstl::pair<const_iterator, const_iterator>
+    equal_range_unique(const K& key) const {
+        const_iterator iter = find(key);
+        const_iterator next = iter;
+        return iter == end() ? mstl::make_pair(iter, iter) : mstl::make_pair(iter, ++next);
+    }
+
     void swap(rb_tree& rhs) noexcept;
     // 辅助函数
 private:
@@ -981,6 +1119,13 @@ private:
 
     base_ptr copy_from(base_ptr x, base_ptr p);
     void     erase_since(base_ptr x);
+
+    template<typename K>
+    base_ptr lower_bound_node(const K& key) const;
+    template<typename K>
+    base_ptr upper_bound_node(const K& key) const;
+    template<typename K>
+    base_ptr find_node(const K& key) const;
 };
 
 template<typename T, typename Compare>
@@ -1022,11 +1167,14 @@ rb_tree<T, Compare>::operator=(const rb_tree& rhs) {
 template<typename T, typename Compare>
 rb_tree<T, Compare>&
 rb_tree<T, Compare>::operator=(rb_tree&& rhs) noexcept {
-    clear();
-    header_ = mstl::move(rhs.header_);
-    node_count_ = rhs.node_count_;
-    key_cmp_ = rhs.key_cmp_;
-    rhs.reset();
+    if (this != &rhs) {
+        clear();
+        base_allocator::deallocate(header_);
+        header_ = mstl::move(rhs.header_);
+        node_count_ = rhs.node_count_;
+        key_cmp_ = rhs.key_cmp_;
+        rhs.reset();
+    }
     return *this;
 }
 
@@ -1120,7 +1268,7 @@ rb_tree<T, Compare>::emplace_unique_use_hint(iterator hint, Args&& ...args) {
             return insert_node_at(res.first.first, np, res.first.second);
         }
     }
-    return insert_multi_use_hint(hint, key, np);
+    return insert_unique_use_hint(hint, key, np);
 }
 
 // 插入元素，可重复
@@ -1143,6 +1291,47 @@ rb_tree<T, Compare>::insert_unique(const value_type& value) {
     return make_pair(iterator(res.first.first), false);
 }
 
+template<typename T, typename Compare>
+mstl::pair<typename rb_tree<T, Compare>::iterator, bool>
+rb_tree<T, Compare>::insert_unique(value_type&& value) {
+    THROW_LENGTH_ERROR_IF(node_count_ > max_size() - 1, "rb_tree<T, Comp>'s size too big");
+    pair<pair<base_ptr, bool>, bool> res = get_insert_unique_pos(value_traits::get_key(value));
+    if (!res.second) {
+        return make_pair(iterator(res.first.first), false);
+    }
+    node_ptr np = create_node(mstl::move(value));
+    return make_pair(insert_node_at(res.first.first, np, res.first.second), true);
+}
+
+template<typename T, typename Compare>
+template<typename K, typename ...Args>
+mstl::pair<typename rb_tree<T, Compare>::iterator, bool>
+rb_tree<T, Compare>::try_emplace_unique(K&& key, Args&& ...args) {
+    THROW_LENGTH_ERROR_IF(node_count_ > max_size() - 1, "rb_tree<T, Comp>'s size too big");
+    pair<pair<base_ptr, bool>, bool> res = get_insert_unique_pos(key);
+    if (!res.second) {
+        return mstl::make_pair(iterator(res.first.first), false);
+    }
+    node_ptr np = create_node(mstl::piecewise_construct,
+                              std::forward_as_tuple(mstl::forward<K>(key)),
+                              std::forward_as_tuple(mstl::forward<Args>(args)...));
+    return mstl::make_pair(insert_node_at(res.first.first, np, res.first.second), true);
+}
+
+template<typename T, typename Compare>
+template<typename K, typename M>
+mstl::pair<typename rb_tree<T, Compare>::iterator, bool>
+rb_tree<T, Compare>::insert_or_assign_unique(K&& key, M&& obj) {
+    THROW_LENGTH_ERROR_IF(node_count_ > max_size() - 1, "rb_tree<T, Comp>'s size too big");
+    pair<pair<base_ptr, bool>, bool> res = get_insert_unique_pos(key);
+    if (!res.second) {
+        res.first.first->get_node_ptr()->value.second = mstl::forward<M>(obj);
+        return mstl::make_pair(iterator(res.first.first), false);
+    }
+    node_ptr np = create_node(mstl::forward<K>(key), mstl::forward<M>(obj));
+    return mstl::make_pair(insert_node_at(res.first.first, np, res.first.second), true);
+}
+
 // 删除节点
 template<typename T, typename Compare>
 typename rb_tree<T, Compare>::iterator 
@@ -1157,6 +1346,75 @@ rb_tree<T, Compare>::erase(iterator hint) {
     return next;
 }
 
+// 与erase相同地摘下节点，摘下后节点的指针与新建的节点一样清空
+template<typename T, typename Compare>
+typename rb_tree<T, Compare>::node_handle
+rb_tree<T, Compare>::extract(iterator pos) {
+    node_ptr node = pos.node->get_node_ptr();
+    rb_tree_erase_rebalance(pos.node, root(), leftmost(), rightmost());
+    --node_count_;
+    node->left = nullptr;
+    node->right = nullptr;
+    node->parent = nullptr;
+    return node_handle(node);
+}
+
+template<typename T, typename Compare>
+typename rb_tree<T, Compare>::node_handle
+rb_tree<T, Compare>::extract(const key_type& key) {
+    base_ptr x = find_node(key);
+    return x == header_ ? node_handle() : extract(iterator(x));
+}
+
+template<typename T, typename Compare>
+typename rb_tree<T, Compare>::insert_return_type
+rb_tree<T, Compare>::insert_unique(node_handle&& nh) {
+    if (nh.empty()) {
+        return insert_return_type{end(), false, node_handle()};
+    }
+    pair<pair<base_ptr, bool>, bool> res = get_insert_unique_pos(value_traits::get_key(nh.node_->value));
+    if (!res.second) {
+        return insert_return_type{iterator(res.first.first), false, mstl::move(nh)};
+    }
+    node_ptr np = nh.release();
+    return insert_return_type{insert_node_at(res.first.first, np, res.first.second), true, node_handle()};
+}
+
+template<typename T, typename Compare>
+typename rb_tree<T, Compare>::iterator
+rb_tree<T, Compare>::insert_multi(node_handle&& nh) {
+    if (nh.empty()) {
+        return end();
+    }
+    pair<base_ptr, bool> res = get_insert_multi_pos(value_traits::get_key(nh.node_->value));
+    node_ptr np = nh.release();
+    return insert_node_at(res.first, np, res.second);
+}
+
+template<typename T, typename Compare>
+void rb_tree<T, Compare>::merge_unique(rb_tree& other) {
+    if (&other == this) {
+        return;
+    }
+    for (iterator it = other.begin(); it != other.end();) {
+        iterator cur = it++;
+        pair<pair<base_ptr, bool>, bool> res = get_insert_unique_pos(value_traits::get_key(*cur));
+        if (res.second) {
+            insert_node_at(res.first.first, other.extract(cur).release(), res.first.second);
+        }
+    }
+}
+
+template<typename T, typename Compare>
+void rb_tree<T, Compare>::merge_multi(rb_tree& other) {
+    if (&other == this) {
+        return;
+    }
+    for (iterator it = other.begin(); it != other.end();) {
+        insert_multi(other.extract(it++));
+    }
+}
+
 template<typename T, typename Compare>
 typename rb_tree<T, Compare>::size_type
 rb_tree<T, Compare>::erase_multi(const key_type& key) {
@@ -1199,70 +1457,11 @@ void rb_tree<T, Compare>::clear() {
     }
 }
 
+// 返回第一个不小于key的节点，不存在时返回header_
 template<typename T, typename Compare>
-typename rb_tree<T, Compare>::iterator
-rb_tree<T, Compare>::find(const key_type& key) {
-    // 先假设有边界在最大值位置
-    base_ptr y = header_;
-    base_ptr x = root();
-    while (x != nullptr) {
-        if (!key_cmp_(value_traits::get_key(x->get_node_ptr()->value), key)) {
-            // 如果key小于等于当前位置，则查找左子树，并更新y的值
-            y = x;
-            x = x->left;
-        } else {
-            // 如果key大于当前位置，则查找右子树
-            x = x->right;
-        }
-    }
-    iterator res = iterator(y);
-    // 最后判断找到的位置是否正确
-    return (res == end() || key_cmp_(key, value_traits::get_key(*res))) ? end() : res;
-}
-
-template<typename T, typename Compare>
-typename rb_tree<T, Compare>::const_iterator
-rb_tree<T, Compare>::find(const key_type& key) const {
-    // 先假设有边界在最大值位置
-    base_ptr y = header_;
-    base_ptr x = root();
-    while (x != nullptr) {
-        if (!key_cmp_(value_traits::get_key(x->get_node_ptr()->value), key)) {
-            // 如果key小于等于当前位置，则查找左子树，并更新y的值
-            y = x;
-            x = x->left;
-        } else {
-            // 如果key大于当前位置，则查找右子树
-            x = x->right;
-        }
-    }
-    iterator res = const_iterator(y);
-    // 最后判断找到的位置是否正确
-    return (res == end() || key_cmp_(key, value_traits::get_key(*res))) ? end() : res;
-}
-
-template<typename T, typename Compare>
-typename rb_tree<T, Compare>::iterator
-rb_tree<T, Compare>::lower_bound(const key_type& key) {
-    // 先假设有边界在最大值位置
-    base_ptr y = header_;
-    base_ptr x = root();
-    while (x != nullptr) {
-        if (!key_cmp_(value_traits::get_key(x->get_node_ptr()->value), key)) {
-            // 如果key小于等于当前位置，则查找左子树，并更新y的值
-            y = x;
-            x = x->left;
-        } else {
-            // 如果key大于当前位置，则查找右子树
-            x = x->right;
-        }
-    }
-    return iterator(y);
-}
-
-template<typename T, typename Compare>
-typename rb_tree<T, Compare>::const_iterator
-rb_tree<T, Compare>::lower_bound(const key_type& key) const {
+template<typename K>
+typename rb_tree<T, Compare>::base_ptr
+rb_tree<T, Compare>::lower_bound_node(const K& key) const {
     // 先假设有边界在最大值位置
     base_ptr y = header_;
     base_ptr x = root();
@@ -1276,12 +1475,14 @@ rb_tree<T, Compare>::lower_bound(const key_type& key) const {
             x = x->right;
         }
     }
-    return const_iterator(y);
+    return y;
 }
 
+// 返回第一个大于key的节点，不存在时返回header_
 template<typename T, typename Compare>
-typename rb_tree<T, Compare>::iterator
-rb_tree<T, Compare>::upper_bound(const key_type& key) {
+template<typename K>
+typename rb_tree<T, Compare>::base_ptr
+rb_tree<T, Compare>::upper_bound_node(const K& key) const {
     // 先假设有边界在最大值位置
     base_ptr y = header_;
     base_ptr x = root();
@@ -1295,26 +1496,16 @@ rb_tree<T, Compare>::upper_bound(const key_type& key) {
             x = x->right;
         }
     }
-    return iterator(y);
+    return y;
 }
 
 template<typename T, typename Compare>
-typename rb_tree<T, Compare>::const_iterator
-rb_tree<T, Compare>::upper_bound(const key_type& key) const {
-    // 先假设有边界在最大值位置
-    base_ptr y = header_;
-    base_ptr x = root();
-    while (x != nullptr) {
-        if (key_cmp_(key, value_traits::get_key(x->get_node_ptr()->value))) {
-            // 如果key小于当前位置，则查找左子树，并更新y的值
-            y = x;
-            x = x->left;
-        } else {
-            // 如果key大于当前位置，则查找右子树
-            x = x->right;
-        }
-    }
-    return const_iterator(y);
+template<typename K>
+typename rb_tree<T, Compare>::base_ptr
+rb_tree<T, Compare>::find_node(const K& key) const {
+    base_ptr y = lower_bound_node(key);
+    // 最后判断找到的位置是否正确
+    return (y == header_ || key_cmp_(key, value_traits::get_key(y->get_node_ptr()->value))) ? header_ : y;
 }
 
 template<typename T, typename Compare>
@@ -1398,7 +1589,8 @@ rb_tree<T, Compare>::get_insert_multi_pos(const key_type& key) {
     return mstl::make_pair(y, add_to_left);
 }
 
-// 判断key应该插入到哪个位置，返回pair，第一参数为pair表示插入的父节点以及插入其左还是右子节点，第二参数为是否插入成功
+// 判断key应该插入到哪个位置，返回pair，第一参数为pair表示插入的父节点以及插入其左还是右子节点，第二参数为是否插入成功，
+// 插入失败 (键值重复) 时第一参数中的节点为已有的相等节点
 template<typename T, typename Compare>
 mstl::pair<mstl::pair<typename rb_tree<T, Compare>::base_ptr, bool>, bool>
 rb_tree<T, Compare>::get_insert_unique_pos(const key_type& key) {
@@ -1427,8 +1619,8 @@ rb_tree<T, Compare>::get_insert_unique_pos(const key_type& key) {
     if (key_cmp_(value_traits::get_key(*j), key)) {
         return mstl::make_pair(mstl::make_pair(y, add_to_left), true);
     }
-    // 程序走到这里，说明插入出错
-    return mstl::make_pair(mstl::make_pair(y, add_to_left), false);
+    // 程序走到这里，说明键值重复，返回与key相等的节点j
+    return mstl::make_pair(mstl::make_pair(j.node, add_to_left), false);
 }
 
 // 以x为父节点插入新节点值为value，add_to_left标志插入位置是否为左子树
@@ -1516,8 +1708,9 @@ rb_tree<T, Compare>::insert_unique_use_hint(iterator hint, key_type key, node_pt
     iterator before = hint;
     --before;
     base_ptr before_node = before.node;
-    if (!key_cmp_(key, value_traits::get_key(*before)) &&
-        !key_cmp_(value_traits::get_key(*hint), key)) {
+    // 键值不可重复，必须严格位于before与hint之间
+    if (key_cmp_(value_traits::get_key(*before), key) &&
+        key_cmp_(key, value_traits::get_key(*hint))) {
         if (before_node->right == nullptr) {
             // 判断是否可以插入到hint的前一个节点的右子节点上
             return insert_node_at(before_node, node, false);
@@ -1531,7 +1724,7 @@ rb_tree<T, Compare>::insert_unique_use_hint(iterator hint, key_type key, node_pt
         destory_node(node);
         return pos.first.first;
     }
-    return insert_node_at(pos.first, node, pos.second);
+    return insert_node_at(pos.first.first, node, pos.first.second);
 }
 
 // 递归复制从 x 开始的所有节点，p 为 x 的父节点
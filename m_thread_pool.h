@@ -0,0 +1,427 @@
+#ifndef M_THREAD_POOL_H_
+#define M_THREAD_POOL_H_
+
+// 基于工作窃取的线程池 thread_pool
+// 每个工作线程拥有一个 ws_deque，自己产生的任务压入本地队列底部并优先从底部取出（LIFO，缓存友好），
+// 本地队列为空时先从外部提交队列 mpmc_queue 中取任务，再随机选择其他线程的队列顶部窃取。
+// 没有任务可做时线程在 mpmc_event 上休眠，新任务到来时被唤醒。
+// 等待任务完成的线程（parallel_invoke/parallel_for/wait）不会空等，而是帮忙执行任务，
+// 因此在任务内部继续 fork-join 不会造成死锁
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+
+#include "m_vector.h"
+#include "m_memory.h"
+#include "m_mpmc_queue.h"
+#include "m_ws_deque.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+
+namespace mstl {
+
+// 外部提交队列的容量，写满后提交者阻塞直到工作线程取走任务
+#ifndef THREAD_POOL_INJECT_CAPACITY
+#define THREAD_POOL_INJECT_CAPACITY 4096
+#endif
+
+class thread_pool;
+
+// 任务的基类
+struct thread_pool_task {
+    virtual ~thread_pool_task() {}
+    virtual void execute() = 0;
+};
+
+// submit 提交的任务，在堆上分配，执行后自行销毁
+// 异常在任务内部捕获并交给线程池记录，之后才减少未完成的任务数，wait 看到 0 时一定也能看到异常
+template<typename F>
+struct thread_pool_heap_task : public thread_pool_task {
+    F            func;
+    thread_pool* pool;
+
+    template<typename Fn>
+    thread_pool_heap_task(Fn&& f, thread_pool* p) : func(mstl::forward<Fn>(f)), pool(p) {}
+
+    void execute() override;
+};
+
+// parallel_invoke 派生的任务，位于等待者的栈上，执行完毕后设置 done 标记
+template<typename F>
+struct thread_pool_join_task : public thread_pool_task {
+    F&                 func;
+    std::atomic<bool>  done;
+    std::exception_ptr error;
+
+    explicit thread_pool_join_task(F& f) : func(f), done(false), error() {}
+
+    void execute() override {
+        try {
+            func();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done.store(true, std::memory_order_release);
+    }
+};
+
+class thread_pool {
+public:
+    typedef size_t           size_type;
+    typedef thread_pool_task task_type;
+
+private:
+    // ws_deque 的游标按缓存行对齐，worker 需要由 cache_aligned_allocator 申请
+    struct worker {
+        ws_deque<task_type*> tasks;
+        std::thread          thread;
+        thread_pool*         pool;
+        uint64_t             seed;
+    };
+
+    typedef cache_aligned_allocator<worker> worker_allocator;
+
+    template<typename F>
+    friend struct thread_pool_heap_task;
+
+    mstl::vector<worker*>        workers_;
+    mpmc_queue<task_type*>       inject_;
+    // 有新任务时通知休眠的工作线程
+    mpmc_event                   work_event_;
+    // submit 提交但尚未执行完的任务个数，以及 wait 的等待事件
+    alignas(MSTL_CACHE_LINE_SIZE) std::atomic<size_t> pending_;
+    mpmc_event                   idle_event_;
+    std::atomic<bool>            stop_;
+    // submit 的任务抛出的第一个异常，在 wait 中重新抛出
+    std::mutex                   error_mutex_;
+    std::exception_ptr           error_;
+
+public:
+    explicit thread_pool(size_type thread_count = std::thread::hardware_concurrency());
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // 等待已提交的任务全部完成后结束所有线程
+    ~thread_pool();
+
+    size_type size() const noexcept {
+        return workers_.size();
+    }
+
+    // 提交一个任务，不等待其完成
+    template<typename F>
+    void submit(F&& f);
+
+    // 等待所有通过 submit 提交的任务完成，不能在任务内部调用
+    void wait();
+
+    // 并行执行 f1 和 f2，返回时二者均已完成
+    template<typename F1, typename F2>
+    void parallel_invoke(F1&& f1, F2&& f2);
+
+    // 对 [first, last) 中的每个下标调用 f(i)，区间会被二分拆分直到不大于 grain
+    // grain 为 0 时根据线程数自动选择
+    template<typename Index, typename F>
+    void parallel_for(Index first, Index last, F f, Index grain = Index());
+
+private:
+    static worker*& current_worker() {
+        static thread_local worker* w = nullptr;
+        return w;
+    }
+
+    // 当前线程是本线程池的工作线程时返回其 worker，否则返回 nullptr
+    worker* local_worker() const {
+        worker* w = current_worker();
+        return w != nullptr && w->pool == this ? w : nullptr;
+    }
+
+    void run_worker(worker* self);
+    void push_task(task_type* task);
+    task_type* find_task(worker* self);
+    void run_task(task_type* task);
+    void record_error(std::exception_ptr e);
+    void finish_task(std::exception_ptr e);
+
+    template<typename Index, typename F>
+    void parallel_for_impl(Index first, Index last, F& f, Index grain);
+};
+
+inline thread_pool::thread_pool(size_type thread_count)
+    : inject_(THREAD_POOL_INJECT_CAPACITY), pending_(0), stop_(false) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    workers_.reserve(thread_count);
+    // 构造函数抛出异常时析构函数不会执行，已经放入 workers_ 的 worker 需要在这里释放
+    try {
+        for (size_type i = 0; i < thread_count; ++i) {
+            worker* w = worker_allocator::allocate();
+            try {
+                worker_allocator::construct(w);
+            } catch (...) {
+                worker_allocator::deallocate(w);
+                throw;
+            }
+            w->pool = this;
+            w->seed = 0x9e3779b97f4a7c15ull * (i + 1);
+            workers_.push_back(w);
+        }
+    } catch (...) {
+        for (size_type i = 0; i < workers_.size(); ++i) {
+            worker_allocator::destory(workers_[i]);
+            worker_allocator::deallocate(workers_[i]);
+        }
+        throw;
+    }
+    try {
+        for (size_type i = 0; i < thread_count; ++i) {
+            worker* w = workers_[i];
+            w->thread = std::thread([this, w]() {
+                run_worker(w);
+            });
+        }
+    } catch (...) {
+        stop_.store(true, std::memory_order_release);
+        work_event_.notify();
+        for (size_type i = 0; i < workers_.size(); ++i) {
+            if (workers_[i]->thread.joinable()) {
+                workers_[i]->thread.join();
+            }
+        }
+        for (size_type i = 0; i < workers_.size(); ++i) {
+            worker_allocator::destory(workers_[i]);
+            worker_allocator::deallocate(workers_[i]);
+        }
+        throw;
+    }
+}
+
+inline thread_pool::~thread_pool() {
+    try {
+        wait();
+    } catch (...) {
+    }
+    stop_.store(true, std::memory_order_release);
+    work_event_.notify();
+    // 其他线程可能仍在窃取，必须全部结束后才能释放 worker
+    for (size_type i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread.join();
+    }
+    for (size_type i = 0; i < workers_.size(); ++i) {
+        worker_allocator::destory(workers_[i]);
+        worker_allocator::deallocate(workers_[i]);
+    }
+}
+
+template<typename F>
+void thread_pool::submit(F&& f) {
+    typedef thread_pool_heap_task<typename std::decay<F>::type> heap_task;
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    task_type* task;
+    try {
+        task = new heap_task(mstl::forward<F>(f), this);
+    } catch (...) {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+    }
+    push_task(task);
+}
+
+inline void thread_pool::wait() {
+    MSTL_DEBUG(local_worker() == nullptr);
+    while (pending_.load(std::memory_order_acquire) != 0) {
+        // 外部线程同样帮忙执行任务
+        task_type* task = find_task(nullptr);
+        if (task != nullptr) {
+            run_task(task);
+            continue;
+        }
+        const uint32_t key = idle_event_.prepare();
+        if (pending_.load(std::memory_order_acquire) != 0) {
+            idle_event_.wait(key);
+        }
+        idle_event_.retire();
+    }
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        e = error_;
+        error_ = nullptr;
+    }
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+template<typename F1, typename F2>
+void thread_pool::parallel_invoke(F1&& f1, F2&& f2) {
+    worker* self = local_worker();
+    thread_pool_join_task<typename std::remove_reference<F2>::type> forked(f2);
+    push_task(&forked);
+    std::exception_ptr error;
+    try {
+        f1();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // 在 forked 完成之前执行其他任务，forked 多半仍在本地队列底部，会被立即取回
+    while (!forked.done.load(std::memory_order_acquire)) {
+        task_type* task = find_task(self);
+        if (task != nullptr) {
+            run_task(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (forked.error) {
+        std::rethrow_exception(forked.error);
+    }
+}
+
+template<typename Index, typename F>
+void thread_pool::parallel_for(Index first, Index last, F f, Index grain) {
+    if (!(first < last)) {
+        return;
+    }
+    if (grain == Index()) {
+        // 每个线程大约分得 8 块，兼顾负载均衡与调度开销
+        const Index chunks = static_cast<Index>(workers_.size() * 8);
+        grain = (last - first) / chunks;
+        if (grain == Index()) {
+            grain = static_cast<Index>(1);
+        }
+    }
+    parallel_for_impl(first, last, f, grain);
+}
+
+template<typename Index, typename F>
+void thread_pool::parallel_for_impl(Index first, Index last, F& f, Index grain) {
+    if (last - first <= grain) {
+        for (; first < last; ++first) {
+            f(first);
+        }
+        return;
+    }
+    const Index mid = first + (last - first) / 2;
+    parallel_invoke([&]() { parallel_for_impl(first, mid, f, grain); },
+                    [&]() { parallel_for_impl(mid, last, f, grain); });
+}
+
+// 工作线程压入本地队列，外部线程压入提交队列
+inline void thread_pool::push_task(task_type* task) {
+    worker* self = local_worker();
+    if (self != nullptr) {
+        self->tasks.push(task);
+    } else {
+        inject_.push(task);
+    }
+    // 只有一个新任务，唤醒一个空闲线程即可，全部唤醒只留给析构
+    work_event_.notify_one();
+}
+
+// 依次尝试本地队列、提交队列，最后随机窃取其他线程
+inline thread_pool::task_type* thread_pool::find_task(worker* self) {
+    task_type* task = nullptr;
+    if (self != nullptr && self->tasks.pop(task)) {
+        return task;
+    }
+    if (inject_.try_pop(task)) {
+        return task;
+    }
+    const size_type n = workers_.size();
+    uint64_t seed = self != nullptr ? self->seed : reinterpret_cast<uintptr_t>(&task);
+    for (size_type attempt = 0; attempt < 2 * n; ++attempt) {
+        // xorshift 随机数选择受害者，避免所有窃取者集中在同一个队列上
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        worker* victim = workers_[seed % n];
+        if (victim != self && victim->tasks.steal(task)) {
+            break;
+        }
+        task = nullptr;
+    }
+    if (self != nullptr) {
+        self->seed = seed;
+    }
+    return task;
+}
+
+// 任务自己捕获异常，execute 不会抛出
+inline void thread_pool::run_task(task_type* task) {
+    task->execute();
+    if (pending_.load(std::memory_order_acquire) == 0) {
+        idle_event_.notify();
+    }
+}
+
+inline void thread_pool::record_error(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (!error_) {
+        error_ = e;
+    }
+}
+
+// submit 的任务执行完毕，先记录异常再减少计数
+inline void thread_pool::finish_task(std::exception_ptr e) {
+    if (e) {
+        record_error(e);
+    }
+    pending_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+template<typename F>
+void thread_pool_heap_task<F>::execute() {
+    thread_pool* p = pool;
+    std::exception_ptr e;
+    try {
+        func();
+    } catch (...) {
+        e = std::current_exception();
+    }
+    delete this;
+    p->finish_task(e);
+}
+
+inline void thread_pool::run_worker(worker* self) {
+    current_worker() = self;
+    int idle = 0;
+    while (true) {
+        task_type* task = find_task(self);
+        if (task != nullptr) {
+            run_task(task);
+            idle = 0;
+            continue;
+        }
+        if (stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+        if (++idle < MPMC_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+        // 登记后再检查一次，避免错过在此期间提交的任务
+        const uint32_t key = work_event_.prepare();
+        task = find_task(self);
+        if (task == nullptr && !stop_.load(std::memory_order_acquire)) {
+            work_event_.wait(key);
+        }
+        work_event_.retire();
+        if (task != nullptr) {
+            run_task(task);
+        }
+        idle = 0;
+    }
+    current_worker() = nullptr;
+}
+
+} // mstl
+
+#endif
@@ -44,6 +44,26 @@ namespace mstl {
     template<typename T1, typename T2>
     struct is_pair<mstl::pair<T1, T2>> : true_type {};
 
+    // 把任意类型映射为void，用于检测某个成员类型是否存在
+    template<typename...>
+    struct make_void {
+        typedef void type;
+    };
+
+    // 判断仿函数是否声明了is_transparent，声明了的比较或哈希函数可以接受与键值不同的类型
+    template<typename T, typename = void>
+    struct is_transparent : false_type {};
+
+    template<typename T>
+    struct is_transparent<T, typename make_void<typename T::is_transparent>::type> : true_type {};
+
+    // 判断哈希函数是否声明了is_avalanching，声明了的哈希函数输出已经充分混合，容器不必再混合一次
+    template<typename T, typename = void>
+    struct is_avalanching : false_type {};
+
+    template<typename T>
+    struct is_avalanching<T, typename make_void<typename T::is_avalanching>::type> : true_type {};
+
 }
 
 #endif
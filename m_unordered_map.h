@@ -5,14 +5,25 @@
 
 namespace mstl {
 
+// merge中使用
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+class unordered_multimap;
+
 // unordered_map模板类
-// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，第四参数为键比较大小的函数类型，缺省为mstl::equal_to<>
-template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，第四参数为键比较大小的函数类型，缺省为mstl::equal_to<>，
+// 第五参数为bucket下标策略，缺省为素数大小的ht_prime_bucket_policy，也可选用2的幂大小的ht_pow2_bucket_policy
+// 第六参数为节点内存策略，缺省为逐个从堆上申请的ht_heap_node_policy，构建后整体丢弃的表可选用ht_arena_node_policy
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename BucketPolicy = mstl::ht_prime_bucket_policy, typename NodePolicy = mstl::ht_heap_node_policy>
 class unordered_map {
 private:
     // 以hashtable作为底层容器进行封装
-    typedef hashtable<mstl::pair<const Key, T>, Hash, KeyEqual> base_type;
+    typedef hashtable<mstl::pair<const Key, T>, Hash, KeyEqual, BucketPolicy, NodePolicy> base_type;
     base_type ht_;
+
+    // merge需要访问另一种容器的hashtable
+    template<typename, typename, typename, typename, typename, typename>
+    friend class unordered_multimap;
 public:
     typedef typename base_type::allocator_type       allocator_type;
     typedef typename base_type::key_type             key_type;
@@ -33,6 +44,9 @@ public:
     typedef typename base_type::local_iterator       local_iterator;
     typedef typename base_type::const_local_iterator const_local_iterator;
 
+    typedef typename base_type::node_handle          node_type;
+    typedef typename base_type::insert_return_type   insert_return_type;
+
     allocator_type get_allocator() const {
         return ht_.get_allocator();
     }
@@ -56,6 +70,15 @@ public:
         }
     }
 
+    // 在pool中并行地创建节点并链接到各bucket，得到的元素与逐个插入相同
+    template<typename InputIter>
+    unordered_map(InputIter first, InputIter last, thread_pool& pool,
+                  const size_type bucket_count = 100,
+                  const Hash& hash = Hash(),
+                  const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.parallel_build_unique(first, last, pool);
+    }
+
     unordered_map(std::initializer_list<value_type> ilist,
                   const size_type bucket_count = 100,
                   const Hash& hash = Hash(),
@@ -146,7 +169,7 @@ public:
     }
 
     pair<iterator, bool> insert(value_type&& value) {
-        return ht_.emplace_unique(mstl::move(value));
+        return ht_.insert_unique(mstl::move(value));
     }
 
     iterator insert(const_iterator hint, const value_type& value) {
@@ -154,7 +177,7 @@ public:
     }
 
     iterator insert(const_iterator hint, value_type&& value) {
-        return ht_.emplace_unique_use_hint(hint, mstl::move(value));
+        return ht_.insert_unique_use_hint(hint, mstl::move(value));
     }
 
     template<typename InputIter>
@@ -162,18 +185,86 @@ public:
         ht_.insert_unique(first, last);
     }
 
+    // 键值不存在时才构造元素，已经存在时不申请节点，args也不会被移动
+    template<typename ...Args>
+    pair<iterator, bool> try_emplace(const key_type& key, Args&& ...args) {
+        return ht_.try_emplace_unique(key, mstl::forward<Args>(args)...);
+    }
+
+    template<typename ...Args>
+    pair<iterator, bool> try_emplace(key_type&& key, Args&& ...args) {
+        return ht_.try_emplace_unique(mstl::move(key), mstl::forward<Args>(args)...);
+    }
+
+    template<typename ...Args>
+    iterator try_emplace(const_iterator /*hint*/, const key_type& key, Args&& ...args) {
+        return ht_.try_emplace_unique(key, mstl::forward<Args>(args)...).first;
+    }
+
+    template<typename ...Args>
+    iterator try_emplace(const_iterator /*hint*/, key_type&& key, Args&& ...args) {
+        return ht_.try_emplace_unique(mstl::move(key), mstl::forward<Args>(args)...).first;
+    }
+
+    // 键值存在时赋值，否则插入，返回的bool表示是否为新插入
+    template<typename M>
+    pair<iterator, bool> insert_or_assign(const key_type& key, M&& obj) {
+        return ht_.insert_or_assign_unique(key, mstl::forward<M>(obj));
+    }
+
+    template<typename M>
+    pair<iterator, bool> insert_or_assign(key_type&& key, M&& obj) {
+        return ht_.insert_or_assign_unique(mstl::move(key), mstl::forward<M>(obj));
+    }
+
+    template<typename M>
+    iterator insert_or_assign(const_iterator /*hint*/, const key_type& key, M&& obj) {
+        return ht_.insert_or_assign_unique(key, mstl::forward<M>(obj)).first;
+    }
+
+    template<typename M>
+    iterator insert_or_assign(const_iterator /*hint*/, key_type&& key, M&& obj) {
+        return ht_.insert_or_assign_unique(mstl::move(key), mstl::forward<M>(obj)).first;
+    }
+
     void erase(iterator iter) {
         ht_.erase(iter);
     }
 
     void erase(iterator first, iterator last) {
-        ht_.earse(first, last);
+        ht_.erase(first, last);
     }
 
     size_type erase(const key_type& key) {
         return ht_.erase_unique(key);
     }
 
+    // 节点句柄，在容器之间转移元素时不申请内存也不复制元素，要求NodePolicy的transferable为true
+    node_type extract(const_iterator pos) {
+        return ht_.extract(pos);
+    }
+
+    node_type extract(const key_type& key) {
+        return ht_.extract(key);
+    }
+
+    insert_return_type insert(node_type&& nh) {
+        return ht_.insert_unique(mstl::move(nh));
+    }
+
+    iterator insert(const_iterator /*hint*/, node_type&& nh) {
+        return ht_.insert_unique(mstl::move(nh)).position;
+    }
+
+    // 把src中的元素移到本容器，键值已经存在的元素留在src中
+    void merge(unordered_map& src) {
+        ht_.merge_unique(src.ht_);
+    }
+
+    void merge(unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& src) {
+        ht_.merge_unique(src.ht_);
+    }
+
     void clear() {
         ht_.clear();
     }
@@ -184,36 +275,32 @@ public:
 
     mapped_type& at(const key_type& key) {
         iterator iter = ht_.find(key);
-        THROW_OUT_OF_RANGE_IF(iter == nullptr, "unordered_map<Key, T> no such element exists");
+        THROW_OUT_OF_RANGE_IF(iter == end(), "unordered_map<Key, T> no such element exists");
         return iter->second;
     }
 
     const mapped_type& at(const key_type& key) const {
-        iterator iter = ht_.find(key);
-        THROW_OUT_OF_RANGE_IF(iter == nullptr, "unordered_map<Key, T> no such element exists");
+        const_iterator iter = ht_.find(key);
+        THROW_OUT_OF_RANGE_IF(iter == end(), "unordered_map<Key, T> no such element exists");
         return iter->second;
     }
 
     mapped_type& operator[](const key_type& key) {
-        iterator iter = ht_.find(key);
-        if (iter == nullptr) {
-            iter = ht_.emplace_unique(key, T()).first;
-        }
-        return iter->second;
+        return ht_.try_emplace_unique(key).first->second;
     }
 
     mapped_type& operator[](key_type&& key) {
-        iterator iter = ht_.find(key);
-        if (iter == nullptr) {
-            iter = ht_.emplace_unique(mstl::move(key), T()).first;
-        }
-        return iter->second;
+        return ht_.try_emplace_unique(mstl::move(key)).first->second;
     }
 
-    size_type count(const key_type key) const {
+    size_type count(const key_type& key) const {
         return ht_.count(key);
     }
 
+    bool contains(const key_type& key) const {
+        return ht_.contains(key);
+    }
+
     iterator find(const key_type& key) {
         return ht_.find(key);
     }
@@ -226,10 +313,63 @@ public:
         return ht_.equal_range_unique(key);
     }
 
-    pair<iterator, iterator> equal_range(const key_type& key) const {
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+        return ht_.equal_range_unique(key);
+    }
+
+    // 异构查找，要求Hash与KeyEqual都声明了is_transparent
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    size_type count(const K& key) const {
+        return ht_.count(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return ht_.contains(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range(const K& key) {
+        return ht_.equal_range_unique(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range(const K& key) const {
         return ht_.equal_range_unique(key);
     }
 
+    // 批量查找，keys[i]的结果写入out[i]，一组键值的访存延迟相互重叠
+    template<typename K>
+    void find_batch(const K* keys, size_type n, iterator* out) {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void find_batch(const K* keys, size_type n, const_iterator* out) const {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void count_batch(const K* keys, size_type n, size_type* out) const {
+        ht_.count_batch(keys, n, out);
+    }
+
     local_iterator begin(const size_type n) noexcept {
         return ht_.begin(n);
     }
@@ -290,6 +430,50 @@ public:
         ht_.reserve(count);
     }
 
+    // 渐进式rehash，step为每次插入迁移的bucket个数，为0时关闭
+    size_type rehash_step() const noexcept {
+        return ht_.rehash_step();
+    }
+
+    void rehash_step(const size_type step) {
+        ht_.rehash_step(step);
+    }
+
+    void finish_rehash() {
+        ht_.finish_rehash();
+    }
+
+    // 设置后元素较多时的rehash在pool中并行进行，nullptr恢复为串行
+    thread_pool* rehash_pool() const noexcept {
+        return ht_.rehash_pool();
+    }
+
+    void rehash_pool(thread_pool* pool) noexcept {
+        ht_.rehash_pool(pool);
+    }
+
+    // 查找前先询问布隆过滤器，适合大部分查找都失败的表，bits_per_key为0时关闭，见hashtable::enable_filter
+    void enable_filter(const size_type bits_per_key = 10) {
+        ht_.enable_filter(bits_per_key);
+    }
+
+    void disable_filter() noexcept {
+        ht_.disable_filter();
+    }
+
+    bool filter_enabled() const noexcept {
+        return ht_.filter_enabled();
+    }
+
+    // 链长分布与热点bucket，定义MSTL_HT_STATS时还有探测与rehash计数，见ht_stats
+    ht_stats stats(const size_type top = 8) const {
+        return ht_.stats(top);
+    }
+
+    void reset_stats() noexcept {
+        ht_.reset_stats();
+    }
+
     hasher hash_func() const {
         return ht_.hash_func();
     }
@@ -308,33 +492,41 @@ public:
     }
 };
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-bool operator==(const unordered_map<Key, T, Hash, KeyEqual>& lhs,
-                const unordered_map<Key, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator==(const unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs == rhs;
 }
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-bool operator!=(const unordered_map<Key, T, Hash, KeyEqual>& lhs,
-                const unordered_map<Key, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator!=(const unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs != rhs;
 }
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-void swap(unordered_map<Key, T, Hash, KeyEq, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void swap(unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+          unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     lhs.swap(rhs);
 }
 
 
 /****************************************************************************************************************************************/
 // unordered_multimap模板类
-// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，第四参数为键比较大小的函数类型，缺省为mstl::equal_to<>
-template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+// 第一参数为键的类型，第二参数为值的类型，第三参数为哈希函数类型，缺省时使用mstl::hash<>，第四参数为键比较大小的函数类型，缺省为mstl::equal_to<>，
+// 第五参数为bucket下标策略，缺省为素数大小的ht_prime_bucket_policy，也可选用2的幂大小的ht_pow2_bucket_policy
+// 第六参数为节点内存策略，缺省为逐个从堆上申请的ht_heap_node_policy，构建后整体丢弃的表可选用ht_arena_node_policy
+template<typename Key, typename T, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename BucketPolicy = mstl::ht_prime_bucket_policy, typename NodePolicy = mstl::ht_heap_node_policy>
 class unordered_multimap {
 private:
     // 以hashtable作为底层容器进行封装
-    typedef hashtable<mstl::pair<const Key, T>, Hash, KeyEqual> base_type;
+    typedef hashtable<mstl::pair<const Key, T>, Hash, KeyEqual, BucketPolicy, NodePolicy> base_type;
     base_type ht_;
+
+    // merge需要访问另一种容器的hashtable
+    template<typename, typename, typename, typename, typename, typename>
+    friend class unordered_map;
 public:
     typedef typename base_type::allocator_type       allocator_type;
     typedef typename base_type::key_type             key_type;
@@ -355,6 +547,8 @@ public:
     typedef typename base_type::local_iterator       local_iterator;
     typedef typename base_type::const_local_iterator const_local_iterator;
 
+    typedef typename base_type::node_handle          node_type;
+
     allocator_type get_allocator() const {
         return ht_.get_allocator();
     }
@@ -378,6 +572,15 @@ public:
         }
     }
 
+    // 在pool中并行地创建节点并链接到各bucket，得到的元素与逐个插入相同
+    template<typename InputIter>
+    unordered_multimap(InputIter first, InputIter last, thread_pool& pool,
+                       const size_type bucket_count = 100,
+                       const Hash& hash = Hash(),
+                       const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.parallel_build_multi(first, last, pool);
+    }
+
     unordered_multimap(std::initializer_list<value_type> ilist,
                   const size_type bucket_count = 100,
                   const Hash& hash = Hash(),
@@ -489,13 +692,39 @@ public:
     }
 
     void erase(iterator first, iterator last) {
-        ht_.earse(first, last);
+        ht_.erase(first, last);
     }
 
     size_type erase(const key_type& key) {
         return ht_.erase_multi(key);
     }
 
+    // 节点句柄，在容器之间转移元素时不申请内存也不复制元素，要求NodePolicy的transferable为true
+    node_type extract(const_iterator pos) {
+        return ht_.extract(pos);
+    }
+
+    node_type extract(const key_type& key) {
+        return ht_.extract(key);
+    }
+
+    iterator insert(node_type&& nh) {
+        return ht_.insert_multi(mstl::move(nh));
+    }
+
+    iterator insert(const_iterator /*hint*/, node_type&& nh) {
+        return ht_.insert_multi(mstl::move(nh));
+    }
+
+    // 把src中的元素全部移到本容器
+    void merge(unordered_multimap& src) {
+        ht_.merge_multi(src.ht_);
+    }
+
+    void merge(unordered_map<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& src) {
+        ht_.merge_multi(src.ht_);
+    }
+
     void clear() {
         ht_.clear();
     }
@@ -504,12 +733,16 @@ public:
         ht_.swap(rhs.ht_);
     }
 
-    size_type count(const key_type key) const {
-        return ht_.count();
+    size_type count(const key_type& key) const {
+        return ht_.count(key);
+    }
+
+    bool contains(const key_type& key) const {
+        return ht_.contains(key);
     }
 
     iterator find(const key_type& key) {
-        return ht_.find();
+        return ht_.find(key);
     }
 
     const_iterator find(const key_type& key) const {
@@ -520,10 +753,63 @@ public:
         return ht_.equal_range_multi(key);
     }
 
-    pair<iterator, iterator> equal_range(const key_type& key) const {
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
         return ht_.equal_range_multi(key);
     }
 
+    // 异构查找，要求Hash与KeyEqual都声明了is_transparent
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    size_type count(const K& key) const {
+        return ht_.count(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return ht_.contains(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range(const K& key) {
+        return ht_.equal_range_multi(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range(const K& key) const {
+        return ht_.equal_range_multi(key);
+    }
+
+    // 批量查找，keys[i]的结果写入out[i]，一组键值的访存延迟相互重叠
+    template<typename K>
+    void find_batch(const K* keys, size_type n, iterator* out) {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void find_batch(const K* keys, size_type n, const_iterator* out) const {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void count_batch(const K* keys, size_type n, size_type* out) const {
+        ht_.count_batch(keys, n, out);
+    }
+
     local_iterator begin(const size_type n) noexcept {
         return ht_.begin(n);
     }
@@ -537,15 +823,15 @@ public:
     }
 
     local_iterator end(const size_type n) noexcept {
-        return ht_.end();
+        return ht_.end(n);
     }
 
     const_local_iterator end(const size_type n) const noexcept {
-        return ht_.end();
+        return ht_.end(n);
     }
 
     const_local_iterator cend(const size_type n) const noexcept {
-        return ht_.cend();
+        return ht_.cend(n);
     }
 
     size_type bucket_count() const noexcept {
@@ -584,6 +870,50 @@ public:
         ht_.reserve(count);
     }
 
+    // 渐进式rehash，step为每次插入迁移的bucket个数，为0时关闭
+    size_type rehash_step() const noexcept {
+        return ht_.rehash_step();
+    }
+
+    void rehash_step(const size_type step) {
+        ht_.rehash_step(step);
+    }
+
+    void finish_rehash() {
+        ht_.finish_rehash();
+    }
+
+    // 设置后元素较多时的rehash在pool中并行进行，nullptr恢复为串行
+    thread_pool* rehash_pool() const noexcept {
+        return ht_.rehash_pool();
+    }
+
+    void rehash_pool(thread_pool* pool) noexcept {
+        ht_.rehash_pool(pool);
+    }
+
+    // 查找前先询问布隆过滤器，适合大部分查找都失败的表，bits_per_key为0时关闭，见hashtable::enable_filter
+    void enable_filter(const size_type bits_per_key = 10) {
+        ht_.enable_filter(bits_per_key);
+    }
+
+    void disable_filter() noexcept {
+        ht_.disable_filter();
+    }
+
+    bool filter_enabled() const noexcept {
+        return ht_.filter_enabled();
+    }
+
+    // 链长分布与热点bucket，定义MSTL_HT_STATS时还有探测与rehash计数，见ht_stats
+    ht_stats stats(const size_type top = 8) const {
+        return ht_.stats(top);
+    }
+
+    void reset_stats() noexcept {
+        ht_.reset_stats();
+    }
+
     hasher hash_func() const {
         return ht_.hash_func();
     }
@@ -602,21 +932,21 @@ public:
     }
 };
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-bool operator==(const unordered_multimap<Key, T, Hash, KeyEqual>& lhs,
-                const unordered_multimap<Key, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator==(const unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs == rhs;
 }
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-bool operator!=(const unordered_multimap<Key, T, Hash, KeyEqual>& lhs,
-                const unordered_multimap<Key, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator!=(const unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs != rhs;
 }
 
-template<typename Key, typename T, typename Hash, typename KeyEqual>
-void swap(unordered_multimap<Key, T, Hash, KeyEqual>& lhs,
-          unordered_multimap<Key, T, Hash, KeyEqual>& rhs) {
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void swap(unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+          unordered_multimap<Key, T, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     lhs.swap(rhs);
 }
 
@@ -5,14 +5,24 @@
 
 namespace mstl {
 
+// merge中使用
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+class unordered_multiset;
+
 // unordered_set，键值不重复
-// 第一模板参数为键值，第二为哈希函数缺省为mstl::hash<>，第三为键值比较大小函数，缺省为equal_to<>
-template<typename Key, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+// 第一模板参数为键值，第二为哈希函数缺省为mstl::hash<>，第三为键值比较大小函数，缺省为equal_to<>，
+// 第四为bucket下标策略，缺省为ht_prime_bucket_policy，第五为节点内存策略，缺省为ht_heap_node_policy
+template<typename Key, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename BucketPolicy = mstl::ht_prime_bucket_policy, typename NodePolicy = mstl::ht_heap_node_policy>
 class unordered_set {
 private:
     // 底层容器为hashtable<>
-    typedef mstl::hashtable<Key, Hash, KeyEqual>     base_type;
+    typedef mstl::hashtable<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>     base_type;
     base_type ht_;
+
+    // merge需要访问另一种容器的hashtable
+    template<typename, typename, typename, typename, typename>
+    friend class unordered_multiset;
 public:
     typedef typename base_type::allocator_type       allocator_type;
     typedef typename base_type::key_type             key_type;
@@ -33,6 +43,9 @@ public:
     typedef typename base_type::local_iterator       local_iterator;
     typedef typename base_type::const_local_iterator const_local_iterator;
 
+    typedef typename base_type::node_handle          node_type;
+    typedef typename base_type::insert_return_type   insert_return_type;
+
     allocator_type get_allocator() const {
         return ht_.get_allocator();
     }
@@ -56,6 +69,15 @@ public:
         }
     }
 
+    // 在pool中并行地创建节点并链接到各bucket，得到的元素与逐个插入相同
+    template<typename InputIter>
+    unordered_set(InputIter first, InputIter last, thread_pool& pool,
+                  const size_type bucket_count = 100,
+                  const Hash& hash = Hash(),
+                  const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.parallel_build_unique(first, last, pool);
+    }
+
     unordered_set(std::initializer_list<value_type> ilist,
                   const size_type bucket_count = 100,
                   const Hash& hash = Hash(),
@@ -146,7 +168,7 @@ public:
     }
 
     pair<iterator, bool> insert(value_type&& value) {
-        return ht_.emplace_unique(mstl::move(value));
+        return ht_.insert_unique(mstl::move(value));
     }
 
     iterator insert(const_iterator hint, const value_type& value) {
@@ -154,7 +176,7 @@ public:
     }
 
     iterator insert(const_iterator hint, value_type&& value) {
-        return ht_.emplace_unique_use_hint(hint, mstl::move(value));
+        return ht_.insert_unique_use_hint(hint, mstl::move(value));
     }
 
     template<typename InputIter>
@@ -167,13 +189,39 @@ public:
     }
 
     void erase(iterator first, iterator last) {
-        ht_.earse(first, last);
+        ht_.erase(first, last);
     }
 
     size_type erase(const key_type& key) {
         return ht_.erase_unique(key);
     }
 
+    // 节点句柄，在容器之间转移元素时不申请内存也不复制元素，要求NodePolicy的transferable为true
+    node_type extract(const_iterator pos) {
+        return ht_.extract(pos);
+    }
+
+    node_type extract(const key_type& key) {
+        return ht_.extract(key);
+    }
+
+    insert_return_type insert(node_type&& nh) {
+        return ht_.insert_unique(mstl::move(nh));
+    }
+
+    iterator insert(const_iterator /*hint*/, node_type&& nh) {
+        return ht_.insert_unique(mstl::move(nh)).position;
+    }
+
+    // 把src中的元素移到本容器，键值已经存在的元素留在src中
+    void merge(unordered_set& src) {
+        ht_.merge_unique(src.ht_);
+    }
+
+    void merge(unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& src) {
+        ht_.merge_unique(src.ht_);
+    }
+
     void clear() {
         ht_.clear();
     }
@@ -182,10 +230,14 @@ public:
         ht_.swap(rhs.ht_);
     }
 
-    size_type count(const key_type key) const {
+    size_type count(const key_type& key) const {
         return ht_.count(key);
     }
 
+    bool contains(const key_type& key) const {
+        return ht_.contains(key);
+    }
+
     iterator find(const key_type& key) {
         return ht_.find(key);
     }
@@ -198,10 +250,63 @@ public:
         return ht_.equal_range_unique(key);
     }
 
-    pair<iterator, iterator> equal_range(const key_type& key) const {
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+        return ht_.equal_range_unique(key);
+    }
+
+    // 异构查找，要求Hash与KeyEqual都声明了is_transparent
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    size_type count(const K& key) const {
+        return ht_.count(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return ht_.contains(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range(const K& key) {
+        return ht_.equal_range_unique(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range(const K& key) const {
         return ht_.equal_range_unique(key);
     }
 
+    // 批量查找，keys[i]的结果写入out[i]，一组键值的访存延迟相互重叠
+    template<typename K>
+    void find_batch(const K* keys, size_type n, iterator* out) {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void find_batch(const K* keys, size_type n, const_iterator* out) const {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void count_batch(const K* keys, size_type n, size_type* out) const {
+        ht_.count_batch(keys, n, out);
+    }
+
     local_iterator begin(const size_type n) noexcept {
         return ht_.begin(n);
     }
@@ -262,6 +367,50 @@ public:
         ht_.reserve(count);
     }
 
+    // 渐进式rehash，step为每次插入迁移的bucket个数，为0时关闭
+    size_type rehash_step() const noexcept {
+        return ht_.rehash_step();
+    }
+
+    void rehash_step(const size_type step) {
+        ht_.rehash_step(step);
+    }
+
+    void finish_rehash() {
+        ht_.finish_rehash();
+    }
+
+    // 设置后元素较多时的rehash在pool中并行进行，nullptr恢复为串行
+    thread_pool* rehash_pool() const noexcept {
+        return ht_.rehash_pool();
+    }
+
+    void rehash_pool(thread_pool* pool) noexcept {
+        ht_.rehash_pool(pool);
+    }
+
+    // 查找前先询问布隆过滤器，适合大部分查找都失败的表，bits_per_key为0时关闭，见hashtable::enable_filter
+    void enable_filter(const size_type bits_per_key = 10) {
+        ht_.enable_filter(bits_per_key);
+    }
+
+    void disable_filter() noexcept {
+        ht_.disable_filter();
+    }
+
+    bool filter_enabled() const noexcept {
+        return ht_.filter_enabled();
+    }
+
+    // 链长分布与热点bucket，定义MSTL_HT_STATS时还有探测与rehash计数，见ht_stats
+    ht_stats stats(const size_type top = 8) const {
+        return ht_.stats(top);
+    }
+
+    void reset_stats() noexcept {
+        ht_.reset_stats();
+    }
+
     hasher hash_func() const {
         return ht_.hash_func();
     }
@@ -280,21 +429,21 @@ public:
     }
 };
 
-template<typename Key, typename Hash, typename KeyEqual>
-bool operator==(const unordered_set<Key, Hash, KeyEqual>& lhs,
-                const unordered_set<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator==(const unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs == rhs;
 }
 
-template<typename Key, typename Hash, typename KeyEqual>
-bool operator!=(const unordered_set<Key, Hash, KeyEqual>& lhs,
-                const unordered_set<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator!=(const unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs != rhs;
 }
 
-template<typename Key, typename Hash, typename KeyEqual>
-void swap(unordered_set<Key, Hash, KeyEqual>& lhs,
-          unordered_set<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void swap(unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+          unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     lhs.swap(rhs);
 }
 
@@ -302,13 +451,19 @@ void swap(unordered_set<Key, Hash, KeyEqual>& lhs,
 
 /****************************************************************************************************************************************/
 // unordered_multiset模板类
-// 第一参数为键的类型, 第二参数为哈希函数类型，缺省时使用mstl::hash<>，第三参数为键比较大小的函数类型，缺省为mstl::equal_to<>
-template<typename Key, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>>
+// 第一参数为键的类型, 第二参数为哈希函数类型，缺省时使用mstl::hash<>，第三参数为键比较大小的函数类型，缺省为mstl::equal_to<>，
+// 第四参数为bucket下标策略，缺省为ht_prime_bucket_policy，第五参数为节点内存策略，缺省为ht_heap_node_policy
+template<typename Key, typename Hash = mstl::hash<Key>, typename KeyEqual = mstl::equal_to<Key>,
+         typename BucketPolicy = mstl::ht_prime_bucket_policy, typename NodePolicy = mstl::ht_heap_node_policy>
 class unordered_multiset {
 private:
     // 以hashtable作为底层容器进行封装
-    typedef hashtable<Key, Hash, KeyEqual> base_type;
+    typedef hashtable<Key, Hash, KeyEqual, BucketPolicy, NodePolicy> base_type;
     base_type ht_;
+
+    // merge需要访问另一种容器的hashtable
+    template<typename, typename, typename, typename, typename>
+    friend class unordered_set;
 public:
     typedef typename base_type::allocator_type       allocator_type;
     typedef typename base_type::key_type             key_type;
@@ -329,6 +484,8 @@ public:
     typedef typename base_type::local_iterator       local_iterator;
     typedef typename base_type::const_local_iterator const_local_iterator;
 
+    typedef typename base_type::node_handle          node_type;
+
     allocator_type get_allocator() const {
         return ht_.get_allocator();
     }
@@ -352,6 +509,15 @@ public:
         }
     }
 
+    // 在pool中并行地创建节点并链接到各bucket，得到的元素与逐个插入相同
+    template<typename InputIter>
+    unordered_multiset(InputIter first, InputIter last, thread_pool& pool,
+                       const size_type bucket_count = 100,
+                       const Hash& hash = Hash(),
+                       const KeyEqual& equal = KeyEqual()) : ht_(bucket_count, hash, equal) {
+        ht_.parallel_build_multi(first, last, pool);
+    }
+
     unordered_multiset(std::initializer_list<value_type> ilist,
                   const size_type bucket_count = 100,
                   const Hash& hash = Hash(),
@@ -463,13 +629,39 @@ public:
     }
 
     void erase(iterator first, iterator last) {
-        ht_.earse(first, last);
+        ht_.erase(first, last);
     }
 
     size_type erase(const key_type& key) {
         return ht_.erase_multi(key);
     }
 
+    // 节点句柄，在容器之间转移元素时不申请内存也不复制元素，要求NodePolicy的transferable为true
+    node_type extract(const_iterator pos) {
+        return ht_.extract(pos);
+    }
+
+    node_type extract(const key_type& key) {
+        return ht_.extract(key);
+    }
+
+    iterator insert(node_type&& nh) {
+        return ht_.insert_multi(mstl::move(nh));
+    }
+
+    iterator insert(const_iterator /*hint*/, node_type&& nh) {
+        return ht_.insert_multi(mstl::move(nh));
+    }
+
+    // 把src中的元素全部移到本容器
+    void merge(unordered_multiset& src) {
+        ht_.merge_multi(src.ht_);
+    }
+
+    void merge(unordered_set<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& src) {
+        ht_.merge_multi(src.ht_);
+    }
+
     void clear() {
         ht_.clear();
     }
@@ -478,10 +670,14 @@ public:
         ht_.swap(rhs.ht_);
     }
 
-    size_type count(const key_type key) const {
+    size_type count(const key_type& key) const {
         return ht_.count(key);
     }
 
+    bool contains(const key_type& key) const {
+        return ht_.contains(key);
+    }
+
     iterator find(const key_type& key) {
         return ht_.find(key);
     }
@@ -494,10 +690,63 @@ public:
         return ht_.equal_range_multi(key);
     }
 
-    pair<iterator, iterator> equal_range(const key_type& key) const {
+    pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
         return ht_.equal_range_multi(key);
     }
 
+    // 异构查找，要求Hash与KeyEqual都声明了is_transparent
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    size_type count(const K& key) const {
+        return ht_.count(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    bool contains(const K& key) const {
+        return ht_.contains(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    iterator find(const K& key) {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    const_iterator find(const K& key) const {
+        return ht_.find(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<iterator, iterator> equal_range(const K& key) {
+        return ht_.equal_range_multi(key);
+    }
+
+    template<typename K, typename mstl::enable_if<
+        ht_is_transparent<Hash, KeyEqual, K>::value, int>::type = 0>
+    pair<const_iterator, const_iterator> equal_range(const K& key) const {
+        return ht_.equal_range_multi(key);
+    }
+
+    // 批量查找，keys[i]的结果写入out[i]，一组键值的访存延迟相互重叠
+    template<typename K>
+    void find_batch(const K* keys, size_type n, iterator* out) {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void find_batch(const K* keys, size_type n, const_iterator* out) const {
+        ht_.find_batch(keys, n, out);
+    }
+
+    template<typename K>
+    void count_batch(const K* keys, size_type n, size_type* out) const {
+        ht_.count_batch(keys, n, out);
+    }
+
     local_iterator begin(const size_type n) noexcept {
         return ht_.begin(n);
     }
@@ -558,6 +807,50 @@ public:
         ht_.reserve(count);
     }
 
+    // 渐进式rehash，step为每次插入迁移的bucket个数，为0时关闭
+    size_type rehash_step() const noexcept {
+        return ht_.rehash_step();
+    }
+
+    void rehash_step(const size_type step) {
+        ht_.rehash_step(step);
+    }
+
+    void finish_rehash() {
+        ht_.finish_rehash();
+    }
+
+    // 设置后元素较多时的rehash在pool中并行进行，nullptr恢复为串行
+    thread_pool* rehash_pool() const noexcept {
+        return ht_.rehash_pool();
+    }
+
+    void rehash_pool(thread_pool* pool) noexcept {
+        ht_.rehash_pool(pool);
+    }
+
+    // 查找前先询问布隆过滤器，适合大部分查找都失败的表，bits_per_key为0时关闭，见hashtable::enable_filter
+    void enable_filter(const size_type bits_per_key = 10) {
+        ht_.enable_filter(bits_per_key);
+    }
+
+    void disable_filter() noexcept {
+        ht_.disable_filter();
+    }
+
+    bool filter_enabled() const noexcept {
+        return ht_.filter_enabled();
+    }
+
+    // 链长分布与热点bucket，定义MSTL_HT_STATS时还有探测与rehash计数，见ht_stats
+    ht_stats stats(const size_type top = 8) const {
+        return ht_.stats(top);
+    }
+
+    void reset_stats() noexcept {
+        ht_.reset_stats();
+    }
+
     hasher hash_func() const {
         return ht_.hash_func();
     }
@@ -576,21 +869,21 @@ public:
     }
 };
 
-template<typename Key, typename Hash, typename KeyEqual>
-bool operator==(const unordered_multiset<Key, Hash, KeyEqual>& lhs,
-                const unordered_multiset<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator==(const unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs == rhs;
 }
 
-template<typename Key, typename Hash, typename KeyEqual>
-bool operator!=(const unordered_multiset<Key, Hash, KeyEqual>& lhs,
-                const unordered_multiset<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+bool operator!=(const unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+                const unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     return lhs != rhs;
 }
 
-template<typename Key, typename Hash, typename KeyEqual>
-void swap(unordered_multiset<Key, Hash, KeyEqual>& lhs,
-          unordered_multiset<Key, Hash, KeyEqual>& rhs) {
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy, typename NodePolicy>
+void swap(unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& lhs,
+          unordered_multiset<Key, Hash, KeyEqual, BucketPolicy, NodePolicy>& rhs) {
     lhs.swap(rhs);
 }
 
@@ -0,0 +1,907 @@
+#ifndef M_UNROLLED_LIST_H_
+#define M_UNROLLED_LIST_H_
+
+// 展开链表unrolled_list的实现
+// 每个节点连续存放至多K个元素，节点之间与list一样通过一个哨兵节点node_组成双向环。
+// 顺序遍历时大部分时间都在节点内部的连续内存上移动，接近vector的遍历速度；
+// 插入与删除只需要在单个节点内移动至多K个元素，节点满时一分为二，过空时与相邻节点合并。
+// 注意：插入和删除会使同一节点（以及发生分裂、合并的相邻节点）中元素的迭代器失效，
+// 其他节点中元素的迭代器不受影响
+
+#include <initializer_list>
+#include <type_traits>
+
+#include "m_iterator.h"
+#include "m_list.h"
+#include "m_algobase.h"
+#include "m_exceptdef.h"
+#include "m_util.h"
+#include "m_memory.h"
+
+namespace mstl {
+
+template<typename T, size_t K>
+struct unrolled_list_node_base;
+
+template<typename T, size_t K>
+struct unrolled_list_node;
+
+template<typename T, size_t K>
+struct unrolled_list_traits {
+    typedef unrolled_list_node_base<T, K>* base_ptr;
+    typedef unrolled_list_node<T, K>*      node_ptr;
+};
+
+template<typename T, size_t K>
+struct unrolled_list_node_base {
+    typedef typename unrolled_list_traits<T, K>::base_ptr base_ptr;
+    typedef typename unrolled_list_traits<T, K>::node_ptr node_ptr;
+
+    unrolled_list_node_base() = default;
+    // 前后两个指针
+    base_ptr prev;
+    base_ptr next;
+
+    node_ptr as_node() {
+        return static_cast<node_ptr>(self());
+    }
+
+    // 哨兵节点初始化时prev和next都指向自己
+    void unlink() {
+        prev = next = self();
+    }
+
+    base_ptr self() {
+        return static_cast<base_ptr>(this);
+    }
+};
+
+template<typename T, size_t K>
+struct unrolled_list_node : public unrolled_list_node_base<T, K> {
+    typedef typename unrolled_list_traits<T, K>::base_ptr base_ptr;
+    typedef typename unrolled_list_traits<T, K>::node_ptr node_ptr;
+
+    // 节点中已构造的元素个数，元素总是位于[0, count)
+    size_t count;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type data[K];
+
+    T* values() {
+        return reinterpret_cast<T*>(data);
+    }
+
+    base_ptr as_base() {
+        return static_cast<base_ptr>(this);
+    }
+};
+
+// unrolled_list的迭代器由节点指针与节点内的下标组成，end()为(node_, 0)
+template<typename T, size_t K>
+class unrolled_list_iterator : public iterator<mstl::bidirectional_iterator_tag, T> {
+public:
+    typedef T                                            value_type;
+    typedef T*                                           pointer;
+    typedef T&                                           reference;
+    typedef typename unrolled_list_traits<T, K>::base_ptr base_ptr;
+    typedef typename unrolled_list_traits<T, K>::node_ptr node_ptr;
+    typedef unrolled_list_iterator<T, K>                 self;
+
+    base_ptr node_;
+    size_t   index_;
+
+    unrolled_list_iterator() = default;
+
+    unrolled_list_iterator(base_ptr ptr, size_t index) : node_(ptr), index_(index) {}
+
+    reference operator*() const {
+        return node_->as_node()->values()[index_];
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(node_ != nullptr);
+        if (++index_ == node_->as_node()->count) {
+            node_ = node_->next;
+            index_ = 0;
+        }
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*(this);
+        return temp;
+    }
+
+    self& operator--() {
+        MSTL_DEBUG(node_ != nullptr);
+        if (index_ == 0) {
+            node_ = node_->prev;
+            index_ = node_->as_node()->count;
+        }
+        --index_;
+        return *this;
+    }
+
+    self operator--(int) {
+        self temp = *this;
+        --*(this);
+        return temp;
+    }
+
+    bool operator==(const self& rhs) const {
+        return node_ == rhs.node_ && index_ == rhs.index_;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+template<typename T, size_t K>
+class unrolled_list_const_iterator : public iterator<mstl::bidirectional_iterator_tag, T> {
+public:
+    typedef T                                            value_type;
+    typedef const T*                                     pointer;
+    typedef const T&                                     reference;
+    typedef typename unrolled_list_traits<T, K>::base_ptr base_ptr;
+    typedef typename unrolled_list_traits<T, K>::node_ptr node_ptr;
+    typedef unrolled_list_const_iterator<T, K>           self;
+
+    base_ptr node_;
+    size_t   index_;
+
+    unrolled_list_const_iterator() = default;
+
+    unrolled_list_const_iterator(base_ptr ptr, size_t index) : node_(ptr), index_(index) {}
+
+    unrolled_list_const_iterator(const unrolled_list_iterator<T, K>& rhs)
+        : node_(rhs.node_), index_(rhs.index_) {}
+
+    reference operator*() const {
+        return node_->as_node()->values()[index_];
+    }
+
+    pointer operator->() const {
+        return &(operator*());
+    }
+
+    self& operator++() {
+        MSTL_DEBUG(node_ != nullptr);
+        if (++index_ == node_->as_node()->count) {
+            node_ = node_->next;
+            index_ = 0;
+        }
+        return *this;
+    }
+
+    self operator++(int) {
+        self temp = *this;
+        ++*(this);
+        return temp;
+    }
+
+    self& operator--() {
+        MSTL_DEBUG(node_ != nullptr);
+        if (index_ == 0) {
+            node_ = node_->prev;
+            index_ = node_->as_node()->count;
+        }
+        --index_;
+        return *this;
+    }
+
+    self operator--(int) {
+        self temp = *this;
+        --*(this);
+        return temp;
+    }
+
+    bool operator==(const self& rhs) const {
+        return node_ == rhs.node_ && index_ == rhs.index_;
+    }
+
+    bool operator!=(const self& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+// K默认取使每个节点的元素约占256字节的个数
+template<typename T, size_t K = (sizeof(T) < 128 ? 256 / sizeof(T) : 2)>
+class unrolled_list {
+public:
+    static_assert(K >= 2, "the node capacity of unrolled_list should be at least 2");
+
+    typedef mstl::allocator<T>                                allocator_type;
+    typedef mstl::allocator<T>                                data_allocator;
+    typedef mstl::allocator<unrolled_list_node_base<T, K>>    base_allocator;
+    typedef mstl::allocator<unrolled_list_node<T, K>>         node_allocator;
+
+    typedef typename allocator_type::value_type               value_type;
+    typedef typename allocator_type::pointer                  pointer;
+    typedef typename allocator_type::const_pointer            const_pointer;
+    typedef typename allocator_type::reference                reference;
+    typedef typename allocator_type::const_reference          const_reference;
+    typedef typename allocator_type::size_type                size_type;
+    typedef typename allocator_type::difference_type          difference_type;
+
+    typedef unrolled_list_iterator<T, K>                      iterator;
+    typedef unrolled_list_const_iterator<T, K>                const_iterator;
+    typedef mstl::reverse_iterator<iterator>                  reverse_iterator;
+    typedef mstl::reverse_iterator<const_iterator>            const_reverse_iterator;
+
+    typedef typename unrolled_list_traits<T, K>::base_ptr     base_ptr;
+    typedef typename unrolled_list_traits<T, K>::node_ptr     node_ptr;
+
+    static constexpr size_type node_capacity = K;
+
+private:
+    base_ptr  node_;    // 哨兵节点，不存放元素
+    size_type size_;    // 存放的数据个数
+
+public:
+    // 一系列构造与赋值函数
+    unrolled_list() {
+        init();
+    }
+
+    explicit unrolled_list(size_type n) {
+        init();
+        try {
+            fill_insert(end(), n, value_type());
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    unrolled_list(size_type n, const value_type& value) {
+        init();
+        try {
+            fill_insert(end(), n, value);
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    template<typename Iter, typename mstl::enable_if<
+            mstl::is_input_iterator<Iter>::value, int>::type = 0>
+    unrolled_list(Iter first, Iter last) {
+        init();
+        try {
+            copy_insert(end(), first, last);
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    unrolled_list(std::initializer_list<T> ilist) {
+        init();
+        try {
+            copy_insert(end(), ilist.begin(), ilist.end());
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    unrolled_list(const unrolled_list& rhs) {
+        init();
+        try {
+            copy_insert(end(), rhs.cbegin(), rhs.cend());
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    unrolled_list(unrolled_list&& rhs) noexcept : node_(rhs.node_), size_(rhs.size_) {
+        rhs.node_ = nullptr;
+        rhs.size_ = 0;
+    }
+
+    unrolled_list& operator=(const unrolled_list& rhs) {
+        if (this != &rhs) {
+            unrolled_list temp(rhs);
+            swap(temp);
+        }
+        return *this;
+    }
+
+    unrolled_list& operator=(unrolled_list&& rhs) noexcept {
+        unrolled_list temp(mstl::move(rhs));
+        swap(temp);
+        return *this;
+    }
+
+    unrolled_list& operator=(std::initializer_list<T> ilist) {
+        unrolled_list temp(ilist.begin(), ilist.end());
+        swap(temp);
+        return *this;
+    }
+
+    ~unrolled_list() {
+        if (node_) {
+            destroy_all();
+        }
+    }
+
+public:
+    // 迭代器相关操作
+    iterator begin() noexcept {
+        return iterator(node_->next, 0);
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(node_->next, 0);
+    }
+
+    iterator end() noexcept {
+        return iterator(node_, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(node_, 0);
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    const_reverse_iterator crbegin() const noexcept {
+        return rbegin();
+    }
+
+    const_reverse_iterator crend() const noexcept {
+        return rend();
+    }
+
+    // 容量相关方法
+    bool empty() const noexcept {
+        return node_ == node_->next;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    size_type max_size() const noexcept {
+        return static_cast<size_type>(-1);
+    }
+
+    // 访问元素
+    reference front() {
+        MSTL_DEBUG(!empty());
+        return *begin();
+    }
+
+    const_reference front() const {
+        MSTL_DEBUG(!empty());
+        return *begin();
+    }
+
+    reference back() {
+        MSTL_DEBUG(!empty());
+        return *(--end());
+    }
+
+    const_reference back() const {
+        MSTL_DEBUG(!empty());
+        return *(--end());
+    }
+
+    template<typename... Args>
+    void emplace_front(Args&& ...args) {
+        emplace(cbegin(), mstl::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&& ...args) {
+        emplace(cend(), mstl::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    iterator emplace(const_iterator pos, Args&& ...args);
+
+    iterator insert(const_iterator pos, const value_type& value) {
+        return emplace(pos, value);
+    }
+
+    iterator insert(const_iterator pos, value_type&& value) {
+        return emplace(pos, mstl::move(value));
+    }
+
+    iterator insert(const_iterator pos, size_type n, const value_type& value) {
+        THROW_LENGTH_ERROR_IF(size_ > max_size() - n, "this size of unrolled_list<T> is too large");
+        return fill_insert(pos, n, value);
+    }
+
+    template<typename Iter, typename mstl::enable_if<
+            mstl::is_input_iterator<Iter>::value, int>::type = 0>
+    iterator insert(const_iterator pos, Iter first, Iter last) {
+        return copy_insert(pos, first, last);
+    }
+
+    void push_front(const value_type& value) {
+        emplace_front(value);
+    }
+
+    void push_front(value_type&& value) {
+        emplace_front(mstl::move(value));
+    }
+
+    void push_back(const value_type& value) {
+        emplace_back(value);
+    }
+
+    void push_back(value_type&& value) {
+        emplace_back(mstl::move(value));
+    }
+
+    void pop_front() {
+        MSTL_DEBUG(!empty());
+        erase(cbegin());
+    }
+
+    void pop_back() {
+        MSTL_DEBUG(!empty());
+        erase(--cend());
+    }
+
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    void clear();
+
+    void swap(unrolled_list& rhs) noexcept {
+        mstl::swap(node_, rhs.node_);
+        mstl::swap(size_, rhs.size_);
+    }
+
+    // 与list一样整块地移动节点，只有pos与[first, last)的边界位于节点中间时才需要拆分节点
+    void splice(const_iterator pos, unrolled_list& x);
+    void splice(const_iterator pos, unrolled_list& x, const_iterator it);
+    void splice(const_iterator pos, unrolled_list& x, const_iterator first, const_iterator last);
+
+    template<typename UnaryPredicate>
+    void remove_if(UnaryPredicate pred);
+
+private:
+    // 辅助函数
+    void init();
+    void destroy_all();
+
+    node_ptr create_node();
+    void destory_node(node_ptr p);
+    node_ptr new_node_before(base_ptr pos);
+
+    node_ptr split_node(node_ptr p, size_type at);
+    base_ptr split_at(const_iterator pos);
+    void merge_next(node_ptr p);
+    iterator rebalance(node_ptr p, size_type index);
+
+    iterator fill_insert(const_iterator pos, size_type n, const value_type& value);
+    template<typename Iter>
+    iterator copy_insert(const_iterator pos, Iter first, Iter last);
+};
+
+template<typename T, size_t K>
+constexpr typename unrolled_list<T, K>::size_type unrolled_list<T, K>::node_capacity;
+
+// 在pos位置之前构造一个元素
+// pos位于节点开头且前一个节点未满时，直接追加到前一个节点末尾，从而顺序插入时节点总是满的
+template<typename T, size_t K>
+template<typename... Args>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::emplace(const_iterator pos, Args&& ...args) {
+    THROW_LENGTH_ERROR_IF(size_ > max_size() - 1, "this size of unrolled_list<T> is too large");
+    // 先构造出元素，之后节点内的移动都不会因为参数引用了本容器中的元素而出错
+    value_type value(mstl::forward<Args>(args)...);
+    base_ptr b = pos.node_;
+    size_type index = pos.index_;
+    node_ptr p;
+    if (index == 0 && b->prev != node_ && b->prev->as_node()->count < K) {
+        p = b->prev->as_node();
+        index = p->count;
+    } else if (b == node_ || (index == 0 && b->as_node()->count == K)) {
+        p = new_node_before(b);
+    } else {
+        p = b->as_node();
+        if (p->count == K) {
+            node_ptr q = split_node(p, K / 2);
+            if (index > K / 2) {
+                p = q;
+                index -= K / 2;
+            }
+        }
+    }
+    T* v = p->values();
+    if (index == p->count) {
+        data_allocator::construct(v + index, mstl::move(value));
+    } else {
+        data_allocator::construct(v + p->count, mstl::move(v[p->count - 1]));
+        mstl::move_backward(v + index, v + p->count - 1, v + p->count);
+        v[index] = mstl::move(value);
+    }
+    ++p->count;
+    ++size_;
+    return iterator(p->as_base(), index);
+}
+
+// 删除pos处的元素，节点变空时释放节点，元素过少时尝试与相邻节点合并
+template<typename T, size_t K>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::erase(const_iterator pos) {
+    MSTL_DEBUG(pos != cend());
+    node_ptr p = pos.node_->as_node();
+    T* v = p->values();
+    mstl::move(v + pos.index_ + 1, v + p->count, v + pos.index_);
+    data_allocator::destory(v + p->count - 1);
+    --p->count;
+    --size_;
+    return rebalance(p, pos.index_);
+}
+
+template<typename T, size_t K>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::erase(const_iterator first, const_iterator last) {
+    if (first == last) {
+        return iterator(last.node_, last.index_);
+    }
+    size_type n = mstl::distance(first, last);
+    node_ptr p = first.node_->as_node();
+    size_type index = first.index_;
+    size_ -= n;
+    while (true) {
+        // 每次删除当前节点中位于范围内的一段
+        const size_type take = mstl::min(n, p->count - index);
+        T* v = p->values();
+        mstl::move(v + index + take, v + p->count, v + index);
+        data_allocator::destory(v + p->count - take, v + p->count);
+        p->count -= take;
+        n -= take;
+        if (n == 0) {
+            break;
+        }
+        if (p->count == 0) {
+            base_ptr next = p->next;
+            list_unlink_nodes(p->as_base(), p->as_base());
+            destory_node(p);
+            p = next->as_node();
+        } else {
+            p = p->next->as_node();
+        }
+        index = 0;
+    }
+    return rebalance(p, index);
+}
+
+template<typename T, size_t K>
+void unrolled_list<T, K>::clear() {
+    base_ptr cur = node_->next;
+    while (cur != node_) {
+        base_ptr next = cur->next;
+        node_ptr p = cur->as_node();
+        data_allocator::destory(p->values(), p->values() + p->count);
+        destory_node(p);
+        cur = next;
+    }
+    node_->unlink();
+    size_ = 0;
+}
+
+// 将x的所有节点插入到pos位置之前
+template<typename T, size_t K>
+void unrolled_list<T, K>::splice(const_iterator pos, unrolled_list& x) {
+    MSTL_DEBUG(this != &x);
+    if (!x.empty()) {
+        THROW_LENGTH_ERROR_IF(size_ > max_size() - x.size_, "this size of unrolled_list<T> is too large");
+        base_ptr b = split_at(pos);
+        list_transfer_nodes(b, x.node_->next, x.node_->prev);
+        size_ += x.size_;
+        x.size_ = 0;
+    }
+}
+
+template<typename T, size_t K>
+void unrolled_list<T, K>::splice(const_iterator pos, unrolled_list& x, const_iterator it) {
+    const_iterator last = it;
+    ++last;
+    if (this != &x) {
+        splice(pos, x, it, last);
+        return;
+    }
+    // 同一个链表内移动单个元素，元素已经在pos之前时无需修改
+    if (pos == it || pos == last) {
+        return;
+    }
+    // 先把元素移动构造到pos处，再删除原位置上已被移走的元素。
+    // 插入可能使原元素在节点内后移一位，或者因为节点已满被拆分到下一个节点，据此修正它的位置
+    node_ptr p = it.node_->as_node();
+    size_type index = it.index_;
+    const size_type old_count = p->count;
+    iterator ins = emplace(pos, mstl::move(p->values()[index]));
+    if (p->count < old_count && index >= K / 2) {
+        p = p->next->as_node();
+        index -= K / 2;
+    }
+    if (ins.node_ == p->as_base() && ins.index_ <= index) {
+        ++index;
+    }
+    erase(const_iterator(p->as_base(), index));
+}
+
+// 将x中[first, last)的元素插入到pos位置之前，先在边界处拆分节点，再整块移动
+template<typename T, size_t K>
+void unrolled_list<T, K>::splice(const_iterator pos, unrolled_list& x,
+                                 const_iterator first, const_iterator last) {
+    if (first != last && this != &x) {
+        // 先拆分last，first所在节点中位于first之前的部分不受影响
+        base_ptr l = x.split_at(last);
+        base_ptr f = x.split_at(first);
+        base_ptr b = split_at(pos);
+        size_type n = 0;
+        for (base_ptr cur = f; cur != l; cur = cur->next) {
+            n += cur->as_node()->count;
+        }
+        THROW_LENGTH_ERROR_IF(size_ > max_size() - n, "this size of unrolled_list<T> is too large");
+        base_ptr before = f->prev;
+        list_transfer_nodes(b, f, l->prev);
+        size_ += n;
+        x.size_ -= n;
+        // 拆分可能留下很空的节点，在新的边界处尝试合并
+        if (before != x.node_) {
+            x.rebalance(before->as_node(), 0);
+        }
+        if (b != node_) {
+            rebalance(b->as_node(), 0);
+        }
+        if (f->prev != node_) {
+            rebalance(f->prev->as_node(), 0);
+        }
+    }
+}
+
+template<typename T, size_t K>
+template<typename UnaryPredicate>
+void unrolled_list<T, K>::remove_if(UnaryPredicate pred) {
+    // 逐个节点压缩，保留的元素向前移动，最后统一释放空节点
+    base_ptr cur = node_->next;
+    while (cur != node_) {
+        base_ptr next = cur->next;
+        node_ptr p = cur->as_node();
+        T* v = p->values();
+        size_type kept = 0;
+        for (size_type i = 0; i < p->count; ++i) {
+            if (!pred(v[i])) {
+                if (kept != i) {
+                    v[kept] = mstl::move(v[i]);
+                }
+                ++kept;
+            }
+        }
+        data_allocator::destory(v + kept, v + p->count);
+        size_ -= p->count - kept;
+        p->count = kept;
+        if (kept == 0) {
+            list_unlink_nodes(cur, cur);
+            destory_node(p);
+        } else if (cur->prev != node_) {
+            rebalance(cur->prev->as_node(), 0);
+        }
+        cur = next;
+    }
+}
+
+// 辅助函数的实现
+
+template<typename T, size_t K>
+void unrolled_list<T, K>::init() {
+    node_ = base_allocator::allocate(1);
+    node_->unlink();
+    size_ = 0;
+}
+
+// 销毁所有元素并释放哨兵节点
+template<typename T, size_t K>
+void unrolled_list<T, K>::destroy_all() {
+    clear();
+    base_allocator::deallocate(node_);
+    node_ = nullptr;
+    size_ = 0;
+}
+
+template<typename T, size_t K>
+typename unrolled_list<T, K>::node_ptr
+unrolled_list<T, K>::create_node() {
+    node_ptr p = node_allocator::allocate(1);
+    p->prev = nullptr;
+    p->next = nullptr;
+    p->count = 0;
+    return p;
+}
+
+// 节点中的元素需要事先销毁
+template<typename T, size_t K>
+void unrolled_list<T, K>::destory_node(node_ptr p) {
+    node_allocator::deallocate(p);
+}
+
+// 在pos之前链接一个新的空节点
+template<typename T, size_t K>
+typename unrolled_list<T, K>::node_ptr
+unrolled_list<T, K>::new_node_before(base_ptr pos) {
+    node_ptr p = create_node();
+    list_link_nodes(pos, p->as_base(), p->as_base());
+    return p;
+}
+
+// 将p中[at, count)的元素移动到紧随其后的新节点中，返回新节点
+template<typename T, size_t K>
+typename unrolled_list<T, K>::node_ptr
+unrolled_list<T, K>::split_node(node_ptr p, size_type at) {
+    node_ptr q = new_node_before(p->next);
+    T* v = p->values();
+    mstl::uninitialized_move(v + at, v + p->count, q->values());
+    data_allocator::destory(v + at, v + p->count);
+    q->count = p->count - at;
+    p->count = at;
+    return q;
+}
+
+// 保证pos位于某个节点的开头，返回该节点（pos为end时返回node_）
+template<typename T, size_t K>
+typename unrolled_list<T, K>::base_ptr
+unrolled_list<T, K>::split_at(const_iterator pos) {
+    if (pos.index_ == 0) {
+        return pos.node_;
+    }
+    return split_node(pos.node_->as_node(), pos.index_)->as_base();
+}
+
+// 将p的下一个节点中的元素全部移动到p的末尾，并释放下一个节点
+template<typename T, size_t K>
+void unrolled_list<T, K>::merge_next(node_ptr p) {
+    node_ptr q = p->next->as_node();
+    MSTL_DEBUG(p->count + q->count <= K);
+    T* v = q->values();
+    mstl::uninitialized_move(v, v + q->count, p->values() + p->count);
+    data_allocator::destory(v, v + q->count);
+    p->count += q->count;
+    list_unlink_nodes(q->as_base(), q->as_base());
+    destory_node(q);
+}
+
+// 元素减少后调整节点p：为空时释放，不足半满且能与相邻节点放入同一个节点时合并。
+// 返回删除操作之后原先位于(p, index)处的元素的迭代器
+template<typename T, size_t K>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::rebalance(node_ptr p, size_type index) {
+    if (p->count == 0) {
+        base_ptr next = p->next;
+        list_unlink_nodes(p->as_base(), p->as_base());
+        destory_node(p);
+        return iterator(next, 0);
+    }
+    if (p->count < K / 2) {
+        base_ptr next = p->next;
+        base_ptr prev = p->prev;
+        if (next != node_ && p->count + next->as_node()->count <= K) {
+            merge_next(p);
+        } else if (prev != node_ && prev->as_node()->count + p->count <= K) {
+            index += prev->as_node()->count;
+            p = prev->as_node();
+            merge_next(p);
+        }
+    }
+    if (index == p->count) {
+        return iterator(p->next, 0);
+    }
+    return iterator(p->as_base(), index);
+}
+
+// 在pos位置插入n个value值
+template<typename T, size_t K>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::fill_insert(const_iterator pos, size_type n, const value_type& value) {
+    if (n == 0) {
+        return iterator(pos.node_, pos.index_);
+    }
+    const size_type count = n;
+    iterator cur = emplace(pos, value);
+    for (--n; n > 0; --n) {
+        cur = emplace(++cur, value);
+    }
+    // 之后的插入可能拆分了第一个元素所在的节点，从最后插入的位置重新定位
+    mstl::advance(cur, -static_cast<difference_type>(count - 1));
+    return cur;
+}
+
+// 拷贝[first, last)插入到pos位置
+template<typename T, size_t K>
+template<typename Iter>
+typename unrolled_list<T, K>::iterator
+unrolled_list<T, K>::copy_insert(const_iterator pos, Iter first, Iter last) {
+    if (first == last) {
+        return iterator(pos.node_, pos.index_);
+    }
+    size_type n = 1;
+    iterator cur = emplace(pos, *first);
+    for (++first; first != last; ++first, ++n) {
+        cur = emplace(++cur, *first);
+    }
+    mstl::advance(cur, -static_cast<difference_type>(n - 1));
+    return cur;
+}
+
+// 重载比较操作符
+template<typename T, size_t K>
+bool operator==(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    auto first1 = lhs.cbegin();
+    auto first2 = rhs.cbegin();
+    auto last1 = lhs.cend();
+    auto last2 = rhs.cend();
+    while (first1 != last1 && first2 != last2 && *first1 == *first2) {
+        ++first1;
+        ++first2;
+    }
+    return first1 == last1 && first2 == last2;
+}
+
+template<typename T, size_t K>
+bool operator<(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    return mstl::lexicographical_compare(lhs.cbegin(), lhs.cend(), rhs.cbegin(), rhs.cend());
+}
+
+template<typename T, size_t K>
+bool operator!=(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    return !(lhs == rhs);
+}
+
+template<typename T, size_t K>
+bool operator>(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    return rhs < lhs;
+}
+
+template<typename T, size_t K>
+bool operator<=(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    return !(rhs < lhs);
+}
+
+template<typename T, size_t K>
+bool operator>=(const unrolled_list<T, K>& lhs, const unrolled_list<T, K>& rhs) {
+    return !(lhs < rhs);
+}
+
+template<typename T, size_t K>
+void swap(unrolled_list<T, K>& lhs, unrolled_list<T, K>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+} // mstl
+
+#endif
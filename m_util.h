@@ -2,8 +2,11 @@
 #define M_UTIL_H_
 
 #include "m_type_traits.h"
+#include "m_functional.h"
 #include <iostream>
 #include <cstddef>
+#include <tuple>
+#include <utility>
 
 namespace mstl{
 
@@ -27,7 +30,7 @@ namespace mstl{
 
     // move函数的实现
     template<typename T>
-    typename mstl::remove_reference<T>::type&& move(T&& arg) noexcept {
+    constexpr typename mstl::remove_reference<T>::type&& move(T&& arg) noexcept {
         using return_type = typename mstl::remove_reference<T>::type&&;
         return static_cast<return_type>(arg);
     }
@@ -36,12 +39,12 @@ namespace mstl{
     // 在实现转发的情况下只会调用第一种函数，因为函数的参数均为左值
     // 只有在直接只用forward而不是函数内的转发时才会调用第二种函数
     template<typename T>
-    T&& forward(typename mstl::remove_reference<T>::type& arg) noexcept {
+    constexpr T&& forward(typename mstl::remove_reference<T>::type& arg) noexcept {
         return static_cast<T&&>(arg);
     }
 
     template<typename T>
-    T&& forward(typename mstl::remove_reference<T>::type&& arg) noexcept {
+    constexpr T&& forward(typename mstl::remove_reference<T>::type&& arg) noexcept {
         static_assert(!std::is_lvalue_reference<T>::value, "bad forward");
         return static_cast<T&&>(arg);
     }
@@ -81,7 +84,35 @@ namespace mstl{
     };
     
 
+    // 成员MemberPtr在Class中的偏移，以及由成员的地址得到所在的对象。
+    // 只计算地址而不访问对象，编译器会将其折叠为常量。
+    // intrusive_list由hook找到元素、hashtable与lru_cache由元素找到所在的节点都使用它
+    template<typename Class, typename Member, Member Class::*MemberPtr>
+    struct member_offset {
+        static size_t value() noexcept {
+            typename std::aligned_storage<sizeof(Class), alignof(Class)>::type storage;
+            const Class* p = reinterpret_cast<const Class*>(&storage);
+            return static_cast<size_t>(reinterpret_cast<const char*>(&(p->*MemberPtr)) -
+                                       reinterpret_cast<const char*>(p));
+        }
+
+        static Class* container_of(Member* m) noexcept {
+            return reinterpret_cast<Class*>(reinterpret_cast<char*>(m) - value());
+        }
+
+        static const Class* container_of(const Member* m) noexcept {
+            return reinterpret_cast<const Class*>(reinterpret_cast<const char*>(m) - value());
+        }
+    };
+
 //-------------------------pair--------------------------
+    // 分段构造标签，pair的两个成员分别由各自的参数元组原地构造
+    struct piecewise_construct_t {
+        explicit piecewise_construct_t() = default;
+    };
+
+    constexpr piecewise_construct_t piecewise_construct = piecewise_construct_t();
+
     template<typename Ty1, typename Ty2>
     struct pair {
         // 为pair的两个类型命名
@@ -176,6 +207,12 @@ namespace mstl{
         explicit constexpr pair(pair<U1, U2>&& other) 
                     : first(mstl::forward<U1>(other.first)), second(mstl::forward<U2>(other.second))  {}
 
+        // 分段构造函数，first与second直接由元组中的参数构造，不产生临时对象，
+        // 因此成员可以是不可拷贝也不可移动的类型
+        template<typename... Args1, typename... Args2>
+        pair(piecewise_construct_t, std::tuple<Args1...> args1, std::tuple<Args2...> args2)
+            : pair(args1, args2, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
+
         // 赋值构造函数
         pair& operator=(const pair& lhs) {
             if (this != &lhs) {
@@ -217,6 +254,11 @@ namespace mstl{
             }
         }
 
+    private:
+        template<typename Tuple1, typename Tuple2, size_t... I1, size_t... I2>
+        pair(Tuple1& args1, Tuple2& args2, std::index_sequence<I1...>, std::index_sequence<I2...>)
+            : first(std::get<I1>(mstl::move(args1))...), second(std::get<I2>(mstl::move(args2))...) {}
+
     };
 
     // 重载一部分pair相关的全局操作符
@@ -258,9 +300,19 @@ namespace mstl{
     // 定义一个将两变量绑定为pair的函数
     template<typename Ty1, typename Ty2>
     pair<Ty1, Ty2> make_pair(Ty1&& _first, Ty2&& _second) {
-        return pair<Ty1, Ty2>(forward<Ty1>(_first), forward<Ty2>(_second));
+        return pair<Ty1, Ty2>(mstl::forward<Ty1>(_first), mstl::forward<Ty2>(_second));
     }
 
+    // pair的哈希函数，依次合并两个成员的哈希值
+    template<typename Ty1, typename Ty2>
+    struct hash<pair<Ty1, Ty2>> : public unarg_function<pair<Ty1, Ty2>, size_t> {
+        size_t operator()(const pair<Ty1, Ty2>& value) const {
+            size_t seed = mstl::hash<typename std::remove_cv<Ty1>::type>()(value.first);
+            mstl::hash_combine(seed, value.second);
+            return seed;
+        }
+    };
+
 }//mstl
 
 #endif
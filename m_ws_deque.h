@@ -0,0 +1,179 @@
+#ifndef M_WS_DEQUE_H_
+#define M_WS_DEQUE_H_
+
+// Chase-Lev 工作窃取双端队列 ws_deque
+// 队列的拥有者在底部 bottom_ 进行 push/pop，其他线程（窃取者）在顶部 top_ 通过 CAS 无锁地 steal。
+// 内存序参考 Le, Pop, Cohen, Zappa Nardelli 的 C11 版本实现。
+// 环形数组写满时由拥有者扩容为两倍，旧数组可能仍被窃取者读取，因此保留到析构时才释放。
+// 元素以 std::atomic<T> 保存，T 必须是可平凡复制的类型，通常为任务指针
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "m_vector.h"
+#include "m_memory.h"
+
+namespace mstl {
+
+// ws_deque 使用的环形数组，大小为 2 的幂次
+template<typename T>
+struct ws_deque_array {
+    typedef mstl::allocator<std::atomic<T>> slot_allocator;
+
+    int64_t          mask;
+    std::atomic<T>*  slots;
+
+    explicit ws_deque_array(int64_t n) : mask(n - 1) {
+        slots = slot_allocator::allocate(static_cast<size_t>(n));
+        for (int64_t i = 0; i < n; ++i) {
+            new (&slots[i]) std::atomic<T>();
+        }
+    }
+
+    ws_deque_array(const ws_deque_array&) = delete;
+    ws_deque_array& operator=(const ws_deque_array&) = delete;
+
+    ~ws_deque_array() {
+        slot_allocator::deallocate(slots, static_cast<size_t>(mask + 1));
+    }
+
+    int64_t capacity() const noexcept {
+        return mask + 1;
+    }
+
+    T get(int64_t i) const noexcept {
+        return slots[i & mask].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T value) noexcept {
+        slots[i & mask].store(value, std::memory_order_relaxed);
+    }
+
+    // 复制 [top, bottom) 中的元素到容量加倍的新数组
+    ws_deque_array* grow(int64_t bottom, int64_t top) const {
+        ws_deque_array* a = new ws_deque_array(capacity() * 2);
+        for (int64_t i = top; i != bottom; ++i) {
+            a->put(i, get(i));
+        }
+        return a;
+    }
+};
+
+template<typename T>
+class ws_deque {
+public:
+    typedef T       value_type;
+    typedef size_t  size_type;
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "the value_type of ws_deque should be trivially copyable");
+
+private:
+    typedef ws_deque_array<T> array_type;
+
+    // top_ 被窃取者修改，bottom_ 只被拥有者修改，分别放在不同的缓存行
+    alignas(MSTL_CACHE_LINE_SIZE) std::atomic<int64_t>     top_;
+    alignas(MSTL_CACHE_LINE_SIZE) std::atomic<int64_t>     bottom_;
+    std::atomic<array_type*>                               array_;
+    // 扩容后被替换下来的旧数组，只有拥有者访问
+    mstl::vector<array_type*>                              retired_;
+
+public:
+    explicit ws_deque(size_type capacity = 256) : top_(0), bottom_(0) {
+        int64_t n = 2;
+        while (static_cast<size_type>(n) < capacity) {
+            n <<= 1;
+        }
+        array_.store(new array_type(n), std::memory_order_relaxed);
+    }
+
+    ws_deque(const ws_deque&) = delete;
+    ws_deque& operator=(const ws_deque&) = delete;
+
+    ~ws_deque() {
+        for (size_type i = 0; i < retired_.size(); ++i) {
+            delete retired_[i];
+        }
+        delete array_.load(std::memory_order_relaxed);
+    }
+
+    // 并发情况下结果仅供参考
+    size_type size_approx() const noexcept {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_type>(b - t) : 0;
+    }
+
+    bool empty_approx() const noexcept {
+        return size_approx() == 0;
+    }
+
+    // 以下两个操作只能由拥有者线程调用
+    void push(T value);
+    bool pop(T& value);
+
+    // 可以被任意线程调用，队列为空或与其他线程竞争失败时返回 false
+    bool steal(T& value);
+};
+
+template<typename T>
+void ws_deque<T>::push(T value) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    array_type* a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity() - 1) {
+        array_type* bigger = a->grow(b, t);
+        retired_.push_back(a);
+        array_.store(bigger, std::memory_order_release);
+        a = bigger;
+    }
+    a->put(b, value);
+    // release 保证窃取者看到新的 bottom_ 时也能看到写入的元素
+    bottom_.store(b + 1, std::memory_order_release);
+}
+
+template<typename T>
+bool ws_deque<T>::pop(T& value) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    array_type* a = array_.load(std::memory_order_relaxed);
+    // 先声明要取走 b 处的元素，再检查窃取者是否已经越过它
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+        // 队列为空
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    value = a->get(b);
+    if (t == b) {
+        // 只剩最后一个元素，需要与窃取者竞争
+        const bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+template<typename T>
+bool ws_deque<T>::steal(T& value) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+    array_type* a = array_.load(std::memory_order_acquire);
+    const T temp = a->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+        return false;
+    }
+    value = temp;
+    return true;
+}
+
+} // mstl
+
+#endif